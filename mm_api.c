@@ -1,721 +1,2312 @@
-#include <stdio.h>
-#include <stdint.h>
-#include <string.h>
-#include <errno.h>
-#include <unistd.h>
-
-#include "mm_api.h"
-
-int debug = 0;
-void Debug() { debug = 1; }
-// This is a helpful macro for adding debug prints through the code. Use it like printf.
-// When running a full test suite this will be silent, but when running a single test
-// Debug() will be called.
-#define DEBUG(args...)	do { if (debug) { fprintf(stderr, "%s:%d: ", __FUNCTION__, __LINE__); fprintf(stderr, args); } } while(0)
-
-///////////////////////////////////////////////////////////////////////////////
-// All implementation goes in this file.                                     //
-///////////////////////////////////////////////////////////////////////////////
-
-uint8_t phys_mem[MM_PHYSICAL_MEMORY_SIZE_BYTES] = {0};
-
-void dump_mem(int ppn) {
-	for(int i = ppn * MM_PAGE_SIZE_BYTES; i < (ppn+1) * MM_PAGE_SIZE_BYTES; i++)
-		printf("%x ", phys_mem[i]);
-
-	printf("\n\n");
-}
-
-// A simple page table entry.
-struct page_table_entry {
-	// TODO: Check to make sure 2 bits is actually enough later in code
-	uint8_t ppn : 2; // Physical page number
-
-	// c bit field (one bit is placed in the struct)
-	uint8_t valid : 1; 		// Is the data accessible, or not?
-	uint8_t writeable : 1;	// Is the data read only, or writeable?
-	uint8_t present : 1;	// Is the data in phys mem, or on disk?
-	uint8_t dirty : 1;		// Has the data been modified in mem, or not?
-	uint8_t accesses : 2;	// How many time has this page been accessed?
-};
-
-// A simple function to print a PTE for debugging purposes
-void print_pte(struct page_table_entry *pte) {
-	DEBUG("PTE:\n");
-	DEBUG("		PPN: 		%d\n", pte->ppn);
-	DEBUG("		valid: 		%d\n", pte->valid);
-	DEBUG("		writeable: 	%d\n", pte->writeable);
-	DEBUG("		present: 	%d\n", pte->present);
-	DEBUG("		dirty: 		%d\n", pte->dirty);
-	DEBUG("		accesses: 	%d\n", pte->accesses);
-}
-
-// I found through testing that sometimes is was unreliable to directly write the pte to memory,
-// so I made this helper. That being said, I never ended up using it
-void write_pte_to_mem(struct page_table_entry *pte, uint8_t *mem_addr) {
-	uint8_t val = 0;
-
-	val = val | pte->accesses << 6;
-	val = val | pte->dirty << 5;
-	val = val | pte->present << 4;
-	val = val | pte->writeable << 3;
-	val = val | pte->valid << 2;
-	val = val | pte->ppn;
-
-	*mem_addr = val;
-}
-
-// Per-process metadata.
-struct process {
-	// If implementing page tables in phys_mem, this is 1 if this processes
-	// page table is currently resident in phys_mem.
-	uint8_t page_table_resident : 1;
-
-	// Has a page table for this process been allocated at all?
-	uint8_t page_table_exists : 1;
-
-	// Swap file for this process.
-	// You may also have a single unified swap file, but this is likely simpler.
-	FILE *swap_file;
-
-	// Pointer to this process' page table, if resident in phys_mem.
-	// This doesn't need to be used although is recommended.
-	struct page_table_entry *page_table;
-};
-
-// Simple helper used to print process attributes for debugging
-void print_process(struct process *proc) {
-	DEBUG("Process:\n");
-	DEBUG("		Resident: 	%d\n", proc->page_table_resident);
-	DEBUG("		Exists: 	%d\n", proc->page_table_exists);
-	DEBUG("		Swap File: 	%p\n", (void*)proc->swap_file);
-	DEBUG("		Page Table: %p\n", (void*)proc->page_table);
-}
-
-struct process processes[MM_MAX_PROCESSES];
-
-int swap_enabled = 0;
-
-// Per physical page -> virtual page mappings, such that we can choose what
-// to eject.
-struct phys_page_entry {
-	// Information about what is in this physical page.
-	// TODO: Consider using fewer bits for these
-	int pid; // I found it useful to store the PID in the page entry
-	int vpn; // ...and the VPN of the installed page
-	uint8_t valid : 1; // Is the page entry in use
-	uint8_t is_page_table : 1; // 0 = data table, 1 = page table
-
-	// TODO: Consider adding a dirty bit for ejection
-};
-struct phys_page_entry phys_pages[MM_PHYSICAL_PAGES];
-
-// Helper that returns the address in phys_mem that the phys_page metadata refers to.
-void *phys_mem_addr_for_phys_page_entry(struct phys_page_entry *phys_page) {
-	int page_no = phys_page - &phys_pages[0];
-	return &phys_mem[page_no * MM_PAGE_SIZE_BYTES];
-}
-
-void MM_SwapOn() {
-	if (!swap_enabled) {
-		char swap_initial[] = {1};
-
-		// Create swap files for each process and initialize the processes to default values
-		for(int i = 0; i < MM_MAX_PROCESSES; i++) {
-			char path[9] = {0};
-			sprintf(path, "./%d.swp", i);
-			FILE *swp = fopen(path, "w+");
-
-			processes[i].page_table_resident = 0;
-			processes[i].page_table_exists = 0;
-			processes[i].swap_file = swp;
-		}
-
-		// Initialize all physical page entries
-		for(int i = 0; i < MM_PHYSICAL_PAGES; i++) {
-			phys_pages[i].pid = -1;
-			phys_pages[i].vpn = -1;
-			phys_pages[i].valid = 0;
-			phys_pages[i].is_page_table = 0;
-		}
-	}
-
-	swap_enabled = 1;
-}
-
-// Ejects a physical page taking in a PID that the new process will be saved to
-int eject_phys_page(int reserving_pid) {
-	int ppn_to_eject = -1;
-	// Scans the physical pages looking for candidates to eject
-	// TODO: You have a number of accesses saved in the PTE, so you should probably use it to optimize
-	for(int i = 0; i < MM_PHYSICAL_PAGES; i++) {
-		// An ideal candidate is a data table that isn't part of the current process
-		if(phys_pages[i].pid != reserving_pid && !phys_pages[i].is_page_table) {
-			ppn_to_eject = i;
-			break;
-		}
-
-		// A good secondary candidate is a data table from the current process
-		if(!phys_pages[i].is_page_table)
-			ppn_to_eject = i;
-	}
-
-	// If none of these conditions could be met (all pages in memory are full of page tables),
-	// then we pick the first page table that isn't from the current process
-	if(ppn_to_eject == -1) {
-		for(int i = 0; i < MM_PHYSICAL_PAGES; i++) {
-			if(phys_pages[i].pid != reserving_pid) {
-				ppn_to_eject = i;
-				break;
-			}
-		}
-	}
-
-	// We should never reach this, but it's always good to check in case there's a bug
-	if(ppn_to_eject == -1) {
-		DEBUG("couldn't eject a page (shouldn't get here)\n");
-		return -1;
-	}
-
-	// The process we're interested in is the one attached to the page we chose to eject
-	struct process *const proc = &processes[phys_pages[ppn_to_eject].pid];
-
-	// We set the VPN to the default for page tables to start
-	int vpn_to_eject = MM_NUM_PTES;
-
-	// We also assume that the data is dirty by default because we don't check if page tables
-	// are dirty (at least not in this version)
-	int is_dirty = 1;
-
-	// If the page isn't a page table, then we eject it by its PTE
-	if(!phys_pages[ppn_to_eject].is_page_table) {
-		vpn_to_eject = phys_pages[ppn_to_eject].vpn;
-
-		// This involves resetting the PTE to its unallocated values while preserving its
-		// dirty bit to check if it needs to be saved to the swap file
-		struct page_table_entry *pte_to_eject = &(proc->page_table[vpn_to_eject]);
-		pte_to_eject->ppn = 0;
-		pte_to_eject->present = 0;
-		is_dirty = pte_to_eject->dirty;
-		pte_to_eject->dirty = 0;
-		pte_to_eject->accesses = 0;
-	} else {
-		// If it's a page table, we're really only interested in resetting the resident flag
-		proc->page_table_resident = 0;
-	}
-
-	// If the data is dirty (page tables should always be dirty), then we eject the data into the
-	// swap file for the relevant process
-	if(is_dirty) {
-		FILE *swap_file = proc->swap_file;
-		// We seek the beginning of the block holding the data we're interested in
-		fseek(swap_file, vpn_to_eject * MM_PAGE_SIZE_BYTES, SEEK_SET);
-
-		// We get the pointer to the memory holding the data we wish to eject
-		uint8_t *mem = (uint8_t*)phys_mem_addr_for_phys_page_entry(&phys_pages[ppn_to_eject]);
-
-		// Then we write the data from memory into the swap file while subsequently zeroing out
-		// the data
-		for(int i = 0; i < MM_PAGE_SIZE_BYTES; i++) {
-			fputc(mem[i], swap_file);
-			mem[i] = 0;
-		}
-	}
-
-	// We have to reset the physical page flags, but their defaults are the same between
-	// page table and data table ejection
-	phys_pages[ppn_to_eject].pid = -1;
-	phys_pages[ppn_to_eject].vpn = -1;
-	phys_pages[ppn_to_eject].valid = 0;
-	phys_pages[ppn_to_eject].is_page_table = 0;
-
-	// Finally, we return the PPN that we chose to eject
-	return ppn_to_eject;
-}
-
-// Reserves a PPN to make space in physical memory for a new page given a PID
-int reserve_ppn(int reserving_pid) {
-	// Ideally, we find a page that's empty (invalid) and we can just use it
-	for(int i = 0; i < MM_PHYSICAL_PAGES; i++)
-		if(!phys_pages[i].valid)
-			return i;
-
-	if(!swap_enabled) {
-		// If we don't find an empty page, and swap is disabled, then we get an error
-		DEBUG("pages full and swap disabled\n");
-		return -1;
-	} else {
-		// Otherwise, we return the best PPN found by ejecting a page
-		return eject_phys_page(reserving_pid);
-	}
-}
-
-// Initializes a page table for a given process identified by its PID
-int create_page_table(int pid) {
-	struct process *const proc = &processes[pid];
-
-	if(proc == NULL) {
-		DEBUG("process is NULL when creating page table\n");
-		return -1;
-	}
-
-	// We reserve a PPN to use for this page table
-	int ppn = reserve_ppn(pid);
-
-	// We throw an error if the PPN is -1 because we cannot continue from here
-	if(ppn == -1) {
-		DEBUG("unable to reserve PPN when creating page table\n");
-		return -1;
-	}
-
-	// A pointer to the memory located within the newly allocated physical page is acquired
-	uint8_t *mem = (uint8_t*)phys_mem_addr_for_phys_page_entry(&phys_pages[ppn]);
-
-	// The page table pointer and flags within the process are set
-	proc->page_table = (struct page_table_entry*)mem;
-	proc->page_table_exists = 1;
-	proc->page_table_resident = 1;
-
-	// Just to be safe, the PTE's are all initialized as valid, but not yet accessible
-	for(int i = 0; i < MM_NUM_PTES; i++) {
-		struct page_table_entry new_pte;
-		new_pte.ppn = 0;
-		new_pte.valid = 1;
-		new_pte.writeable = 0;
-		new_pte.present = 0;
-		new_pte.dirty = 0;
-		new_pte.accesses = 0;
-
-		// No out of bounds checking on the mem + i, so that's pretty bad
-		*(struct page_table_entry*)(mem + i) = new_pte;
-	}
-
-	// The physical page flags need to be set for a page table as well. This involves everything
-	// apart from the VPN, which is unused in PTE's
-	phys_pages[ppn].pid = pid;
-	phys_pages[ppn].vpn = -1;
-	phys_pages[ppn].valid = 1;
-	phys_pages[ppn].is_page_table = 1;
-
-	return 0;
-}
-
-// Loads data pages into memory from a swap file taking in the PTE of the entry, PID, and VPN
-int load_page(struct page_table_entry *pte, int pid, int vpn) {
-	// The PTE has to be valid to load the page
-	if(!pte->valid) {
-		DEBUG("attempted to load invalid PTE\n");
-		return -1;
-	}
-
-	// The physical page can't be valid to load the page
-	if(phys_pages[pte->ppn].valid) {
-		DEBUG("attempted to load page into valid physical page\n");
-		return -1;
-	}
-
-	// If the PTE is already present, then we have nothing to do
-	if(pte->present) {
-		DEBUG("PTE is already present in memory\n");
-		return 0;
-	}
-
-	// If the VPN is negative, then what are we even loading in?
-	if(vpn == -1) {
-		DEBUG("attempted to load from an invalid VPN\n");
-		return -1;
-	}
-
-	// You can only load a swap file if swap is enabled. This function is also used to initialize
-	// a physical page when swap is enabled or disabled
-	if(swap_enabled) {
-		struct process *const proc = &processes[pid];
-	
-		// TODO: Maybe add file read/write helper functions
-		FILE *swap_file = proc->swap_file;
-		// We navigate to the VPN entry within the swap file...
-		fseek(swap_file, vpn * MM_PAGE_SIZE_BYTES, SEEK_SET);
-
-		// ...get the pointer to its memory...
-		uint8_t *mem = (uint8_t*)phys_mem_addr_for_phys_page_entry(&phys_pages[pte->ppn]);
-		for(int i = 0; i < MM_PAGE_SIZE_BYTES; i++) {
-			int c = fgetc(swap_file);
-
-			if(c == EOF)
-				c = 0;
-
-			// ...and read it into physical memory while zeroing out end of file codes as they should
-			// be considered zeroes, but they load in as EOF's cause that's what an EOF is
-			mem[i] = (uint8_t)c;
-		}
-	}
-
-	// The physical page flags are set for a data table
-	phys_pages[pte->ppn].pid = pid;
-	phys_pages[pte->ppn].valid = 1;
-	phys_pages[pte->ppn].is_page_table = 0;
-	phys_pages[pte->ppn].vpn = vpn;
-
-	// The PTE flags are set to show that the data has been loaded and is fresh
-	pte->present = 1;
-	pte->dirty = 0;
-	pte->accesses = 0;
-
-	return 0;
-}
-
-// A simple helper used to check simple memory info and throw an error back out to the MM_Map message
-// if one is found
-int check_mem_info(int pid, uint32_t address, char message[128]) {
-	// PID out of range
-	if(pid >= MM_MAX_PROCESSES || pid < 0) {
-		sprintf(message, "pid out of range");
-		return 1;
-	}
-
-	// Address out of range
-	if(address > MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES) {
-		sprintf(message, "address out of range");
-		return 1;
-	}
-
-	return 0;
-}
-
-// Similar to loading a data page, but instead it's a page table
-// TODO: This can almost certainly be combined with the other load function somehow
-int load_page_table(int pid) {
-	struct process *const proc = &processes[pid];
-	
-	// Can't load if there's no process to load for
-	if(proc == NULL) {
-		DEBUG("process is NULL when loading page table\n");
-		return -1;
-	}
-
-	// Also can't load if the page table doesn't exist
-	if(!proc->page_table_exists) {
-		DEBUG("attempting to load a page table that does not exist\n");
-		return -1;
-	}
-
-	// If the page table is already resident in memory, then we have nothing to do
-	if(proc->page_table_resident) {
-		DEBUG("page table already resident in memory\n");
-		return 0;
-	}
-
-	// Just like a data page, we need to reserve a PPN
-	int ppn = reserve_ppn(pid);
-
-	// Can't continue if the PPN is invalid
-	if(ppn == -1) {
-		DEBUG("unable to reserve PPN when loading page table\n");
-		return -1;
-	}
-
-	FILE *swap_file = proc->swap_file;
-	// Loads in the swap file from the page table entry. This is all the way at the end of the file
-	fseek(swap_file, MM_NUM_PTES * MM_PAGE_SIZE_BYTES, SEEK_SET);
-
-	// A pointer to the memory we want to load into is acquired
-	uint8_t *mem = (uint8_t*)phys_mem_addr_for_phys_page_entry(&phys_pages[ppn]);
-	for(int i = 0; i < MM_PAGE_SIZE_BYTES; i++) {
-		int c = fgetc(swap_file);
-
-		if(c == EOF)
-			c = 0;
-
-		// The content of the swap file is read into physical memory, once again zeroing out EOF's
-		mem[i] = (uint8_t)c;
-	}
-
-	// We need to set the process' page table as resident
-	proc->page_table_resident = 1;
-
-	// The flags of the physical page also need to be set accordingly for a page table
-	phys_pages[ppn].pid = pid;
-	phys_pages[ppn].vpn = -1;
-	phys_pages[ppn].valid = 1;
-	phys_pages[ppn].is_page_table = 1;
-
-	return 0;
-}
-
-// Maps a virtual address to a physical address (I only use this to initilize data and only really
-// map through helpers)
-struct MM_MapResult MM_Map(int pid, uint32_t address, int writeable) {	
-	CHECK(sizeof(struct page_table_entry) <= MM_MAX_PTE_SIZE_BYTES);
-
-	struct MM_MapResult ret = {0};
-	static char message[128];
-
-	ret.message = message;
-
-	// Error out if the memory info is invalid
-	int err;
-	if((err = check_mem_info(pid, address, message))) {
-		ret.error = err;
-		return ret;
-	}
-
-	// The VPN and offset of the data are extracted from the virtual address
-	uint8_t vpn = (uint8_t)(address >> MM_PAGE_SIZE_BITS);
-	uint8_t offset = (uint8_t)(address & MM_PAGE_OFFSET_MASK);
-
-	struct process *const proc = &processes[pid];
-
-	// If the page table doesn't exist on the process, then we need to create it
-	if(!proc->page_table_exists) {
-		if(create_page_table(pid)) {
-			sprintf(message, "unable to create page table");
-			ret.error = 1;
-
-			return ret;
-		}
-	}
-
-	// If the page table exists, but isn't resident in memory, then we just need to load it
-	if(!proc->page_table_resident) {
-		if(load_page_table(pid)) {
-			sprintf(message, "unable to load page table");
-			ret.error = 1;
-
-			return ret;
-		}
-	}
-
-	// The appropriate PTE can now be found
-	struct page_table_entry *pte = &(proc->page_table[vpn]);
-
-	// We can't map it if it isn't valid, though
-	if(!pte->valid) {
-		sprintf(message, "attempted to map invalid PTE");
-		ret.error = -1;
-		
-		return ret;
-	}
-
-	// If the PTE isn't present in memory, then we need to load it in
-	// TODO: Code passes almost all tests if this is commented out lol (because this map function is
-	// lowkey useless in my implementation besides being used to initialize data and set permissions)
-	if(!pte->present) {
-		// We reserve a PPN to load into
-		int ppn = reserve_ppn(pid);
-
-		if(ppn == -1) {
-			sprintf(message, "unable to reserve PPN for mapped PTE");
-			ret.error = -1;
-			
-			return ret;
-		}
-
-		// The PPN of the PTE is set with the acquired PPN
-		pte->ppn = ppn;
-
-		// The page is then loaded into physical memory (if swap is disabled, then this just initializes it)
-		if(load_page(pte, pid, vpn)) {
-			sprintf(message, "unable to load page");
-			ret.error = -1;
-			
-			return ret;
-		}
-	}
-
-	// The PTE flags, including the number of times it was accessed are set to be used for writing and
-	// choosing a candidate for swapping
-	pte->writeable = writeable;
-	pte->accesses = pte->accesses < 3 ? pte->accesses + 1 : 3;
-
-	sprintf(message, "success");
-	ret.error = 0;
-
-	return ret;
-}
-
-// Loads data from a virtual memory address
-int MM_LoadByte(int pid, uint32_t address, uint8_t *value) {
-	// The VPN and offset of the data are extracted from the virtual address
-	uint8_t vpn = (uint8_t)(address >> MM_PAGE_SIZE_BITS);
-	uint8_t offset = (uint8_t)(address & MM_PAGE_OFFSET_MASK);
-
-	struct process *const proc = &processes[pid];
-
-	// The page table must exist in order to load data from it
-	// TODO: Make sure all errors are in the past tense throughout this entire file
-	// TODO: Also try to standardize all errors
-	if(!proc->page_table_exists) {
-		DEBUG("attempted to read from a page table that does not exist\n");
-		return -1;
-	}
-
-	// If it isn't resident, then we can just simply load it
-	// TODO: Implement load_page_table
-	if(!proc->page_table_resident) {
-		if(load_page_table(pid)) {
-			DEBUG("unable to load page table when attempting to read data\n");
-			return -1;
-		}
-	}
-
-	// Use VPN as index to find PTE for this page
-	struct page_table_entry *pte = &proc->page_table[vpn];
-
-	// The PTE must be valid to read data from it
-	if(!pte->valid) {
-		DEBUG("attempting to read from invalid PTE\n");
-		return -1;
-	}
-
-	// If the PTE isn't present in physical memory, then it needs to be loaded in
-	if(!pte->present) {
-		// A PPN is reserved
-		int ppn = reserve_ppn(pid);
-
-		if(ppn == -1) {
-			DEBUG("unable to reserve PPN to read data\n");
-			
-			return -1;
-		}
-
-		// The PTE's PPN is assigned to this reserved PPN
-		pte->ppn = ppn;
-		
-		// The data is loaded into the page
-		if(load_page(pte, pid, vpn)) {
-			DEBUG("unable to load page to read data\n");
-			return -1;
-		}
-	}
-
-	// TODO: A lot of this could probably go in a helper function
-	// The PID's of the physical page and function call need to match
-	if(phys_pages[pte->ppn].pid != pid) {
-		DEBUG("phys page and load call PID's do not match when reading\n");
-		return -1;
-	}
-
-	// So do the VPN's
-	if(phys_pages[pte->ppn].vpn != vpn) {
-		DEBUG("phys page and load call VPN's do not match when reading\n");
-		return -1;
-	}
-
-	// The physical page must be valid to read data from it
-	if(!phys_pages[pte->ppn].valid) {
-		DEBUG("attempting to read from invalid phys page\n");
-		return -1;
-	}
-
-	// We cannot read memory from a page table as this makes it feel uncomfortable
-	if(phys_pages[pte->ppn].is_page_table) {
-		DEBUG("attempting to read memory from a page table\n");
-		return -1;
-	}
-
-	// Phyical pointer reassembled from PPN and offset
-	uint32_t physical_address = ((uint32_t)pte->ppn << MM_PAGE_SIZE_BITS) | offset;
-
-	// Now we can get values from physical memory
-	*value = phys_mem[physical_address];
-
-	return 0;
-}
-
-// Stores data into a virtual memory address
-int MM_StoreByte(int pid, uint32_t address, uint8_t value) {
-	// The VPN and offset are extracted from the virtual address
-	uint8_t vpn = (uint8_t)(address >> MM_PAGE_SIZE_BITS);
-	uint8_t offset = (uint8_t)(address & MM_PAGE_OFFSET_MASK);
-
-	struct process *const proc = &processes[pid];
-
-	// The page table must exist on the process in order to write to it
-	// TODO: Make sure all errors are in the past tense throughout this entire file
-	// TODO: Also try to standardize all errors
-	if(!proc->page_table_exists) {
-		DEBUG("attempted to write to a page table that does not exist\n");
-		return -1;
-	}
-
-	// If the page table isn't resident, then it can simply be loaded
-	if(!proc->page_table_resident) {
-		if(load_page_table(pid)) {
-			DEBUG("unable to load page table when attempting to read data\n");
-			return -1;
-		}
-	}
-
-	// Use vpn as index to find PTE for this page
-	struct page_table_entry *pte = &proc->page_table[vpn];
-
-	// You can't write to an invalid PTE
-	if(!pte->valid) {
-		DEBUG("attempting to write to invalid PTE\n");
-		return -1;
-	}
-
-	// You can't write to the PTE if it isn't writeable
-	if(!pte->writeable) {
-		DEBUG("attempting to write to a read only PTE\n");
-		return -1;
-	}
-
-	// If the PTE isn't present, then it must be loaded before it can be written to
-	if(!pte->present) {
-		// A PPN is reserved
-		int ppn = reserve_ppn(pid);
-
-		if(ppn == -1) {
-			DEBUG("unable to reserve PPN to write data\n");
-			
-			return -1;
-		}
-
-		// The PTE's PPN is set to the reserved PPN
-		pte->ppn = ppn;
-
-		// The page is then loaded into physical memory
-		if(load_page(pte, pid, vpn)) {
-			DEBUG("unable to load page to write data\n");
-			return -1;
-		}
-	}
-
-	// TODO: A lot of this could probably go in a helper function
-	// The PID's must match between physical memory and the function call
-	if(phys_pages[pte->ppn].pid != pid) {
-		DEBUG("phys page and load call PID's do not match when writing\n");
-		return -1;
-	}
-
-	// So do the VPN's
-	if(phys_pages[pte->ppn].vpn != vpn) {
-		DEBUG("phys page and load call VPN's do not match when writing\n");
-		return -1;
-	}
-
-	// The physical page must be valid to write to it
-	if(!phys_pages[pte->ppn].valid) {
-		DEBUG("attempting to write to invalid phys page\n");
-		return -1;
-	}
-
-	// Writing to a page table is highly unethical as it causes irreparable damage and requires
-	// years of emotionally and financially taxxing rehabilitation to repare.
-	if(phys_pages[pte->ppn].is_page_table) {
-		DEBUG("attempting to write memory to a page table\n");
-		return -1;
-	}
-
-	// Phyical pointer reassembled from PPN and offset
-	uint32_t physical_address = ((uint32_t)pte->ppn << MM_PAGE_SIZE_BITS) | offset;
-
-	// The value at the physical address is set
-	phys_mem[physical_address] = value;
-
-	// Finally, the PTE is marked as dirty so it gets ejected properly
-	pte->dirty = 1;
-
-	return 0;
-}
\ No newline at end of file
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <endian.h>
+
+#include "mm_api.h"
+#include "mm_internal.h"
+
+int debug = 0;
+void Debug() { debug = 1; }
+
+///////////////////////////////////////////////////////////////////////////////
+// All implementation goes in this file.                                     //
+///////////////////////////////////////////////////////////////////////////////
+
+// The instance the legacy MM_* calls use. Its locks are the only part that has to be set up
+// ahead of time, the rest is filled in by MM_Init()
+struct MM_Instance default_instance = {
+	.lock = PTHREAD_RWLOCK_INITIALIZER,
+	.policy_lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+__thread struct MM_Instance *mm = &default_instance;
+
+void dump_mem(int ppn) {
+	for(size_t i = (size_t)ppn * mm->page_size_bytes; i < (size_t)(ppn+1) * mm->page_size_bytes; i++)
+		printf("%x ", mm->phys_mem[i]);
+
+	printf("\n\n");
+}
+
+// A PTE in phys_mem is a little endian word of pte_size_bytes bytes: 1 or 2 for the smallest
+// geometries, or the fixed 32 and 64-bit layouts. Every width has the flags in the same low bits,
+// and everything above them is one field:
+//	bit 0		PTE_VALID	Has the entry been set up? (For leaf tables, all of them are)
+//	bit 1		PTE_WRITEABLE	Can the page be stored to?
+//	bit 2		PTE_PRESENT	Is the page (or the next level's table) in phys_mem?
+//	bit 3		PTE_DIRTY	Has the page been stored to since it came in?
+//	bit 4		PTE_REFERENCED	Has the page been mapped since it came in?
+//	bits 5 and up			If present, the PPN. If not, the data page's swap slot plus one,
+//					0 if it has no copy in swap, or all ones if the slot is too big
+//					for the field, in which case swap has to be asked
+// Entries in intermediate tables use the same format, where the PPN is the next level's table
+#define PTE_VALID_SHIFT		0
+#define PTE_WRITEABLE_SHIFT	1
+#define PTE_PRESENT_SHIFT	2
+#define PTE_DIRTY_SHIFT		3
+#define PTE_REFERENCED_SHIFT	4
+#define PTE_FIELD_SHIFT		5
+
+// The number of flag bits packed under the PPN in a PTE
+#define PTE_FLAG_BITS		PTE_FIELD_SHIFT
+
+// The decoded form of a PTE, see read_pte_from_mem() and write_pte_to_mem()
+struct page_table_entry {
+	uint32_t ppn;		// Physical page number, if present
+	uint64_t swap_slot;	// If not present, the field above the flags (see pte_set_swap_slot())
+	uint8_t valid;
+	uint8_t writeable;
+	uint8_t present;
+	uint8_t dirty;
+	uint8_t referenced;
+};
+
+// A simple function to print a PTE for debugging purposes
+void print_pte(struct page_table_entry *pte) {
+	DEBUG("PTE:\n");
+	DEBUG("		PPN: 		%u\n", pte->ppn);
+	DEBUG("		swap slot: 	%llu\n", (unsigned long long)pte->swap_slot);
+	DEBUG("		valid: 		%d\n", pte->valid);
+	DEBUG("		writeable: 	%d\n", pte->writeable);
+	DEBUG("		present: 	%d\n", pte->present);
+	DEBUG("		dirty: 		%d\n", pte->dirty);
+	DEBUG("		referenced: 	%d\n", pte->referenced);
+}
+
+// Encodes a PTE into phys_mem. It's all masks and shifts, so nothing depends on how the compiler
+// lays out the decoded struct
+void write_pte_to_mem(struct page_table_entry *pte, uint8_t *mem_addr) {
+	// All ones if the page is present, so the field can be picked without a branch
+	uint64_t present = -(uint64_t)(pte->present & 1);
+	uint64_t field = ((uint64_t)pte->ppn & present) | (pte->swap_slot & ~present);
+
+	uint64_t val = (field & mm->pte_field_mask) << PTE_FIELD_SHIFT;
+	val |= (uint64_t)(pte->referenced & 1) << PTE_REFERENCED_SHIFT;
+	val |= (uint64_t)(pte->dirty & 1) << PTE_DIRTY_SHIFT;
+	val |= (uint64_t)(pte->present & 1) << PTE_PRESENT_SHIFT;
+	val |= (uint64_t)(pte->writeable & 1) << PTE_WRITEABLE_SHIFT;
+	val |= (uint64_t)(pte->valid & 1) << PTE_VALID_SHIFT;
+
+	switch(mm->pte_size_bytes) {
+	case 1:
+		mem_addr[0] = (uint8_t)val;
+		break;
+	case 2: {
+		uint16_t word = htole16((uint16_t)val);
+		memcpy(mem_addr, &word, sizeof(word));
+		break;
+	}
+	case 4: {
+		uint32_t word = htole32((uint32_t)val);
+		memcpy(mem_addr, &word, sizeof(word));
+		break;
+	}
+	default: {
+		uint64_t word = htole64(val);
+		memcpy(mem_addr, &word, sizeof(word));
+		break;
+	}
+	}
+}
+
+// The opposite of write_pte_to_mem()
+struct page_table_entry read_pte_from_mem(const uint8_t *mem_addr) {
+	uint64_t val;
+
+	switch(mm->pte_size_bytes) {
+	case 1:
+		val = mem_addr[0];
+		break;
+	case 2: {
+		uint16_t word;
+		memcpy(&word, mem_addr, sizeof(word));
+		val = le16toh(word);
+		break;
+	}
+	case 4: {
+		uint32_t word;
+		memcpy(&word, mem_addr, sizeof(word));
+		val = le32toh(word);
+		break;
+	}
+	default: {
+		uint64_t word;
+		memcpy(&word, mem_addr, sizeof(word));
+		val = le64toh(word);
+		break;
+	}
+	}
+
+	struct page_table_entry pte;
+	uint64_t field = val >> PTE_FIELD_SHIFT;
+	uint64_t present = -((val >> PTE_PRESENT_SHIFT) & 1);
+
+	pte.ppn = (uint32_t)(field & present);
+	pte.swap_slot = field & ~present;
+	pte.referenced = (val >> PTE_REFERENCED_SHIFT) & 1;
+	pte.dirty = (val >> PTE_DIRTY_SHIFT) & 1;
+	pte.present = (val >> PTE_PRESENT_SHIFT) & 1;
+	pte.writeable = (val >> PTE_WRITEABLE_SHIFT) & 1;
+	pte.valid = (val >> PTE_VALID_SHIFT) & 1;
+
+	return pte;
+}
+
+// Records which swap slot a data page that's leaving phys_mem has its copy in (-1 for none)
+void pte_set_swap_slot(struct page_table_entry *pte, int64_t slot) {
+	if(slot < 0)
+		pte->swap_slot = 0;
+	else if((uint64_t)slot < mm->pte_field_mask - 1)
+		pte->swap_slot = (uint64_t)slot + 1;
+	else
+		pte->swap_slot = mm->pte_field_mask;
+}
+
+// Whether the data page behind a PTE that isn't present has a copy in swap
+int pte_in_swap(const struct page_table_entry *pte, struct page_key key) {
+	if(pte->swap_slot == mm->pte_field_mask)
+		return swap_contains(key);
+
+	return pte->swap_slot != 0;
+}
+
+// Whether that copy has to come off the swap device, which is what makes a fault a major one. A
+// page whose write is still in flight comes back out of the write's buffer
+int pte_on_device(const struct page_table_entry *pte, struct page_key key) {
+	if(pte->swap_slot == mm->pte_field_mask)
+		return swap_on_device(key);
+
+	return pte->swap_slot != 0 && !swap_pending(key);
+}
+
+// A cached translation in a process' software TLB. Only pages that are present in phys_mem are ever
+// cached, so a hit can go straight to phys_mem without touching the page table
+struct tlb_entry {
+	uint64_t vpn;
+	uint32_t ppn;
+	uint8_t valid;	// Not a bit field, since read_lockfree() reads it (and vpn and ppn) atomically
+	uint8_t writeable : 1;
+	uint8_t dirty : 1;	// The PTE is already marked dirty, so stores don't need to touch it
+};
+
+// Per-process metadata.
+struct process {
+	// If implementing page tables in phys_mem, this is 1 if this processes
+	// page table is currently resident in phys_mem.
+	// With a multi-level page table, this is about the root table.
+	uint8_t page_table_resident : 1;
+
+	// Has a page table for this process been allocated at all?
+	uint8_t page_table_exists : 1;
+
+	// The physical page holding this process' (root) page table, if resident in phys_mem.
+	int page_table_ppn;
+
+	// This process' slice of the software TLB (config.tlb_entries entries, grouped into sets of
+	// config.tlb_associativity ways), and the way to replace next when a set is full
+	struct tlb_entry *tlb;
+	uint32_t tlb_next_way;
+
+	// Held (along with mm->lock, shared) by calls that only go through this process' TLB, so the
+	// TLB and the process' data pages only have one of them at a time
+	pthread_mutex_t lock;
+
+	// Readahead state: the page that last faulted (or was the first use of a page read ahead), the
+	// stride between the last two, and how many pages to read ahead once a stride repeats
+	uint64_t readahead_last_vpn;
+	int64_t readahead_stride;
+	int readahead_window;
+};
+
+// Simple helper used to print process attributes for debugging
+void print_process(struct process *proc) {
+	DEBUG("Process:\n");
+	DEBUG("		Resident: 	%d\n", proc->page_table_resident);
+	DEBUG("		Exists: 	%d\n", proc->page_table_exists);
+	DEBUG("		Page Table: %d\n", proc->page_table_ppn);
+}
+
+uint64_t owner_key(int pid, uint64_t vpn) {
+	return vpn * mm->config.max_processes + pid + 1;
+}
+
+// Faults started by MM_FaultAsync() whose page is still being read in. The frame is reserved and
+// counted against its leaf table the whole time, but the PTE isn't marked present until the fault
+// is finished
+#define MAX_ASYNC_FAULTS	32
+
+struct async_fault {
+	int pid;
+	uint64_t vpn;
+	int ppn;
+	int handle; // From swap_read_start()
+	int readahead; // Started by readahead rather than MM_FaultAsync(), so it isn't reported
+	int unlocked; // Started by a fault that waits for it with mm->lock dropped, so it isn't reported either
+};
+
+// The most frames the cleaner looks at on one lap, so one fault never pays for a huge sweep
+#define WRITEBACK_MAX_SCAN	1024
+
+// Helper that returns the address in phys_mem of physical page 'ppn'.
+void *phys_mem_addr_for_frame(int ppn) {
+	return &mm->phys_mem[(size_t)ppn * mm->page_size_bytes];
+}
+
+// Reads entry 'index' of the page table in physical page 'table_ppn'
+struct page_table_entry get_pte(int table_ppn, uint64_t index) {
+	uint8_t *table = (uint8_t*)phys_mem_addr_for_frame(table_ppn);
+	return read_pte_from_mem(table + index * mm->pte_size_bytes);
+}
+
+// Writes back a PTE that was read with get_pte()
+void set_pte(int table_ppn, uint64_t index, struct page_table_entry *pte) {
+	uint8_t *table = (uint8_t*)phys_mem_addr_for_frame(table_ppn);
+	write_pte_to_mem(pte, table + index * mm->pte_size_bytes);
+}
+
+// The index into a table at 'level' that 'vpn' goes through
+uint64_t table_index(uint64_t vpn, int level) {
+	return (vpn >> (mm->bits_per_level * (mm->config.page_table_levels - 1 - level))) & (mm->entries_per_table - 1);
+}
+
+// The VPN prefix identifying the table at 'level' that 'vpn' goes through (the root's is always 0)
+uint64_t table_prefix(uint64_t vpn, int level) {
+	if(level == 0)
+		return 0;
+
+	return vpn >> (mm->bits_per_level * (mm->config.page_table_levels - level));
+}
+
+void MM_DefaultConfig(struct MM_Config *conf) {
+	conf->page_size_bits = MM_PAGE_SIZE_BITS;
+	conf->physical_memory_size_bytes = MM_PHYSICAL_MEMORY_SIZE_BYTES;
+	conf->process_virtual_memory_size_shift = MM_PROCESS_VIRTUAL_MEMORY_SIZE_SHIFT;
+	conf->max_processes = MM_MAX_PROCESSES;
+	conf->page_table_levels = 1;
+	conf->tlb_entries = 64;
+	conf->tlb_associativity = 4;
+	conf->replacement_policy = MM_POLICY_SIMPLE;
+	conf->swap_direct_io = 0;
+	conf->swap_path = NULL;
+	conf->swap_size_bytes = 0;
+	conf->swap_io_threads = 0;
+	conf->writeback_low_watermark = 0;
+	conf->writeback_high_watermark = 0;
+	conf->readahead_max_pages = 0;
+	conf->endianness = MM_LITTLE_ENDIAN;
+	conf->stats_dump_interval_ms = 0;
+	conf->stats_dump_path = NULL;
+	conf->pte_size_bytes = 0;
+}
+
+static void free_frame_table() {
+	struct frame_table *frames = &mm->frames;
+
+	free(frames->pid);
+	free(frames->vpn);
+	free(frames->resident_children);
+	free(frames->level);
+	free(frames->valid);
+	free(frames->page_table);
+	free(frames->pinned);
+	free(frames->dirty);
+	free(frames->prefetched);
+	memset(frames, 0, sizeof(*frames));
+}
+
+// Every frame starts out empty. Returns -1 if the table couldn't be allocated
+static int alloc_frame_table() {
+	struct frame_table *frames = &mm->frames;
+
+	frames->num_words = (mm->num_phys_pages + 63) / 64;
+	frames->pid = calloc(mm->num_phys_pages, sizeof(int));
+	frames->vpn = calloc(mm->num_phys_pages, sizeof(int64_t));
+	frames->resident_children = calloc(mm->num_phys_pages, sizeof(int));
+	frames->level = calloc(mm->num_phys_pages, sizeof(uint8_t));
+	frames->valid = calloc(frames->num_words, sizeof(uint64_t));
+	frames->page_table = calloc(frames->num_words, sizeof(uint64_t));
+	frames->pinned = calloc(frames->num_words, sizeof(uint64_t));
+	frames->dirty = calloc(frames->num_words, sizeof(uint64_t));
+	frames->prefetched = calloc(frames->num_words, sizeof(uint64_t));
+
+	if(frames->pid == NULL || frames->vpn == NULL || frames->resident_children == NULL || frames->level == NULL ||
+		frames->valid == NULL || frames->page_table == NULL || frames->pinned == NULL || frames->dirty == NULL ||
+		frames->prefetched == NULL)
+		return -1;
+
+	for(int i = 0; i < mm->num_phys_pages; i++) {
+		frames->pid[i] = -1;
+		frames->vpn[i] = -1;
+	}
+
+	return 0;
+}
+
+// Frees everything MM_Init() allocated
+void free_state() {
+	swap_destroy();
+	policy_destroy();
+	stats_destroy();
+	mm->num_async_faults = 0;
+	mm->num_data_pages = 0;
+	mm->num_dirty_pages = 0;
+	mm->clean_hand = 0;
+
+	for(int i = 0; mm->processes != NULL && i < mm->config.max_processes; i++)
+		pthread_mutex_destroy(&mm->processes[i].lock);
+
+	free(mm->processes);
+	free(mm->tlbs);
+	free_frame_table();
+	free(mm->free_ppns);
+	free(mm->frame_seq);
+	free(mm->frame_owner);
+	free(mm->async_faults);
+	free(mm->phys_mem);
+
+	mm->processes = NULL;
+	mm->tlbs = NULL;
+	mm->free_ppns = NULL;
+	mm->frame_seq = NULL;
+	mm->frame_owner = NULL;
+	mm->async_faults = NULL;
+	mm->num_free_ppns = 0;
+	mm->phys_mem = NULL;
+	mm->swap_enabled = 0;
+}
+
+int init_state(const struct MM_Config *conf) {
+	struct MM_Config defaults;
+	if(conf == NULL) {
+		MM_DefaultConfig(&defaults);
+		conf = &defaults;
+	}
+
+	// The page has to at least be big enough for a few PTEs, and the swap file offsets and
+	// Frame table entries are ints, so 64 KiB pages is plenty
+	if(conf->page_size_bits < 4 || conf->page_size_bits > 16) {
+		DEBUG("page size bits %d out of range\n", conf->page_size_bits);
+		return -1;
+	}
+
+	uint64_t page_bytes = (uint64_t)1 << conf->page_size_bits;
+	if(conf->physical_memory_size_bytes < page_bytes || conf->physical_memory_size_bytes % page_bytes != 0) {
+		DEBUG("physical memory must be a non-zero multiple of the page size\n");
+		return -1;
+	}
+
+	// PPNs are handed around as ints, with -1 meaning failure
+	uint64_t phys_page_count = conf->physical_memory_size_bytes / page_bytes;
+	if(phys_page_count > INT32_MAX) {
+		DEBUG("too many physical pages\n");
+		return -1;
+	}
+
+	if(conf->process_virtual_memory_size_shift < conf->page_size_bits ||
+			conf->process_virtual_memory_size_shift > 48) {
+		DEBUG("virtual memory size shift %d out of range\n", conf->process_virtual_memory_size_shift);
+		return -1;
+	}
+
+	// owner_key() packs the pid in with a VPN of up to 44 bits
+	if(conf->max_processes < 1 || conf->max_processes > (1 << 16)) {
+		DEBUG("max processes %d out of range\n", conf->max_processes);
+		return -1;
+	}
+
+	if(conf->page_table_levels < 1 || conf->page_table_levels > 4) {
+		DEBUG("page table levels %d out of range\n", conf->page_table_levels);
+		return -1;
+	}
+
+	// The TLB is indexed by masking the VPN, so the sizes have to be powers of two
+	if(conf->tlb_entries < 0 || (conf->tlb_entries & (conf->tlb_entries - 1)) != 0) {
+		DEBUG("TLB entries %d must be 0 or a power of two\n", conf->tlb_entries);
+		return -1;
+	}
+
+	if(conf->tlb_entries > 0 && (conf->tlb_associativity < 1 || conf->tlb_associativity > conf->tlb_entries ||
+			(conf->tlb_associativity & (conf->tlb_associativity - 1)) != 0)) {
+		DEBUG("TLB associativity %d must be a power of two no bigger than the TLB\n", conf->tlb_associativity);
+		return -1;
+	}
+
+	if(conf->writeback_low_watermark < 0 || conf->writeback_high_watermark < conf->writeback_low_watermark ||
+			(uint64_t)conf->writeback_high_watermark > phys_page_count) {
+		DEBUG("writeback watermarks %d-%d out of range\n", conf->writeback_low_watermark, conf->writeback_high_watermark);
+		return -1;
+	}
+
+	if(conf->readahead_max_pages < 0 || conf->readahead_max_pages > MAX_ASYNC_FAULTS / 2) {
+		DEBUG("readahead of %d pages out of range\n", conf->readahead_max_pages);
+		return -1;
+	}
+
+	if(conf->endianness != MM_LITTLE_ENDIAN && conf->endianness != MM_BIG_ENDIAN) {
+		DEBUG("unknown endianness %d\n", conf->endianness);
+		return -1;
+	}
+
+	if(conf->stats_dump_interval_ms < 0) {
+		DEBUG("stats dump interval %d out of range\n", conf->stats_dump_interval_ms);
+		return -1;
+	}
+
+	// The PTE has to be wide enough for the flags plus the largest PPN. Unless a width is asked for,
+	// it's the smallest that is
+	int ppn_bits = 1;
+	while(ppn_bits < 32 && ((uint64_t)1 << ppn_bits) < phys_page_count)
+		ppn_bits++;
+
+	int pte_bits = PTE_FLAG_BITS + ppn_bits;
+	int pte_bytes = pte_bits <= 8 ? 1 : pte_bits <= 16 ? 2 : pte_bits <= 32 ? 4 : 8;
+
+	if(conf->pte_size_bytes != 0) {
+		if(conf->pte_size_bytes != 1 && conf->pte_size_bytes != 2 && conf->pte_size_bytes != 4 && conf->pte_size_bytes != 8) {
+			DEBUG("PTE size %d must be 1, 2, 4 or 8 bytes\n", conf->pte_size_bytes);
+			return -1;
+		}
+		if(conf->pte_size_bytes < pte_bytes) {
+			DEBUG("%d byte PTEs are too small for %llu physical pages\n", conf->pte_size_bytes,
+				(unsigned long long)phys_page_count);
+			return -1;
+		}
+		pte_bytes = conf->pte_size_bytes;
+	}
+
+	// Each table is a page of PTEs, and the levels together have to cover every VPN bit
+	int level_bits = 0;
+	while(((uint64_t)pte_bytes << (level_bits + 1)) <= page_bytes)
+		level_bits++;
+
+	int vpn_bits = conf->process_virtual_memory_size_shift - conf->page_size_bits;
+	if(vpn_bits > level_bits * conf->page_table_levels) {
+		DEBUG("cannot fit page table in %d level(s)\n", conf->page_table_levels);
+		return -1;
+	}
+
+	// Everything checks out, so the old state can go
+	free_state();
+
+	mm->config = *conf;
+	mm->page_size_bytes = (int)page_bytes;
+	mm->page_offset_mask = page_bytes - 1;
+	mm->num_phys_pages = (int)phys_page_count;
+	mm->process_virtual_memory_size_bytes = (uint64_t)1 << conf->process_virtual_memory_size_shift;
+	mm->num_virtual_pages = (uint64_t)1 << vpn_bits;
+	mm->pte_size_bytes = pte_bytes;
+	mm->pte_field_mask = ((uint64_t)1 << (8 * pte_bytes - PTE_FIELD_SHIFT)) - 1;
+	mm->entries_per_table = 1 << level_bits;
+	mm->bits_per_level = level_bits;
+
+	// calloc() leaves the memory zeroed, which is what a fresh physical page should look like
+	mm->phys_mem = calloc(conf->physical_memory_size_bytes, 1);
+	mm->free_ppns = calloc(mm->num_phys_pages, sizeof(int));
+	mm->frame_seq = calloc(mm->num_phys_pages, sizeof(uint32_t));
+	mm->frame_owner = calloc(mm->num_phys_pages, sizeof(uint64_t));
+	mm->async_faults = calloc(MAX_ASYNC_FAULTS, sizeof(struct async_fault));
+	mm->processes = calloc(mm->config.max_processes, sizeof(struct process));
+	mm->tlbs = calloc((size_t)mm->config.max_processes * mm->config.tlb_entries + 1, sizeof(struct tlb_entry));
+
+	if(mm->phys_mem == NULL || alloc_frame_table() || mm->free_ppns == NULL || mm->frame_seq == NULL || mm->frame_owner == NULL ||
+		mm->async_faults == NULL || mm->processes == NULL || mm->tlbs == NULL) {
+		DEBUG("unable to allocate memory manager state\n");
+		free_state();
+		return -1;
+	}
+
+	if(mm->config.tlb_entries > 0)
+		mm->tlb_set_mask = mm->config.tlb_entries / mm->config.tlb_associativity - 1;
+
+	for(int i = 0; i < mm->config.max_processes; i++) {
+		pthread_mutex_init(&mm->processes[i].lock, NULL);
+		mm->processes[i].tlb = &mm->tlbs[(size_t)i * mm->config.tlb_entries];
+		mm->processes[i].readahead_window = mm->config.readahead_max_pages < 2 ? mm->config.readahead_max_pages : 2;
+	}
+
+	if(stats_init() || policy_init(mm->config.replacement_policy) || swap_init()) {
+		free_state();
+		return -1;
+	}
+
+	// Every frame starts out free. They're pushed in reverse so the lowest PPNs get used first
+	for(int i = mm->num_phys_pages - 1; i >= 0; i--)
+		mm->free_ppns[mm->num_free_ppns++] = i;
+
+	return 0;
+}
+
+int MM_Init_ex(struct MM_Instance *instance, const struct MM_Config *conf) {
+	mm = instance;
+
+	pthread_rwlock_wrlock(&mm->lock);
+	int ret = init_state(conf);
+	pthread_rwlock_unlock(&mm->lock);
+
+	return ret;
+}
+
+int MM_Init(const struct MM_Config *conf) {
+	return MM_Init_ex(&default_instance, conf);
+}
+
+int ensure_init() {
+	if(__atomic_load_n(&mm->phys_mem, __ATOMIC_ACQUIRE) != NULL)
+		return 0;
+
+	// Two threads can both find nothing set up, so it's checked again under the lock
+	int ret = 0;
+	pthread_rwlock_wrlock(&mm->lock);
+	if(mm->phys_mem == NULL)
+		ret = init_state(NULL);
+	pthread_rwlock_unlock(&mm->lock);
+
+	return ret;
+}
+
+struct MM_Instance *MM_Create(const struct MM_Config *conf) {
+	// Only used to tell default swap paths apart
+	static int next_id = 0;
+
+	struct MM_Instance *instance = calloc(1, sizeof(struct MM_Instance));
+	if(instance == NULL)
+		return NULL;
+
+	pthread_rwlock_init(&instance->lock, NULL);
+	pthread_mutex_init(&instance->policy_lock, NULL);
+	instance->id = __atomic_add_fetch(&next_id, 1, __ATOMIC_RELAXED);
+
+	if(MM_Init_ex(instance, conf)) {
+		MM_Destroy(instance);
+		return NULL;
+	}
+
+	return instance;
+}
+
+void MM_Destroy(struct MM_Instance *instance) {
+	if(instance == NULL)
+		return;
+
+	mm = instance;
+	free_state();
+	pthread_rwlock_destroy(&instance->lock);
+	pthread_mutex_destroy(&instance->policy_lock);
+	free(instance);
+
+	// Don't leave this thread pointing at freed memory
+	mm = &default_instance;
+}
+
+// Looks up a translation in a process' TLB, returning NULL on a miss
+struct tlb_entry *tlb_lookup(struct process *proc, uint64_t vpn) {
+	if(mm->config.tlb_entries == 0)
+		return NULL;
+
+	struct tlb_entry *set = &proc->tlb[(vpn & mm->tlb_set_mask) * mm->config.tlb_associativity];
+	for(int way = 0; way < mm->config.tlb_associativity; way++)
+		if(set[way].valid && set[way].vpn == vpn)
+			return &set[way];
+
+	return NULL;
+}
+
+// Caches the translation for a present PTE, replacing an entry in its set if it's full
+void tlb_insert(struct process *proc, uint64_t vpn, struct page_table_entry *pte) {
+	if(mm->config.tlb_entries == 0)
+		return;
+
+	struct tlb_entry *entry = tlb_lookup(proc, vpn);
+
+	if(entry == NULL) {
+		struct tlb_entry *set = &proc->tlb[(vpn & mm->tlb_set_mask) * mm->config.tlb_associativity];
+
+		// An empty way is the best place for it, otherwise the ways are replaced round robin
+		for(int way = 0; way < mm->config.tlb_associativity && entry == NULL; way++)
+			if(!set[way].valid)
+				entry = &set[way];
+
+		if(entry == NULL)
+			entry = &set[proc->tlb_next_way++ % mm->config.tlb_associativity];
+	}
+
+	__atomic_store_n(&entry->vpn, vpn, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->ppn, pte->ppn, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->valid, 1, __ATOMIC_RELAXED);
+	entry->writeable = pte->writeable;
+	entry->dirty = pte->dirty;
+}
+
+// Shoots down the translation for one page, if it's cached. This has to happen whenever the page
+// leaves phys_mem or its permissions change
+void tlb_invalidate(struct process *proc, uint64_t vpn) {
+	struct tlb_entry *entry = tlb_lookup(proc, vpn);
+
+	if(entry != NULL)
+		__atomic_store_n(&entry->valid, 0, __ATOMIC_RELAXED);
+}
+
+// How swap knows the page in frame 'ppn'. Tables are known by their level and VPN prefix
+struct page_key swap_key(int ppn) {
+	struct page_key key;
+	key.pid = mm->frames.pid[ppn];
+	key.kind = frame_test(mm->frames.page_table, ppn) ? mm->frames.level[ppn] + 1 : 0;
+	key.vpn = mm->frames.vpn[ppn];
+
+	return key;
+}
+
+void MM_SwapOn_ex(struct MM_Instance *instance) {
+	mm = instance;
+
+	CHECK(ensure_init() == 0);
+
+	pthread_rwlock_wrlock(&mm->lock);
+	mm->swap_enabled = 1;
+	pthread_rwlock_unlock(&mm->lock);
+}
+
+void MM_SwapOn() {
+	MM_SwapOn_ex(&default_instance);
+}
+
+// Finds the resident table at 'level' that 'vpn' goes through. Everything above a resident page
+// is always resident, so this never has to load anything
+int resident_table_ppn(struct process *proc, uint64_t vpn, int level) {
+	int ppn = proc->page_table_ppn;
+
+	for(int l = 0; l < level; l++) {
+		struct page_table_entry entry = get_pte(ppn, table_index(vpn, l));
+
+		if(!entry.valid || !entry.present)
+			return -1;
+
+		ppn = entry.ppn;
+	}
+
+	return ppn;
+}
+
+// A page that was read ahead got used, so the window grows
+void readahead_hit(int pid) {
+	struct process *const proc = &mm->processes[pid];
+	if(proc->readahead_window < mm->config.readahead_max_pages)
+		proc->readahead_window++;
+}
+
+// A page that was read ahead got ejected without ever being used, so the window shrinks
+void readahead_wasted(int pid) {
+	struct process *const proc = &mm->processes[pid];
+	proc->readahead_window = proc->readahead_window > 1 ? proc->readahead_window / 2 : 1;
+}
+
+// Ejects a physical page taking in a PID that the new process will be saved to
+int eject_phys_page(int reserving_pid) {
+	// The replacement policy picks the page. It only ever picks data pages, or page tables with
+	// nothing resident under them
+	int ppn_to_eject = policy_choose_victim(reserving_pid);
+
+	// We should never reach this, but it's always good to check in case there's a bug
+	if(ppn_to_eject == -1) {
+		DEBUG("couldn't find a page to eject\n");
+		return -1;
+	}
+
+	// The process we're interested in is the one attached to the page we chose to eject
+	struct process *const proc = &mm->processes[mm->frames.pid[ppn_to_eject]];
+	const int is_page_table = frame_test(mm->frames.page_table, ppn_to_eject);
+
+	// We get the pointer to the memory holding the data we wish to eject
+	uint8_t *mem = (uint8_t*)phys_mem_addr_for_frame(ppn_to_eject);
+
+	// We also assume that the data is dirty by default because we don't check if page tables
+	// are dirty (at least not in this version). A data page's dirty bit mirrors its PTE's
+	int is_dirty = is_page_table || frame_test(mm->frames.dirty, ppn_to_eject);
+
+	// If the data is dirty (page tables should always be dirty), then we eject the data into
+	// swap. This happens before anything else changes, so if swap is full the page just stays put
+	struct page_key key = swap_key(ppn_to_eject);
+	if(is_dirty && swap_write(key, mem))
+		return -1;
+
+	stat_add(is_page_table ? STAT_EVICTIONS_PAGE_TABLE : STAT_EVICTIONS_DATA, 1);
+	stat_add(mm->frames.pid[ppn_to_eject] == reserving_pid ? STAT_EVICTIONS_SAME_PID : STAT_EVICTIONS_OTHER_PID, 1);
+	stat_add(STAT_WRITEBACKS, is_dirty);
+
+	// From here on the frame is changing, so a load that doesn't hold mm->lock has to notice
+	uint32_t seq = mm->frame_seq[ppn_to_eject];
+	__atomic_store_n(&mm->frame_seq[ppn_to_eject], seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&mm->frame_owner[ppn_to_eject], 0, __ATOMIC_RELAXED);
+
+	policy_remove(ppn_to_eject);
+
+	// If the page isn't a page table, then we eject it by its PTE
+	if(!is_page_table) {
+		uint64_t vpn_to_eject = mm->frames.vpn[ppn_to_eject];
+
+		// This involves resetting the PTE to its unallocated values
+		int leaf_ppn = resident_table_ppn(proc, vpn_to_eject, mm->config.page_table_levels - 1);
+		uint64_t index = table_index(vpn_to_eject, mm->config.page_table_levels - 1);
+
+		struct page_table_entry pte_to_eject = get_pte(leaf_ppn, index);
+		mm->num_data_pages--;
+		mm->num_dirty_pages -= pte_to_eject.dirty;
+
+		if(frame_test(mm->frames.prefetched, ppn_to_eject))
+			readahead_wasted(mm->frames.pid[ppn_to_eject]);
+
+		// Where the page's copy in swap is goes in place of the PPN, so faults and readahead can
+		// usually tell whether there is one without asking swap
+		pte_to_eject.ppn = 0;
+		pte_to_eject.present = 0;
+		pte_to_eject.dirty = 0;
+		pte_to_eject.referenced = 0;
+		pte_set_swap_slot(&pte_to_eject, mm->swap_enabled ? swap_slot(key) : -1);
+		set_pte(leaf_ppn, index, &pte_to_eject);
+
+		frame_add_children(leaf_ppn, -1);
+
+		// The page isn't in phys_mem anymore, so its translation can't be used either
+		tlb_invalidate(proc, vpn_to_eject);
+	} else if(mm->frames.level[ppn_to_eject] == 0) {
+		// If it's a root page table, we're really only interested in resetting the resident flag
+		proc->page_table_resident = 0;
+	} else {
+		// Otherwise the entry pointing at it in the table above has to be marked not present
+		int level = mm->frames.level[ppn_to_eject];
+		uint64_t vpn = (uint64_t)mm->frames.vpn[ppn_to_eject] << (mm->bits_per_level * (mm->config.page_table_levels - level));
+
+		int parent_ppn = resident_table_ppn(proc, vpn, level - 1);
+		uint64_t index = table_index(vpn, level - 1);
+
+		struct page_table_entry entry = get_pte(parent_ppn, index);
+		entry.ppn = 0;
+		entry.present = 0;
+		set_pte(parent_ppn, index, &entry);
+
+		frame_add_children(parent_ppn, -1);
+	}
+
+	// The frame is zeroed out so the next user of it doesn't see old data
+	memset(mem, 0, mm->page_size_bytes);
+
+	// We have to reset the physical page flags, but their defaults are the same between
+	// page table and data table ejection
+	mm->frames.pid[ppn_to_eject] = -1;
+	mm->frames.vpn[ppn_to_eject] = -1;
+	mm->frames.resident_children[ppn_to_eject] = 0;
+	mm->frames.level[ppn_to_eject] = 0;
+	frame_clear(mm->frames.valid, ppn_to_eject);
+	frame_clear(mm->frames.page_table, ppn_to_eject);
+	frame_clear(mm->frames.pinned, ppn_to_eject);
+	frame_clear(mm->frames.dirty, ppn_to_eject);
+	frame_clear(mm->frames.prefetched, ppn_to_eject);
+
+	__atomic_store_n(&mm->frame_seq[ppn_to_eject], seq + 2, __ATOMIC_RELEASE);
+
+	// Finally, we return the PPN that we chose to eject
+	return ppn_to_eject;
+}
+
+// Writes a dirty data page out ahead of time, so ejecting it later doesn't have to. Returns 1 if
+// it was written, 0 if it was already clean, or -1 on error
+int clean_page(int ppn) {
+	struct process *const proc = &mm->processes[mm->frames.pid[ppn]];
+	uint64_t vpn = mm->frames.vpn[ppn];
+
+	int leaf_ppn = resident_table_ppn(proc, vpn, mm->config.page_table_levels - 1);
+	uint64_t index = table_index(vpn, mm->config.page_table_levels - 1);
+	struct page_table_entry pte = get_pte(leaf_ppn, index);
+
+	if(!pte.dirty)
+		return 0;
+
+	uint8_t *mem = (uint8_t*)phys_mem_addr_for_frame(ppn);
+	if(swap_write(swap_key(ppn), mem))
+		return -1;
+
+	stat_add(STAT_WRITEBACKS, 1);
+
+	// The next store has to take the slow path to dirty the page again, so the TLB can't say it's
+	// dirty either
+	pte.dirty = 0;
+	set_pte(leaf_ppn, index, &pte);
+
+	struct tlb_entry *entry = tlb_lookup(proc, vpn);
+	if(entry != NULL)
+		entry->dirty = 0;
+
+	mm->num_dirty_pages--;
+	frame_clear(mm->frames.dirty, ppn);
+
+	return 1;
+}
+
+// Called whenever a frame is about to be handed out. If too few frames are ready to drop, the
+// cleaning hand writes back dirty pages until there are enough again. The copy is all that
+// happens here, since the writes themselves are done by the swap I/O threads
+void writeback_check() {
+	if(!mm->swap_enabled || mm->config.writeback_low_watermark == 0)
+		return;
+
+	int ready = mm->num_free_ppns + mm->num_data_pages - mm->num_dirty_pages;
+	if(ready >= mm->config.writeback_low_watermark)
+		return;
+
+	int lap = mm->num_phys_pages < WRITEBACK_MAX_SCAN ? mm->num_phys_pages : WRITEBACK_MAX_SCAN;
+
+	for(int scanned = 0; scanned < 2 * lap && ready < mm->config.writeback_high_watermark && mm->num_dirty_pages > 0; scanned++) {
+		int ppn = mm->clean_hand;
+
+		// Only dirty data pages are of any use, so the rest of a word with none is skipped at once
+		uint64_t dirty = mm->frames.dirty[ppn >> 6] >> (ppn & 63);
+		if(dirty == 0) {
+			int skip = 64 - (ppn & 63);
+			if(skip > mm->num_phys_pages - ppn)
+				skip = mm->num_phys_pages - ppn;
+			mm->clean_hand = (ppn + skip) % mm->num_phys_pages;
+			scanned += skip - 1;
+			continue;
+		}
+
+		mm->clean_hand = (mm->clean_hand + 1) % mm->num_phys_pages;
+		if(!(dirty & 1))
+			continue;
+
+		// A page that was just used is likely to be dirtied again, so those are passed over on
+		// the first lap
+		if(scanned < lap && policy_idle_time(ppn) < (uint64_t)mm->num_phys_pages)
+			continue;
+
+		if(clean_page(ppn) == 1)
+			ready++;
+	}
+}
+
+// Defined below, with the rest of readahead
+int finish_readahead();
+
+// Reserves a PPN to make space in physical memory for a new page given a PID
+int reserve_ppn(int reserving_pid) {
+	writeback_check();
+
+	// Ideally, there's a page that's empty (invalid) and we can just use it
+	if(mm->num_free_ppns > 0)
+		return mm->free_ppns[--mm->num_free_ppns];
+
+	if(!mm->swap_enabled) {
+		// If we don't find an empty page, and swap is disabled, then we get an error
+		DEBUG("pages full and swap disabled\n");
+		return -1;
+	} else {
+		// Otherwise, we return the best PPN found by ejecting a page
+		int ppn = eject_phys_page(reserving_pid);
+
+		// Pages being read ahead hold frames (and pin their tables) that can't be ejected until
+		// they're in. If that's all that's left, finishing them gives the policy something to pick
+		if(ppn == -1 && finish_readahead() > 0)
+			ppn = eject_phys_page(reserving_pid);
+
+		return ppn;
+	}
+}
+
+// Gives back a PPN from reserve_ppn() that never ended up holding a page
+void release_ppn(int ppn) {
+	mm->free_ppns[mm->num_free_ppns++] = ppn;
+}
+
+// Sets up a freshly reserved physical page as a page table at 'level'. Leaf tables start with
+// every PTE valid but not yet accessible, while intermediate tables start out empty so their
+// children are only allocated once something under them is mapped
+void init_page_table(int ppn, int pid, int level, uint64_t prefix) {
+	uint8_t *mem = (uint8_t*)phys_mem_addr_for_frame(ppn);
+	memset(mem, 0, mm->page_size_bytes);
+
+	if(level == mm->config.page_table_levels - 1) {
+		for(int i = 0; i < mm->entries_per_table; i++) {
+			struct page_table_entry new_pte;
+			new_pte.ppn = 0;
+			new_pte.swap_slot = 0;
+			new_pte.valid = 1;
+			new_pte.writeable = 0;
+			new_pte.present = 0;
+			new_pte.dirty = 0;
+			new_pte.referenced = 0;
+
+			set_pte(ppn, i, &new_pte);
+		}
+	}
+
+	// The physical page flags need to be set for a page table as well
+	mm->frames.pid[ppn] = pid;
+	mm->frames.vpn[ppn] = prefix;
+	mm->frames.resident_children[ppn] = 0;
+	frame_clear(mm->frames.pinned, ppn);
+	frame_set(mm->frames.valid, ppn);
+	frame_set(mm->frames.page_table, ppn);
+	mm->frames.level[ppn] = level;
+
+	policy_insert(ppn);
+}
+
+// Initializes a page table for a given process identified by its PID
+int create_page_table(int pid) {
+	struct process *const proc = &mm->processes[pid];
+
+	if(proc == NULL) {
+		DEBUG("process is NULL when creating page table\n");
+		return -1;
+	}
+
+	// We reserve a PPN to use for this page table
+	int ppn = reserve_ppn(pid);
+
+	// We throw an error if the PPN is -1 because we cannot continue from here
+	if(ppn == -1) {
+		DEBUG("unable to reserve PPN when creating page table\n");
+		return -1;
+	}
+
+	init_page_table(ppn, pid, 0, 0);
+
+	// The page table and flags within the process are set
+	proc->page_table_ppn = ppn;
+	proc->page_table_exists = 1;
+	proc->page_table_resident = 1;
+
+	return 0;
+}
+
+// Loads data pages into memory from a swap file taking in the PTE of the entry, PID, and VPN
+// Marks a data page whose contents are in frame pte->ppn as resident
+void install_page(struct page_table_entry *pte, int pid, int64_t vpn) {
+	// The physical page flags are set for a data table
+	mm->frames.pid[pte->ppn] = pid;
+	frame_set(mm->frames.valid, pte->ppn);
+	frame_clear(mm->frames.page_table, pte->ppn);
+	mm->frames.vpn[pte->ppn] = vpn;
+
+	policy_insert(pte->ppn);
+	mm->num_data_pages++;
+	frame_clear(mm->frames.dirty, pte->ppn);
+	frame_clear(mm->frames.prefetched, pte->ppn);
+
+	// The PTE flags are set to show that the data has been loaded and is fresh
+	pte->present = 1;
+	pte->dirty = 0;
+	pte->referenced = 0;
+
+	// The page's contents are all there, so read_lockfree() can start trusting the frame
+	__atomic_store_n(&mm->frame_owner[pte->ppn], owner_key(pid, vpn), __ATOMIC_RELEASE);
+}
+
+int load_page(struct page_table_entry *pte, int pid, int64_t vpn) {
+	// The PTE has to be valid to load the page
+	if(!pte->valid) {
+		DEBUG("attempted to load invalid PTE\n");
+		return -1;
+	}
+
+	// The physical page can't be valid to load the page
+	if(frame_test(mm->frames.valid, pte->ppn)) {
+		DEBUG("attempted to load page into valid physical page\n");
+		return -1;
+	}
+
+	// If the PTE is already present, then we have nothing to do
+	if(pte->present) {
+		DEBUG("PTE is already present in memory\n");
+		return 0;
+	}
+
+	// If the VPN is negative, then what are we even loading in?
+	if(vpn == -1) {
+		DEBUG("attempted to load from an invalid VPN\n");
+		return -1;
+	}
+
+	// You can only load a swap file if swap is enabled. This function is also used to initialize
+	// a physical page when swap is enabled or disabled
+	if(mm->swap_enabled) {
+		uint8_t *mem = (uint8_t*)phys_mem_addr_for_frame(pte->ppn);
+
+		if(swap_read((struct page_key){ pid, 0, vpn }, mem))
+			return -1;
+	}
+
+	install_page(pte, pid, vpn);
+
+	return 0;
+}
+
+// A simple helper used to check simple memory info and throw an error back out to the MM_Map message
+// if one is found
+int check_mem_info(int pid, uint64_t address, char message[128]) {
+	// PID out of range
+	if(pid >= mm->config.max_processes || pid < 0) {
+		sprintf(message, "pid out of range");
+		return 1;
+	}
+
+	// Address out of range
+	if(address >= mm->process_virtual_memory_size_bytes) {
+		sprintf(message, "address out of range");
+		return 1;
+	}
+
+	return 0;
+}
+
+// Similar to loading a data page, but instead it's a page table
+// TODO: This can almost certainly be combined with the other load function somehow
+int load_page_table(int pid) {
+	struct process *const proc = &mm->processes[pid];
+
+	// Can't load if there's no process to load for
+	if(proc == NULL) {
+		DEBUG("process is NULL when loading page table\n");
+		return -1;
+	}
+
+	// Also can't load if the page table doesn't exist
+	if(!proc->page_table_exists) {
+		DEBUG("attempting to load a page table that does not exist\n");
+		return -1;
+	}
+
+	// If the page table is already resident in memory, then we have nothing to do
+	if(proc->page_table_resident) {
+		DEBUG("page table already resident in memory\n");
+		return 0;
+	}
+
+	// Just like a data page, we need to reserve a PPN
+	int ppn = reserve_ppn(pid);
+
+	// Can't continue if the PPN is invalid
+	if(ppn == -1) {
+		DEBUG("unable to reserve PPN when loading page table\n");
+		return -1;
+	}
+
+	// A pointer to the memory we want to load into is acquired
+	uint8_t *mem = (uint8_t*)phys_mem_addr_for_frame(ppn);
+	struct page_key key = { pid, 1, 0 };
+	if(swap_read(key, mem)) {
+		release_ppn(ppn);
+		return -1;
+	}
+
+	// Tables are written out every time they're ejected, so the copy in swap isn't needed anymore
+	swap_discard(key);
+
+	// We need to set the process' page table as resident
+	proc->page_table_ppn = ppn;
+	proc->page_table_resident = 1;
+
+	// The flags of the physical page also need to be set accordingly for a page table. Nothing
+	// under a table is ever resident once it's been swapped out
+	mm->frames.pid[ppn] = pid;
+	mm->frames.vpn[ppn] = 0;
+	mm->frames.resident_children[ppn] = 0;
+	frame_clear(mm->frames.pinned, ppn);
+	frame_set(mm->frames.valid, ppn);
+	frame_set(mm->frames.page_table, ppn);
+	mm->frames.level[ppn] = 0;
+
+	policy_insert(ppn);
+
+	return 0;
+}
+
+// Walks from the (resident) root table down to the leaf table that holds the PTE for 'vpn',
+// returning the leaf table's PPN. Intermediate tables that were swapped out are loaded back in,
+// and missing ones are allocated if 'create' is set. Returns -1 if the walk can't be completed
+int walk_page_table(int pid, uint64_t vpn, int create) {
+	struct process *const proc = &mm->processes[pid];
+	int ppn = proc->page_table_ppn;
+
+	for(int level = 0; level < mm->config.page_table_levels - 1; level++) {
+		uint64_t index = table_index(vpn, level);
+		struct page_table_entry entry = get_pte(ppn, index);
+
+		if(entry.valid && entry.present) {
+			ppn = entry.ppn;
+			continue;
+		}
+
+		if(!entry.valid && !create) {
+			DEBUG("no page table at level %d for vpn %lu\n", level + 1, (unsigned long)vpn);
+			return -1;
+		}
+
+		// The child is about to be resident, so it's counted before reserving its page. This also
+		// keeps this table from being ejected while the child is being brought in
+		frame_add_children(ppn, 1);
+
+		int child_ppn = reserve_ppn(pid);
+		if(child_ppn == -1) {
+			DEBUG("unable to reserve PPN for level %d page table\n", level + 1);
+			frame_add_children(ppn, -1);
+			return -1;
+		}
+
+		uint64_t prefix = table_prefix(vpn, level + 1);
+		init_page_table(child_ppn, pid, level + 1, prefix);
+
+		// A table that was swapped out is read back over the freshly initialized one
+		if(entry.valid) {
+			uint8_t *mem = (uint8_t*)phys_mem_addr_for_frame(child_ppn);
+			struct page_key key = { pid, level + 2, (int64_t)prefix };
+			if(swap_read(key, mem)) {
+				policy_remove(child_ppn);
+				frame_clear(mm->frames.valid, child_ppn);
+				frame_clear(mm->frames.page_table, child_ppn);
+				release_ppn(child_ppn);
+				frame_add_children(ppn, -1);
+				return -1;
+			}
+
+			swap_discard(key);
+		}
+
+		entry.ppn = child_ppn;
+		entry.valid = 1;
+		entry.present = 1;
+		set_pte(ppn, index, &entry);
+
+		ppn = child_ppn;
+	}
+
+	return ppn;
+}
+
+// Waits for an asynchronous fault's read and makes the page resident
+int finish_async_fault(int i) {
+	struct async_fault fault = mm->async_faults[i];
+	mm->async_faults[i] = mm->async_faults[--mm->num_async_faults];
+
+	// The leaf table was pinned when the fault started, so it's still resident
+	int leaf_ppn = resident_table_ppn(&mm->processes[fault.pid], fault.vpn, mm->config.page_table_levels - 1);
+	uint64_t index = table_index(fault.vpn, mm->config.page_table_levels - 1);
+
+	if(swap_read_finish(fault.handle)) {
+		DEBUG("unable to read in page for asynchronous fault\n");
+		release_ppn(fault.ppn);
+		frame_add_children(leaf_ppn, -1);
+		return -1;
+	}
+
+	struct page_table_entry pte = get_pte(leaf_ppn, index);
+	pte.ppn = fault.ppn;
+	install_page(&pte, fault.pid, fault.vpn);
+	set_pte(leaf_ppn, index, &pte);
+
+	frame_assign(mm->frames.prefetched, fault.ppn, fault.readahead);
+
+	return 0;
+}
+
+// Starts reading in a page that isn't present, under the resident leaf table 'leaf_ppn', without
+// waiting for it. Returns 1 if it's on its way, or -1 on error
+int start_async_fault(int pid, uint64_t vpn, int leaf_ppn, int readahead) {
+	if(mm->num_async_faults == MAX_ASYNC_FAULTS) {
+		DEBUG("too many asynchronous faults in flight\n");
+		return -1;
+	}
+
+	// Like fault_in_page(), except the read is only started. Ejecting a dirty page to make room
+	// doesn't wait for the write either, so both can be in flight at once
+	frame_add_children(leaf_ppn, 1);
+
+	int ppn = reserve_ppn(pid);
+	if(ppn == -1) {
+		DEBUG("unable to reserve PPN for asynchronous fault\n");
+		frame_add_children(leaf_ppn, -1);
+		return -1;
+	}
+
+	uint8_t *mem = (uint8_t*)phys_mem_addr_for_frame(ppn);
+	struct page_key key = { pid, 0, (int64_t)vpn };
+	struct page_table_entry pte = get_pte(leaf_ppn, table_index(vpn, mm->config.page_table_levels - 1));
+	int major = pte_on_device(&pte, key);
+	int handle = swap_read_start(key, mem);
+	if(handle == -1) {
+		release_ppn(ppn);
+		frame_add_children(leaf_ppn, -1);
+		return -1;
+	}
+
+	if(!readahead)
+		stat_add(major ? STAT_MAJOR_FAULTS : STAT_MINOR_FAULTS, 1);
+
+	struct async_fault *fault = &mm->async_faults[mm->num_async_faults++];
+	fault->pid = pid;
+	fault->vpn = vpn;
+	fault->ppn = ppn;
+	fault->handle = handle;
+	fault->readahead = readahead;
+	fault->unlocked = 0;
+
+	return 1;
+}
+
+// Starts the read for a fault on a page that has to come off the swap device, so the caller can
+// wait for it with mm->lock dropped. Until it's finished, the read owns its frame (which isn't
+// valid, so nothing can eject it) and holds the leaf table in place. Returns the read's handle,
+// or -1 if there's nothing to wait for, leaving the fault (or the error) to translate_page()
+int start_unlocked_fault(int pid, uint64_t vpn, int write) {
+	struct process *const proc = &mm->processes[pid];
+
+	if(!mm->swap_enabled || mm->config.swap_io_threads == 0 || !proc->page_table_exists || !proc->page_table_resident)
+		return -1;
+
+	int leaf_ppn = walk_page_table(pid, vpn, 0);
+	if(leaf_ppn == -1)
+		return -1;
+
+	struct page_table_entry pte = get_pte(leaf_ppn, table_index(vpn, mm->config.page_table_levels - 1));
+	if(!pte.valid || pte.present || (write && !pte.writeable))
+		return -1;
+
+	// Another thread may have started it already
+	for(int i = 0; i < mm->num_async_faults; i++)
+		if(mm->async_faults[i].pid == pid && mm->async_faults[i].vpn == vpn)
+			return mm->async_faults[i].handle;
+
+	if(mm->num_async_faults == MAX_ASYNC_FAULTS || !pte_on_device(&pte, (struct page_key){ pid, 0, (int64_t)vpn }) ||
+		start_async_fault(pid, vpn, leaf_ppn, 0) != 1)
+		return -1;
+
+	mm->async_faults[mm->num_async_faults - 1].unlocked = 1;
+
+	return mm->async_faults[mm->num_async_faults - 1].handle;
+}
+
+// Finishes any readahead whose read is done, so its frame isn't tied up any longer than it has to be
+void reap_readahead() {
+	for(int i = 0; i < mm->num_async_faults; ) {
+		if(mm->async_faults[i].readahead && swap_read_poll(mm->async_faults[i].handle))
+			finish_async_fault(i);
+		else
+			i++;
+	}
+}
+
+// Waits for every readahead in flight, returning how many were finished
+int finish_readahead() {
+	int finished = 0;
+	for(int i = 0; i < mm->num_async_faults; ) {
+		if(mm->async_faults[i].readahead) {
+			finish_async_fault(i);
+			finished++;
+		} else {
+			i++;
+		}
+	}
+
+	return finished;
+}
+
+// Called after an access that faulted, or that was the first use of a page read ahead. Once the
+// same stride shows up twice in a row, the next pages along it are read in before they're asked for
+void readahead(int pid, uint64_t vpn) {
+	if(mm->config.readahead_max_pages == 0 || !mm->swap_enabled)
+		return;
+
+	reap_readahead();
+
+	struct process *const proc = &mm->processes[pid];
+	int64_t stride = (int64_t)(vpn - proc->readahead_last_vpn);
+	proc->readahead_last_vpn = vpn;
+
+	if(stride == 0)
+		return;
+
+	if(stride != proc->readahead_stride) {
+		proc->readahead_stride = stride;
+		return;
+	}
+
+	for(int k = 1; k <= proc->readahead_window; k++) {
+		uint64_t target = vpn + (uint64_t)(stride * k);
+		if(target >= mm->num_virtual_pages)
+			break;
+
+		// Readahead never takes more than half of memory, so there's always room for real faults
+		if(mm->num_async_faults >= MAX_ASYNC_FAULTS || mm->num_async_faults >= mm->num_phys_pages / 2)
+			break;
+
+		// Only pages under a resident leaf table are worth it. Loading tables to read ahead would
+		// just push out more than it brings in
+		int leaf_ppn = resident_table_ppn(proc, target, mm->config.page_table_levels - 1);
+		if(leaf_ppn == -1)
+			continue;
+
+		// Pages that aren't in swap would just come in as zeroes, which is no faster to do later
+		struct page_table_entry pte = get_pte(leaf_ppn, table_index(target, mm->config.page_table_levels - 1));
+		if(!pte.valid || pte.present || !pte_in_swap(&pte, (struct page_key){ pid, 0, (int64_t)target }))
+			continue;
+
+		int in_flight = 0;
+		for(int i = 0; i < mm->num_async_faults; i++)
+			in_flight |= mm->async_faults[i].pid == pid && mm->async_faults[i].vpn == target;
+
+		if(!in_flight && start_async_fault(pid, target, leaf_ppn, 1) == -1)
+			break;
+	}
+}
+
+// Called once an access to the data page in 'ppn' is done. Faults, and first uses of pages that
+// were read ahead, are what readahead follows
+void readahead_access(int pid, uint64_t vpn, int ppn, int faulted) {
+	if(frame_test(mm->frames.prefetched, ppn)) {
+		frame_clear(mm->frames.prefetched, ppn);
+		readahead_hit(pid);
+		faulted = 1;
+	}
+
+	if(faulted)
+		readahead(pid, vpn);
+}
+
+// Brings a data page that isn't present into phys_mem, updating 'pte' (which lives at 'index' in
+// the leaf table 'leaf_ppn')
+int fault_in_page(int pid, uint64_t vpn, int leaf_ppn, uint64_t index, struct page_table_entry *pte) {
+	// If MM_FaultAsync() already started bringing the page in, then we just have to wait for it
+	for(int i = 0; i < mm->num_async_faults; i++) {
+		if(mm->async_faults[i].pid == pid && mm->async_faults[i].vpn == vpn) {
+			if(finish_async_fault(i))
+				return -1;
+
+			*pte = get_pte(leaf_ppn, index);
+			return 0;
+		}
+	}
+
+	// The page is counted against its leaf table up front so the table stays put while we
+	// reserve a PPN
+	frame_add_children(leaf_ppn, 1);
+
+	// A PPN is reserved
+	int ppn = reserve_ppn(pid);
+
+	if(ppn == -1) {
+		DEBUG("unable to reserve PPN for page\n");
+		frame_add_children(leaf_ppn, -1);
+		return -1;
+	}
+
+	// It's a major fault if the page has to come off the device, and a minor one otherwise
+	int major = mm->swap_enabled && pte_on_device(pte, (struct page_key){ pid, 0, (int64_t)vpn });
+
+	// The PTE's PPN is assigned to this reserved PPN
+	pte->ppn = ppn;
+
+	// The data is loaded into the page (if swap is disabled, then this just initializes it)
+	if(load_page(pte, pid, vpn)) {
+		DEBUG("unable to load page\n");
+		release_ppn(ppn);
+		frame_add_children(leaf_ppn, -1);
+		return -1;
+	}
+
+	set_pte(leaf_ppn, index, pte);
+	stat_add(major ? STAT_MAJOR_FAULTS : STAT_MINOR_FAULTS, 1);
+
+	return 0;
+}
+
+// Maps a virtual address to a physical address (I only use this to initilize data and only really
+// map through helpers)
+// MM_Map(), once mm->lock is held
+struct MM_MapResult map_page(int pid, uint64_t address, int writeable) {
+	struct MM_MapResult ret = {0};
+
+	// Each thread gets its own message, so one MM_Map() can't overwrite another's
+	static __thread char message[128];
+
+	ret.message = message;
+
+	// Error out if the memory info is invalid
+	int err;
+	if((err = check_mem_info(pid, address, message))) {
+		ret.error = err;
+		return ret;
+	}
+
+	// The VPN and offset of the data are extracted from the virtual address
+	uint64_t vpn = address >> mm->config.page_size_bits;
+	uint64_t offset = address & mm->page_offset_mask;
+
+	struct process *const proc = &mm->processes[pid];
+
+	// If the page table doesn't exist on the process, then we need to create it
+	if(!proc->page_table_exists) {
+		if(create_page_table(pid)) {
+			sprintf(message, "unable to create page table");
+			ret.error = 1;
+
+			return ret;
+		}
+	}
+
+	// If the page table exists, but isn't resident in memory, then we just need to load it
+	if(!proc->page_table_resident) {
+		if(load_page_table(pid)) {
+			sprintf(message, "unable to load page table");
+			ret.error = 1;
+
+			return ret;
+		}
+	}
+
+	// Any intermediate tables on the way to this page are allocated the first time they're touched
+	int leaf_ppn = walk_page_table(pid, vpn, 1);
+	if(leaf_ppn == -1) {
+		sprintf(message, "unable to walk page table");
+		ret.error = 1;
+
+		return ret;
+	}
+
+	// The appropriate PTE can now be found
+	uint64_t index = table_index(vpn, mm->config.page_table_levels - 1);
+	struct page_table_entry pte = get_pte(leaf_ppn, index);
+
+	// We can't map it if it isn't valid, though
+	if(!pte.valid) {
+		sprintf(message, "attempted to map invalid PTE");
+		ret.error = -1;
+
+		return ret;
+	}
+
+	// If the PTE isn't present in memory, then we need to load it in
+	// TODO: Code passes almost all tests if this is commented out lol (because this map function is
+	// lowkey useless in my implementation besides being used to initialize data and set permissions)
+	int faulted = !pte.present;
+	if(!pte.present) {
+		if(fault_in_page(pid, vpn, leaf_ppn, index, &pte)) {
+			sprintf(message, "unable to load page");
+			ret.error = -1;
+
+			return ret;
+		}
+	}
+
+	// The PTE flags, including whether it's been referenced, are set to be used for writing and
+	// choosing a candidate for swapping
+	pte.writeable = writeable;
+	pte.referenced = 1;
+	set_pte(leaf_ppn, index, &pte);
+
+	// The permissions may have changed, so any cached translation is stale
+	tlb_invalidate(proc, vpn);
+
+	policy_access(pte.ppn);
+	readahead_access(pid, vpn, pte.ppn, faulted);
+
+	sprintf(message, "success");
+	ret.error = 0;
+
+	return ret;
+}
+
+struct MM_MapResult MM_Map_ex(struct MM_Instance *instance, int pid, uint64_t address, int writeable) {
+	mm = instance;
+
+	if(ensure_init()) {
+		struct MM_MapResult ret = { .error = 1, .message = "unable to initialize memory manager" };
+		return ret;
+	}
+
+	pthread_rwlock_wrlock(&mm->lock);
+	struct MM_MapResult ret = map_page(pid, address, writeable);
+	pthread_rwlock_unlock(&mm->lock);
+
+	return ret;
+}
+
+struct MM_MapResult MM_Map(int pid, uint64_t address, int writeable) {
+	return MM_Map_ex(&default_instance, pid, address, writeable);
+}
+
+// A cached translation is enough for a read, or for a write as long as the PTE is already dirty.
+// Otherwise this returns -1 and the slow path has to mark it dirty (and recache it). This is all
+// that's needed with mm->lock only held shared
+int tlb_translate(struct process *proc, uint64_t vpn, int write) {
+	struct tlb_entry *tlb_hit = tlb_lookup(proc, vpn);
+	if(tlb_hit == NULL || (write && !tlb_hit->dirty))
+		return -1;
+
+	stat_add(STAT_TLB_HITS, 1);
+	policy_access(tlb_hit->ppn);
+
+	return tlb_hit->ppn;
+}
+
+// Whether 'vpn' is mapped writeable, found without faulting the page in or dirtying it. Page tables
+// along the way may still have to be brought in
+int page_writeable(int pid, uint64_t vpn) {
+	struct process *const proc = &mm->processes[pid];
+
+	struct tlb_entry *tlb_hit = tlb_lookup(proc, vpn);
+	if(tlb_hit != NULL)
+		return tlb_hit->writeable;
+
+	if(!proc->page_table_exists || (!proc->page_table_resident && load_page_table(pid)))
+		return 0;
+
+	int leaf_ppn = walk_page_table(pid, vpn, 0);
+	if(leaf_ppn == -1)
+		return 0;
+
+	struct page_table_entry pte = get_pte(leaf_ppn, table_index(vpn, mm->config.page_table_levels - 1));
+	return pte.valid && pte.writeable;
+}
+
+// Finds the frame holding 'vpn' so it can be read from, or written to if 'write' is set, faulting
+// the page in if it isn't resident. A write marks the page dirty. Returns the PPN, or -1 on error.
+// Whether it faulted is stored in 'faulted', to be passed on to readahead_access() once the caller
+// is done with the frame (readahead can eject pages, including this one)
+int translate_page(int pid, uint64_t vpn, int write, int *faulted) {
+	struct process *const proc = &mm->processes[pid];
+	const char *const verb = write ? "write to" : "read from";
+
+	*faulted = 0;
+	int ppn = tlb_translate(proc, vpn, write);
+	if(ppn != -1)
+		return ppn;
+
+	stat_add(STAT_TLB_MISSES, 1);
+
+	struct tlb_entry *tlb_hit = tlb_lookup(proc, vpn);
+	if(tlb_hit != NULL && !tlb_hit->writeable) {
+		DEBUG("attempting to write to a read only PTE\n");
+		return -1;
+	}
+
+	// The page table must exist in order to use it
+	// TODO: Make sure all errors are in the past tense throughout this entire file
+	// TODO: Also try to standardize all errors
+	if(!proc->page_table_exists) {
+		DEBUG("attempted to %s a page table that does not exist\n", verb);
+		return -1;
+	}
+
+	// If it isn't resident, then we can just simply load it
+	if(!proc->page_table_resident) {
+		if(load_page_table(pid)) {
+			DEBUG("unable to load page table when attempting to %s data\n", verb);
+			return -1;
+		}
+	}
+
+	// Walk down to the table holding this page's PTE, without creating anything
+	int leaf_ppn = walk_page_table(pid, vpn, 0);
+	if(leaf_ppn == -1) {
+		DEBUG("attempted to %s an unmapped page\n", verb);
+		return -1;
+	}
+
+	// Use VPN as index to find PTE for this page
+	uint64_t index = table_index(vpn, mm->config.page_table_levels - 1);
+	struct page_table_entry pte = get_pte(leaf_ppn, index);
+
+	// The PTE must be valid to use it
+	if(!pte.valid) {
+		DEBUG("attempting to %s invalid PTE\n", verb);
+		return -1;
+	}
+
+	// You can't write to the PTE if it isn't writeable
+	if(write && !pte.writeable) {
+		DEBUG("attempting to write to a read only PTE\n");
+		return -1;
+	}
+
+	// If the PTE isn't present in physical memory, then it needs to be loaded in
+	*faulted = !pte.present;
+	if(!pte.present) {
+		if(fault_in_page(pid, vpn, leaf_ppn, index, &pte)) {
+			DEBUG("unable to load page to %s data\n", verb);
+			return -1;
+		}
+	}
+
+	// The PID's of the physical page and function call need to match
+	if(mm->frames.pid[pte.ppn] != pid) {
+		DEBUG("phys page and call PID's do not match when attempting to %s data\n", verb);
+		return -1;
+	}
+
+	// So do the VPN's
+	if(mm->frames.vpn[pte.ppn] != (int64_t)vpn) {
+		DEBUG("phys page and call VPN's do not match when attempting to %s data\n", verb);
+		return -1;
+	}
+
+	// The physical page must be valid to use it
+	if(!frame_test(mm->frames.valid, pte.ppn)) {
+		DEBUG("attempting to %s invalid phys page\n", verb);
+		return -1;
+	}
+
+	// We cannot read memory from a page table as this makes it feel uncomfortable, and writing to
+	// one is highly unethical as it causes irreparable damage and requires years of emotionally and
+	// financially taxxing rehabilitation to repare.
+	if(frame_test(mm->frames.page_table, pte.ppn)) {
+		DEBUG("attempting to %s memory in a page table\n", verb);
+		return -1;
+	}
+
+	if(write) {
+		// A clean page can keep its copy in swap, but once it's changed that copy is stale and its
+		// slot can go to another page
+		if(!pte.dirty) {
+			mm->num_dirty_pages++;
+			frame_set(mm->frames.dirty, pte.ppn);
+
+			if(mm->swap_enabled)
+				swap_discard((struct page_key){ pid, 0, (int64_t)vpn });
+		}
+
+		// The PTE is marked as dirty so it gets ejected properly
+		pte.dirty = 1;
+		set_pte(leaf_ppn, index, &pte);
+	}
+
+	tlb_insert(proc, vpn, &pte);
+	policy_access(pte.ppn);
+
+	return pte.ppn;
+}
+
+// Reads 'len' bytes at 'offset' into the page 'vpn' without taking any lock, as long as the
+// translation is cached. The frame's sequence count is read before and after the copy, and if the
+// frame was being ejected at any point in between (or doesn't hold the page at all), this gives up
+// and returns -1 so the caller can take the locked path instead. A failed read may have left
+// anything in 'buf'. The copy can race with the frame being refilled (ThreadSanitizer will say as
+// much), but then the sequence count has moved and the copy is thrown away
+int read_lockfree(int pid, uint64_t vpn, uint64_t offset, uint8_t *buf, size_t len) {
+	if(mm->config.tlb_entries == 0)
+		return -1;
+
+	// The TLB can change under us too, so it's only a hint. The frame's owner is what counts
+	struct tlb_entry *set = &mm->processes[pid].tlb[(vpn & mm->tlb_set_mask) * mm->config.tlb_associativity];
+	int64_t ppn = -1;
+	for(int way = 0; way < mm->config.tlb_associativity && ppn == -1; way++) {
+		if(__atomic_load_n(&set[way].valid, __ATOMIC_RELAXED) && __atomic_load_n(&set[way].vpn, __ATOMIC_RELAXED) == vpn)
+			ppn = __atomic_load_n(&set[way].ppn, __ATOMIC_RELAXED);
+	}
+
+	if(ppn < 0 || ppn >= mm->num_phys_pages)
+		return -1;
+
+	uint32_t seq = __atomic_load_n(&mm->frame_seq[ppn], __ATOMIC_ACQUIRE);
+	if((seq & 1) || __atomic_load_n(&mm->frame_owner[ppn], __ATOMIC_ACQUIRE) != owner_key(pid, vpn))
+		return -1;
+
+	memcpy(buf, &mm->phys_mem[((size_t)ppn << mm->config.page_size_bits) | offset], len);
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if(__atomic_load_n(&mm->frame_seq[ppn], __ATOMIC_RELAXED) != seq)
+		return -1;
+
+	stat_add(STAT_TLB_HITS, 1);
+	policy_try_access((int)ppn, &mm->frame_seq[ppn], seq);
+
+	return 0;
+}
+
+// Translates 'vpn' and locks things so the frame can be used until access_end(). A TLB hit only
+// holds mm->lock shared (plus the process' lock), so callers with different pids can run at once.
+// A miss takes mm->lock exclusively, since faulting can change any process' page tables. Returns
+// the PPN or -1, and either way access_end() has to be called with what this left in 'access'
+struct access {
+	int pid;
+	uint64_t vpn;
+	int ppn;
+	int faulted;
+	int exclusive;
+};
+
+int access_begin(struct access *access, int pid, uint64_t vpn, int write) {
+	struct process *const proc = &mm->processes[pid];
+
+	access->pid = pid;
+	access->vpn = vpn;
+	access->faulted = 0;
+	access->exclusive = 0;
+
+	pthread_rwlock_rdlock(&mm->lock);
+	pthread_mutex_lock(&proc->lock);
+	access->ppn = tlb_translate(proc, vpn, write);
+	if(access->ppn != -1)
+		return access->ppn;
+
+	pthread_mutex_unlock(&proc->lock);
+	pthread_rwlock_unlock(&mm->lock);
+
+	pthread_rwlock_wrlock(&mm->lock);
+	access->exclusive = 1;
+
+	// Reading a page off the device is the slow part of a fault, so it's done with mm->lock
+	// dropped, letting faults and evictions of other frames go ahead. The page is then translated
+	// as usual, which finishes the read (unless another thread already did)
+	int handle = start_unlocked_fault(pid, vpn, write);
+	if(handle != -1) {
+		pthread_rwlock_unlock(&mm->lock);
+		swap_read_wait(handle);
+		pthread_rwlock_wrlock(&mm->lock);
+	}
+
+	access->ppn = translate_page(pid, vpn, write, &access->faulted);
+
+	return access->ppn;
+}
+
+void access_end(struct access *access) {
+	if(!access->exclusive) {
+		pthread_mutex_unlock(&mm->processes[access->pid].lock);
+	} else if(access->ppn != -1) {
+		readahead_access(access->pid, access->vpn, access->ppn, access->faulted);
+	}
+
+	pthread_rwlock_unlock(&mm->lock);
+}
+
+// Loads data from a virtual memory address
+int MM_LoadByte_ex(struct MM_Instance *instance, int pid, uint64_t address, uint8_t *value) {
+	mm = instance;
+
+	if(ensure_init())
+		return -1;
+
+	// Nothing to load from if the pid or address is out of range
+	if(pid < 0 || pid >= mm->config.max_processes || address >= mm->process_virtual_memory_size_bytes) {
+		DEBUG("attempted to read from an out of range pid or address\n");
+		return -1;
+	}
+
+	// The VPN and offset of the data are extracted from the virtual address
+	uint64_t vpn = address >> mm->config.page_size_bits;
+	uint64_t offset = address & mm->page_offset_mask;
+
+	// Most loads never need a lock at all
+	if(read_lockfree(pid, vpn, offset, value, 1) == 0)
+		return 0;
+
+	struct access access;
+	int ppn = access_begin(&access, pid, vpn, 0);
+
+	// Phyical pointer reassembled from PPN and offset
+	if(ppn != -1)
+		*value = mm->phys_mem[((size_t)ppn << mm->config.page_size_bits) | offset];
+
+	access_end(&access);
+
+	return ppn == -1 ? -1 : 0;
+}
+
+int MM_LoadByte(int pid, uint64_t address, uint8_t *value) {
+	return MM_LoadByte_ex(&default_instance, pid, address, value);
+}
+
+// Stores data into a virtual memory address
+int MM_StoreByte_ex(struct MM_Instance *instance, int pid, uint64_t address, uint8_t value) {
+	mm = instance;
+
+	if(ensure_init())
+		return -1;
+
+	// Nothing to store to if the pid or address is out of range
+	if(pid < 0 || pid >= mm->config.max_processes || address >= mm->process_virtual_memory_size_bytes) {
+		DEBUG("attempted to write to an out of range pid or address\n");
+		return -1;
+	}
+
+	// The VPN and offset are extracted from the virtual address
+	uint64_t vpn = address >> mm->config.page_size_bits;
+	uint64_t offset = address & mm->page_offset_mask;
+
+	struct access access;
+	int ppn = access_begin(&access, pid, vpn, 1);
+
+	if(ppn != -1)
+		mm->phys_mem[((size_t)ppn << mm->config.page_size_bits) | offset] = value;
+
+	access_end(&access);
+
+	return ppn == -1 ? -1 : 0;
+}
+
+int MM_StoreByte(int pid, uint64_t address, uint8_t value) {
+	return MM_StoreByte_ex(&default_instance, pid, address, value);
+}
+
+// Copies between a buffer and virtual memory a page at a time, translating each page only once.
+// With 'exclusive' set, mm->lock is already held exclusively for the whole copy
+int copy_range(int pid, uint64_t address, uint8_t *buf, size_t len, int write, int exclusive) {
+	while(len > 0) {
+		uint64_t vpn = address >> mm->config.page_size_bits;
+		uint64_t offset = address & mm->page_offset_mask;
+		size_t chunk = (size_t)(mm->page_size_bytes - offset);
+		if(chunk > len)
+			chunk = len;
+
+		if(!exclusive && !write && read_lockfree(pid, vpn, offset, buf, chunk) == 0) {
+			address += chunk;
+			buf += chunk;
+			len -= chunk;
+			continue;
+		}
+
+		struct access access;
+		int faulted;
+		int ppn = exclusive ? translate_page(pid, vpn, write, &faulted) : access_begin(&access, pid, vpn, write);
+
+		if(ppn != -1) {
+			uint8_t *mem = &mm->phys_mem[((size_t)ppn << mm->config.page_size_bits) | offset];
+			if(write)
+				memcpy(mem, buf, chunk);
+			else
+				memcpy(buf, mem, chunk);
+		}
+
+		if(!exclusive)
+			access_end(&access);
+
+		if(ppn == -1)
+			return -1;
+
+		address += chunk;
+		buf += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+int check_range(int pid, uint64_t address, size_t len, int write) {
+	if(ensure_init())
+		return -1;
+
+	// The whole range has to be in bounds (written so that it can't overflow)
+	if(pid < 0 || pid >= mm->config.max_processes || address > mm->process_virtual_memory_size_bytes ||
+		len > mm->process_virtual_memory_size_bytes - address) {
+		DEBUG("attempted to %s an out of range pid or address\n", write ? "write to" : "read from");
+		return -1;
+	}
+
+	return 0;
+}
+
+int MM_Read_ex(struct MM_Instance *instance, int pid, uint64_t address, void *buf, size_t len) {
+	mm = instance;
+
+	if(check_range(pid, address, len, 0))
+		return -1;
+
+	return copy_range(pid, address, (uint8_t*)buf, len, 0, 0);
+}
+
+int MM_Read(int pid, uint64_t address, void *buf, size_t len) {
+	return MM_Read_ex(&default_instance, pid, address, buf, len);
+}
+
+int MM_Write_ex(struct MM_Instance *instance, int pid, uint64_t address, const void *buf, size_t len) {
+	mm = instance;
+
+	if(check_range(pid, address, len, 1))
+		return -1;
+
+	return copy_range(pid, address, (uint8_t*)buf, len, 1, 0);
+}
+
+int MM_Write(int pid, uint64_t address, const void *buf, size_t len) {
+	return MM_Write_ex(&default_instance, pid, address, buf, len);
+}
+
+// Which byte of a 'size' byte value ends up at 'i' bytes past its address
+int byte_shift(int i, int size) {
+	return (mm->config.endianness == MM_BIG_ENDIAN ? size - 1 - i : i) * 8;
+}
+
+// Loads a 'size' byte value. When it's all in one page, a single translation is enough. Otherwise
+// the bytes are gathered from both pages, holding mm->lock the whole time so the value can't tear
+int load_value(int pid, uint64_t address, int size, uint64_t *value) {
+	if(check_range(pid, address, size, 0))
+		return -1;
+
+	uint64_t vpn = address >> mm->config.page_size_bits;
+	uint64_t offset = address & mm->page_offset_mask;
+	uint8_t bytes[8];
+
+	if(offset + size <= (uint64_t)mm->page_size_bytes && read_lockfree(pid, vpn, offset, bytes, size) == 0) {
+		// Got it without locking anything
+	} else if(offset + size <= (uint64_t)mm->page_size_bytes) {
+		struct access access;
+		int ppn = access_begin(&access, pid, vpn, 0);
+		if(ppn != -1)
+			memcpy(bytes, &mm->phys_mem[((size_t)ppn << mm->config.page_size_bits) | offset], size);
+		access_end(&access);
+
+		if(ppn == -1)
+			return -1;
+	} else {
+		pthread_rwlock_wrlock(&mm->lock);
+		int ret = copy_range(pid, address, bytes, size, 0, 1);
+		pthread_rwlock_unlock(&mm->lock);
+
+		if(ret)
+			return -1;
+	}
+
+	*value = 0;
+	for(int i = 0; i < size; i++)
+		*value |= (uint64_t)bytes[i] << byte_shift(i, size);
+
+	return 0;
+}
+
+// Stores a 'size' byte value. A value that straddles two pages only goes in once both pages are
+// writeable and resident, so a failed store leaves memory alone
+int store_value(int pid, uint64_t address, int size, uint64_t value) {
+	if(check_range(pid, address, size, 1))
+		return -1;
+
+	uint64_t vpn = address >> mm->config.page_size_bits;
+	uint64_t offset = address & mm->page_offset_mask;
+	uint8_t bytes[8];
+	for(int i = 0; i < size; i++)
+		bytes[i] = (uint8_t)(value >> byte_shift(i, size));
+
+	if(offset + size <= (uint64_t)mm->page_size_bytes) {
+		struct access access;
+		int ppn = access_begin(&access, pid, vpn, 1);
+		if(ppn != -1)
+			memcpy(&mm->phys_mem[((size_t)ppn << mm->config.page_size_bits) | offset], bytes, size);
+		access_end(&access);
+
+		return ppn == -1 ? -1 : 0;
+	}
+
+	// copy_range() stops at the first page it can't write to, so both pages are checked up front.
+	// The check doesn't dirty anything, so a store that's refused leaves both pages as they were
+	pthread_rwlock_wrlock(&mm->lock);
+	int ret = -1;
+	if(!page_writeable(pid, vpn) || !page_writeable(pid, vpn + 1)) {
+		DEBUG("attempting to write across a page that isn't mapped writeable\n");
+	} else {
+		// Faulting either page in can still fail (say, swap is full), so both are brought in
+		// for reading first, with the first held in place while the second comes in. Only then
+		// are they written, which can't fault anymore
+		int faulted;
+		int first_ppn = translate_page(pid, vpn, 0, &faulted);
+		if(first_ppn != -1) {
+			frame_set(mm->frames.pinned, first_ppn);
+			int second_ppn = translate_page(pid, vpn + 1, 0, &faulted);
+			frame_clear(mm->frames.pinned, first_ppn);
+
+			if(second_ppn != -1)
+				ret = copy_range(pid, address, bytes, size, 1, 1);
+		}
+	}
+	pthread_rwlock_unlock(&mm->lock);
+
+	return ret;
+}
+
+int MM_Load16_ex(struct MM_Instance *instance, int pid, uint64_t address, uint16_t *value) {
+	mm = instance;
+
+	uint64_t wide;
+	if(load_value(pid, address, 2, &wide))
+		return -1;
+
+	*value = (uint16_t)wide;
+	return 0;
+}
+
+int MM_Load16(int pid, uint64_t address, uint16_t *value) {
+	return MM_Load16_ex(&default_instance, pid, address, value);
+}
+
+int MM_Load32_ex(struct MM_Instance *instance, int pid, uint64_t address, uint32_t *value) {
+	mm = instance;
+
+	uint64_t wide;
+	if(load_value(pid, address, 4, &wide))
+		return -1;
+
+	*value = (uint32_t)wide;
+	return 0;
+}
+
+int MM_Load32(int pid, uint64_t address, uint32_t *value) {
+	return MM_Load32_ex(&default_instance, pid, address, value);
+}
+
+int MM_Load64_ex(struct MM_Instance *instance, int pid, uint64_t address, uint64_t *value) {
+	mm = instance;
+
+	return load_value(pid, address, 8, value);
+}
+
+int MM_Load64(int pid, uint64_t address, uint64_t *value) {
+	return MM_Load64_ex(&default_instance, pid, address, value);
+}
+
+int MM_Store16_ex(struct MM_Instance *instance, int pid, uint64_t address, uint16_t value) {
+	mm = instance;
+
+	return store_value(pid, address, 2, value);
+}
+
+int MM_Store16(int pid, uint64_t address, uint16_t value) {
+	return MM_Store16_ex(&default_instance, pid, address, value);
+}
+
+int MM_Store32_ex(struct MM_Instance *instance, int pid, uint64_t address, uint32_t value) {
+	mm = instance;
+
+	return store_value(pid, address, 4, value);
+}
+
+int MM_Store32(int pid, uint64_t address, uint32_t value) {
+	return MM_Store32_ex(&default_instance, pid, address, value);
+}
+
+int MM_Store64_ex(struct MM_Instance *instance, int pid, uint64_t address, uint64_t value) {
+	mm = instance;
+
+	return store_value(pid, address, 8, value);
+}
+
+int MM_Store64(int pid, uint64_t address, uint64_t value) {
+	return MM_Store64_ex(&default_instance, pid, address, value);
+}
+
+// Starts bringing in the page holding 'vpn' without waiting for it, like MM_FaultAsync(). With
+// 'claim' set, a page that's already being read ahead is reported by MM_FaultComplete() when done
+int fault_async(int pid, uint64_t vpn, int claim) {
+	struct process *const proc = &mm->processes[pid];
+
+	// The page has to be mapped already, just like for MM_LoadByte()
+	if(!proc->page_table_exists) {
+		DEBUG("attempted to fault in a page with no page table\n");
+		return -1;
+	}
+
+	if(!proc->page_table_resident && load_page_table(pid)) {
+		DEBUG("unable to load page table when faulting in a page\n");
+		return -1;
+	}
+
+	int leaf_ppn = walk_page_table(pid, vpn, 0);
+	if(leaf_ppn == -1) {
+		DEBUG("attempted to fault in an unmapped page\n");
+		return -1;
+	}
+
+	uint64_t index = table_index(vpn, mm->config.page_table_levels - 1);
+	struct page_table_entry pte = get_pte(leaf_ppn, index);
+
+	if(!pte.valid) {
+		DEBUG("attempted to fault in an invalid PTE\n");
+		return -1;
+	}
+
+	if(pte.present)
+		return 0;
+
+	// A page that's already being read ahead just has to be reported when it's done
+	for(int i = 0; i < mm->num_async_faults; i++) {
+		if(mm->async_faults[i].pid == pid && mm->async_faults[i].vpn == vpn) {
+			if(claim) {
+				mm->async_faults[i].readahead = 0;
+				mm->async_faults[i].unlocked = 0;
+			}
+			return 1;
+		}
+	}
+
+	// Without swap, a page comes in as zeroes, so there's nothing to wait for
+	if(!mm->swap_enabled)
+		return fault_in_page(pid, vpn, leaf_ppn, index, &pte);
+
+	return start_async_fault(pid, vpn, leaf_ppn, 0);
+}
+
+int MM_FaultAsync_ex(struct MM_Instance *instance, int pid, uint64_t address) {
+	mm = instance;
+
+	if(ensure_init())
+		return -1;
+
+	if(pid < 0 || pid >= mm->config.max_processes || address >= mm->process_virtual_memory_size_bytes) {
+		DEBUG("attempted to fault in an out of range pid or address\n");
+		return -1;
+	}
+
+	pthread_rwlock_wrlock(&mm->lock);
+	int ret = fault_async(pid, address >> mm->config.page_size_bits, 1);
+	pthread_rwlock_unlock(&mm->lock);
+
+	return ret;
+}
+
+int MM_FaultAsync(int pid, uint64_t address) {
+	return MM_FaultAsync_ex(&default_instance, pid, address);
+}
+
+// MM_TranslateBatch(), once mm->lock is held
+int translate_batch(int pid, const uint64_t *addresses, size_t n, uint64_t *phys_out, uint8_t *status_out) {
+	struct process *const proc = &mm->processes[pid];
+
+	// The first pass takes care of everything the TLB already knows about, and starts reading in
+	// the pages that aren't resident so they're all in flight at once
+	for(size_t i = 0; i < n; i++) {
+		if(addresses[i] >= mm->process_virtual_memory_size_bytes) {
+			status_out[i] = MM_TRANSLATE_ERROR;
+			continue;
+		}
+
+		uint64_t vpn = addresses[i] >> mm->config.page_size_bits;
+		struct tlb_entry *tlb_hit = tlb_lookup(proc, vpn);
+		if(tlb_hit != NULL) {
+			phys_out[i] = ((uint64_t)tlb_hit->ppn << mm->config.page_size_bits) | (addresses[i] & mm->page_offset_mask);
+			status_out[i] = MM_TRANSLATE_HIT;
+			stat_add(STAT_TLB_HITS, 1);
+			policy_access(tlb_hit->ppn);
+			continue;
+		}
+
+		status_out[i] = MM_TRANSLATE_FAULTED;
+		if(mm->num_async_faults < MAX_ASYNC_FAULTS)
+			fault_async(pid, vpn, 0);
+	}
+
+	// Then the misses are translated for real, which finishes the reads that were started
+	for(size_t i = 0; i < n; i++) {
+		if(status_out[i] != MM_TRANSLATE_FAULTED)
+			continue;
+
+		uint64_t vpn = addresses[i] >> mm->config.page_size_bits;
+		int faulted;
+		int ppn = translate_page(pid, vpn, 0, &faulted);
+		if(ppn == -1) {
+			status_out[i] = MM_TRANSLATE_ERROR;
+			continue;
+		}
+
+		phys_out[i] = ((uint64_t)ppn << mm->config.page_size_bits) | (addresses[i] & mm->page_offset_mask);
+		status_out[i] = faulted ? MM_TRANSLATE_FAULTED : MM_TRANSLATE_HIT;
+		readahead_access(pid, vpn, ppn, faulted);
+	}
+
+	// Making room for a later page may have ejected an earlier one, so every frame is checked to
+	// still hold the page it was translated to
+	int translated = 0;
+	for(size_t i = 0; i < n; i++) {
+		if(status_out[i] == MM_TRANSLATE_ERROR)
+			continue;
+
+		int ppn = (int)(phys_out[i] >> mm->config.page_size_bits);
+		if(!frame_test(mm->frames.valid, ppn) || frame_test(mm->frames.page_table, ppn) || mm->frames.pid[ppn] != pid ||
+			mm->frames.vpn[ppn] != (int64_t)(addresses[i] >> mm->config.page_size_bits)) {
+			status_out[i] = MM_TRANSLATE_EJECTED;
+			continue;
+		}
+
+		translated++;
+	}
+
+	return translated;
+}
+
+int MM_TranslateBatch_ex(struct MM_Instance *instance, int pid, const uint64_t *addresses, size_t n, uint64_t *phys_out, uint8_t *status_out) {
+	mm = instance;
+
+	if(ensure_init())
+		return -1;
+
+	if(pid < 0 || pid >= mm->config.max_processes) {
+		DEBUG("attempted to translate for an out of range pid\n");
+		return -1;
+	}
+
+	pthread_rwlock_wrlock(&mm->lock);
+	int ret = translate_batch(pid, addresses, n, phys_out, status_out);
+	pthread_rwlock_unlock(&mm->lock);
+
+	return ret;
+}
+
+int MM_TranslateBatch(int pid, const uint64_t *addresses, size_t n, uint64_t *phys_out, uint8_t *status_out) {
+	return MM_TranslateBatch_ex(&default_instance, pid, addresses, n, phys_out, status_out);
+}
+
+// MM_FaultComplete(), once mm->lock is held
+int complete_faults(struct MM_Access *done, int max, int wait) {
+	int completed = 0;
+
+	// Finishing a fault moves the last one into its place, so 'i' only moves on when nothing was
+	// finished
+	for(int i = 0; i < mm->num_async_faults && completed < max; ) {
+		if(!swap_read_poll(mm->async_faults[i].handle)) {
+			i++;
+			continue;
+		}
+
+		if(mm->async_faults[i].readahead || mm->async_faults[i].unlocked) {
+			finish_async_fault(i);
+			continue;
+		}
+
+		done[completed].pid = mm->async_faults[i].pid;
+		done[completed].address = mm->async_faults[i].vpn << mm->config.page_size_bits;
+		completed++;
+
+		// A fault that failed is reported all the same. The next access to the page tries again
+		finish_async_fault(i);
+	}
+
+	// Readahead isn't something the caller asked for, so it's never waited on here
+	for(int i = 0; completed == 0 && wait && max > 0 && i < mm->num_async_faults; i++) {
+		if(mm->async_faults[i].readahead || mm->async_faults[i].unlocked)
+			continue;
+
+		done[0].pid = mm->async_faults[i].pid;
+		done[0].address = mm->async_faults[i].vpn << mm->config.page_size_bits;
+		completed++;
+
+		finish_async_fault(i);
+	}
+
+	return completed;
+}
+
+int MM_FaultComplete_ex(struct MM_Instance *instance, struct MM_Access *done, int max, int wait) {
+	mm = instance;
+
+	if(ensure_init())
+		return -1;
+
+	pthread_rwlock_wrlock(&mm->lock);
+	int ret = complete_faults(done, max, wait);
+	pthread_rwlock_unlock(&mm->lock);
+
+	return ret;
+}
+
+int MM_FaultComplete(struct MM_Access *done, int max, int wait) {
+	return MM_FaultComplete_ex(&default_instance, done, max, wait);
+}
@@ -14,8 +14,8 @@ extern "C" {
 // Helper macro for quick error checking.
 #define CHECK(x)	do { if (!(x)) { fprintf(stderr, "%s:%d CHECK failed: %s, errno %d %s\n", __FILE__, __LINE__, #x, errno, strerror(errno)); abort(); } } while(0)
 
-// Maximum processes allowed.
-// Valid values of 'pid' arguments are 0, 1, 2, 3.
+// Maximum processes allowed by default.
+// Valid values of 'pid' arguments are 0 to config.max_processes - 1 (0, 1, 2, 3 by default).
 #define MM_MAX_PROCESSES			4
 
 typedef uint8_t pte_page_t;
@@ -34,10 +34,83 @@ typedef uint8_t pte_page_t;
 #define MM_NUM_PTES				(MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES / MM_PAGE_SIZE_BYTES)
 #define MM_PAGE_TABLE_SIZE_BYTES		(MM_NUM_PTES * MM_MAX_PTE_SIZE_BYTES)
 
+// The default geometry uses a flat (single level) page table, which has to fit in one page.
 #if MM_PAGE_TABLE_SIZE_BYTES > MM_PAGE_SIZE_BYTES
-#error "Cannot fit page table in single page for assignment simplicity"
+#error "Cannot fit default page table in single page"
 #endif
 
+// How eject_phys_page() picks a victim when physical memory is full.
+enum MM_ReplacementPolicy {
+	MM_POLICY_SIMPLE,		// Data pages from other pids first, then our own, then idle page tables
+	MM_POLICY_FIFO,			// Oldest resident page
+	MM_POLICY_CLOCK,		// A hand sweeping over frames, skipping recently referenced ones
+	MM_POLICY_SECOND_CHANCE,	// FIFO, but referenced pages go back to the end of the queue once
+	MM_POLICY_LRU,			// Exact least recently used
+	MM_POLICY_LRU_APPROX,		// Least recently used out of a small random sample of frames
+	MM_POLICY_LFU,			// Least frequently used, ties broken by least recently used
+	MM_POLICY_ARC,			// Adaptive Replacement Cache
+	MM_POLICY_OPT,			// Belady's optimal policy, using the future given to MM_SetOracle()
+};
+
+// Byte order used by MM_Load16() and friends to lay out multi-byte values.
+enum MM_Endianness {
+	MM_LITTLE_ENDIAN,		// Least significant byte at the lowest address
+	MM_BIG_ENDIAN,			// Most significant byte at the lowest address
+};
+
+// The MM_* sizes above are the default geometry, which is used until
+// MM_Init() is called with something else.
+struct MM_Config {
+	int page_size_bits;			// Pages are (1 << page_size_bits) bytes, up to 64 KiB
+	uint64_t physical_memory_size_bytes;	// Must be a multiple of the page size
+	int process_virtual_memory_size_shift;	// Each process gets (1 << shift) bytes of address space, up to 48 bits
+	int max_processes;			// Valid pids are 0 .. max_processes - 1
+	int page_table_levels;			// 1 for a flat page table, 2-4 for a radix tree of page-sized tables
+	int tlb_entries;			// Per-process software TLB size (power of two, 0 disables it)
+	int tlb_associativity;			// Ways per TLB set (power of two, at most tlb_entries)
+	enum MM_ReplacementPolicy replacement_policy;
+	int swap_direct_io;			// Non-zero opens swap with O_DIRECT where the filesystem allows it
+	const char *swap_path;			// The swap file or block device, "./mm.swp" if NULL (see MM_Create())
+	uint64_t swap_size_bytes;		// How big swap can get, 0 for no limit (besides a block device's size)
+	int swap_io_threads;			// Worker threads for swap I/O, 0 does it all synchronously
+	int writeback_low_watermark;		// Start cleaning dirty pages when fewer frames than this are free or clean (0 disables it)
+	int writeback_high_watermark;		// ...and keep going until this many are
+	int readahead_max_pages;		// Most pages to read ahead once faults follow a stride, up to 16 (0 disables it)
+	enum MM_Endianness endianness;		// Byte order of values accessed with MM_Load16() and friends
+	int stats_dump_interval_ms;		// Write MM_GetStats() out this often, 0 never does
+	const char *stats_dump_path;		// ...as a JSON line appended to this file, stderr if NULL
+	int pte_size_bytes;			// 4 or 8 for fixed 32 or 64-bit PTEs (1 or 2 also work), 0 for the smallest that fits
+};
+
+// Fill in 'config' with the default geometry.
+void MM_DefaultConfig(struct MM_Config *config);
+
+// (Re)initialize the memory manager with the given geometry, allocating
+// physical memory, the frame table and the process table. With a multi-level
+// page table, each level indexes as many VPN bits as fit in one page of PTEs
+// and the virtual address space must be covered by 'page_table_levels' levels.
+// Intermediate tables are allocated on first touch and can be swapped out. Any previous state,
+// including swap, is thrown away. Passing NULL uses the default geometry.
+// Returns 0 on success, or -1 if the geometry is not supported.
+int MM_Init(const struct MM_Config *config);
+
+// Switch to a different replacement policy without losing any state. Pages
+// that are already resident are handed to the new policy in frame order.
+// Returns 0 on success, or -1 for an unknown policy.
+int MM_SetReplacementPolicy(enum MM_ReplacementPolicy policy);
+
+// One access in a future reference string, for MM_POLICY_OPT.
+struct MM_Access {
+	int pid;
+	uint64_t address;
+};
+
+// Give MM_POLICY_OPT the exact sequence of MM_Map(), MM_LoadByte() and
+// MM_StoreByte() calls that will follow, so it can evict whichever page is
+// used furthest in the future. The geometry has to be set up first, since
+// accesses are tracked by page. Returns 0 on success, or -1 on failure.
+int MM_SetOracle(const struct MM_Access *future, size_t count);
+
 // Results of a MM_Map() function call.
 struct MM_MapResult {
 	int error;
@@ -51,23 +124,158 @@ struct MM_MapResult {
 // not the page number. If the page corresponding to 'address' is unmapped,
 // create a pagetable entry. If the page is already mapped, update the
 // permission bits of the mapping to adhere to the new 'writable' setting.
-struct MM_MapResult MM_Map(int pid, uint32_t address, int writable);
+struct MM_MapResult MM_Map(int pid, uint64_t address, int writable);
 
-// Enable Swap Whether to enable Swap in the memory manager. This should
-// open a file on the filesystem, and allow storage of virtual pages
-// in the file backing.
+// Enable Swap Whether to enable Swap in the memory manager. Every process
+// swaps to the one device named by MM_Config.swap_path, which is opened
+// the first time a page is swapped out.
 void MM_SwapOn();
 
+// Start bringing in the (already mapped) page holding 'address' without
+// waiting for swap, so the caller can keep running other pids in the
+// meantime. Returns 0 if the page is resident by the time this returns, 1
+// if it's on its way in, or -1 on error (including when too many faults are
+// already in flight). Any access to the page finishes the fault first.
+int MM_FaultAsync(int pid, uint64_t address);
+
+// Finish faults started by MM_FaultAsync() whose page has been read in,
+// filling 'done' with up to 'max' of them. If 'wait' is non-zero and none
+// are ready, this blocks until one is (as long as any are in flight).
+// Returns how many were finished. A fault whose read failed is reported too,
+// and the next access to the page will try again.
+int MM_FaultComplete(struct MM_Access *done, int max, int wait);
+
+// What MM_TranslateBatch() found for each address.
+enum MM_TranslateStatus {
+	MM_TRANSLATE_HIT,		// The page was resident
+	MM_TRANSLATE_FAULTED,		// The page had to be brought in
+	MM_TRANSLATE_EJECTED,		// The page was brought in, but ejected again to make room for a later one
+	MM_TRANSLATE_ERROR,		// The address couldn't be read from (see MM_LoadByte())
+};
+
+// Translate 'n' virtual addresses of 'pid' for reading, storing the physical
+// address (an offset into physical memory) of each in 'phys_out' and an
+// MM_TranslateStatus in 'status_out'. Pages that aren't resident are all
+// started reading in before any of them is waited on. The physical addresses
+// stay good until the next call that can eject a page, and only when the
+// status is HIT or FAULTED. Returns how many addresses were translated, or -1
+// if the pid is out of range.
+int MM_TranslateBatch(int pid, const uint64_t *addresses, size_t n, uint64_t *phys_out, uint8_t *status_out);
+
 // Load a byte from the specified address.
 // 0 is returned for a valid load operation. If the page is not mapped,
 // and AutoMap is not enabled, return -1.
-int MM_LoadByte(int pid, uint32_t address, uint8_t *value);
+int MM_LoadByte(int pid, uint64_t address, uint8_t *value);
 
 // Store a byte in the specified address. 
 // 0 is returned for a valid store operation. If the page is not mapped,
 // is mapped read-only, or AutoMap is not enabled, return -1.
 // The memory should be modified ONLY if the return value is zero.
-int MM_StoreByte(int pid, uint32_t address, uint8_t value);
+int MM_StoreByte(int pid, uint64_t address, uint8_t value);
+
+// Copy 'len' bytes starting at 'address' into 'buf', or from 'buf' to
+// 'address'. Each page in the range is translated (and faulted in) once and
+// copied whole, so this is much faster than a loop of MM_LoadByte() or
+// MM_StoreByte() calls, though the replacement policy only sees one access
+// per page. Returns 0 on success, or -1 if any page in the range can't be
+// read (or written), in which case the pages before it were already copied.
+int MM_Read(int pid, uint64_t address, void *buf, size_t len);
+int MM_Write(int pid, uint64_t address, const void *buf, size_t len);
+
+// Load or store a 2, 4 or 8 byte value at the specified address, in the
+// byte order given by MM_Config.endianness. The address doesn't have to be
+// aligned. A value within one page takes a single translation, and one that
+// straddles two pages is split between them. Return 0 on success, or -1 under
+// the same conditions as MM_LoadByte() and MM_StoreByte() for any of the
+// bytes. A store modifies memory ONLY if the return value is zero.
+int MM_Load16(int pid, uint64_t address, uint16_t *value);
+int MM_Load32(int pid, uint64_t address, uint32_t *value);
+int MM_Load64(int pid, uint64_t address, uint64_t *value);
+int MM_Store16(int pid, uint64_t address, uint16_t value);
+int MM_Store32(int pid, uint64_t address, uint32_t value);
+int MM_Store64(int pid, uint64_t address, uint64_t value);
+
+// A latency histogram, in nanoseconds. Like an HDR histogram, each power of
+// two is split into 16 equal buckets, so a value is recorded to within about
+// 6%. Values under 16 ns get a bucket each, and anything from 2^40 ns (about
+// 18 minutes) up lands in the last bucket.
+#define MM_HISTOGRAM_SUB_BITS	4
+#define MM_HISTOGRAM_MAX_BITS	40
+#define MM_HISTOGRAM_BUCKETS	((MM_HISTOGRAM_MAX_BITS - MM_HISTOGRAM_SUB_BITS + 1) << MM_HISTOGRAM_SUB_BITS)
+
+struct MM_Histogram {
+	uint64_t count;
+	uint64_t total_ns;
+	uint64_t buckets[MM_HISTOGRAM_BUCKETS];
+};
+
+// The latency (the top of its bucket) that 'percentile' percent of the
+// recorded values are at or under, or 0 if nothing was recorded.
+uint64_t MM_HistogramPercentile(const struct MM_Histogram *histogram, double percentile);
+
+// Counts of what the memory manager has done since MM_Init(). These are kept
+// per thread, so keeping them costs next to nothing, and added up when asked for.
+struct MM_Stats {
+	uint64_t tlb_hits;		// Loads and stores answered by a TLB
+	uint64_t faults;		// Data pages brought in for an access (read ahead pages aren't counted)
+	uint64_t evictions;		// Pages (data or page tables) ejected to make room
+	uint64_t writebacks;		// Dirty pages (and page tables) written to swap
+	uint64_t swap_bytes_read;	// Bytes actually read from and written to the swap
+	uint64_t swap_bytes_written;	// device (pages of zeroes that were never written aren't read)
+
+	uint64_t translations;		// Pages looked up for a load or store, hit or miss
+	uint64_t minor_faults;		// Faults that didn't have to read the swap device
+	uint64_t major_faults;		// Faults that did
+	uint64_t evictions_data;	// Evictions split by what was ejected...
+	uint64_t evictions_page_table;
+	uint64_t evictions_same_pid;	// ...and by whether it belonged to the pid that needed the frame
+	uint64_t evictions_other_pid;
+
+	struct MM_Histogram page_in;	// How long each read from the swap device took
+	struct MM_Histogram page_out;	// ...and each write to it
+};
+
+// Fill in 'stats' with the counts so far.
+void MM_GetStats(struct MM_Stats *stats);
+
+// Instances. Every call above works on one default memory manager, but any
+// number of separate ones can be created, each with its own geometry,
+// physical memory, processes, replacement policy and swap device. The
+// MM_*_ex() calls below do exactly what the call they're named after does,
+// only to 'instance' rather than the default. Different instances can be used
+// from different threads at once, with the same rules as the default one
+// within an instance.
+struct MM_Instance;
+
+// Create an instance with the given geometry, as if by MM_Init(). Unless
+// config->swap_path is set, it swaps to a file of its own rather than
+// "./mm.swp". Returns NULL if the geometry is not supported.
+struct MM_Instance *MM_Create(const struct MM_Config *config);
+
+// Free an instance from MM_Create() and everything it holds. Nothing else
+// can be using it at the time.
+void MM_Destroy(struct MM_Instance *instance);
+
+int MM_Init_ex(struct MM_Instance *instance, const struct MM_Config *config);
+int MM_SetReplacementPolicy_ex(struct MM_Instance *instance, enum MM_ReplacementPolicy policy);
+int MM_SetOracle_ex(struct MM_Instance *instance, const struct MM_Access *future, size_t count);
+struct MM_MapResult MM_Map_ex(struct MM_Instance *instance, int pid, uint64_t address, int writable);
+void MM_SwapOn_ex(struct MM_Instance *instance);
+int MM_FaultAsync_ex(struct MM_Instance *instance, int pid, uint64_t address);
+int MM_FaultComplete_ex(struct MM_Instance *instance, struct MM_Access *done, int max, int wait);
+int MM_TranslateBatch_ex(struct MM_Instance *instance, int pid, const uint64_t *addresses, size_t n,
+		uint64_t *phys_out, uint8_t *status_out);
+int MM_LoadByte_ex(struct MM_Instance *instance, int pid, uint64_t address, uint8_t *value);
+int MM_StoreByte_ex(struct MM_Instance *instance, int pid, uint64_t address, uint8_t value);
+int MM_Read_ex(struct MM_Instance *instance, int pid, uint64_t address, void *buf, size_t len);
+int MM_Write_ex(struct MM_Instance *instance, int pid, uint64_t address, const void *buf, size_t len);
+int MM_Load16_ex(struct MM_Instance *instance, int pid, uint64_t address, uint16_t *value);
+int MM_Load32_ex(struct MM_Instance *instance, int pid, uint64_t address, uint32_t *value);
+int MM_Load64_ex(struct MM_Instance *instance, int pid, uint64_t address, uint64_t *value);
+int MM_Store16_ex(struct MM_Instance *instance, int pid, uint64_t address, uint16_t value);
+int MM_Store32_ex(struct MM_Instance *instance, int pid, uint64_t address, uint32_t value);
+int MM_Store64_ex(struct MM_Instance *instance, int pid, uint64_t address, uint64_t value);
+void MM_GetStats_ex(struct MM_Instance *instance, struct MM_Stats *stats);
 
 // Turn on debug statements.
 void Debug();
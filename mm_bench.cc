@@ -0,0 +1,306 @@
+#include <benchmark/benchmark.h>
+
+#include <unistd.h>
+
+#include "mm_api.h"
+
+// Microbenchmarks of the memory manager's hot paths, built with optimizations by "make mm_bench".
+// "make bench" runs them all and writes the results to bench.json, which the compare.py that comes
+// with Google Benchmark can diff against an earlier run's.
+//
+// Most benchmarks take the page size (in bits) and the number of page table levels as their first
+// two arguments. The virtual address space is as big as that many levels can cover, up to 2^20
+// pages. Benchmarks that fault report what each op cost in faults, evictions and so on, from
+// MM_GetStats().
+
+#define BENCH_SWAP_PATH "mm_bench.swp"
+
+// The most pages a benchmark sweeps over
+#define BENCH_MAX_PAGES 4096
+
+// Sets up the default instance, with swap turned on if 'swap' is set. Returns how many pages each
+// process has room for, or 0 if the geometry isn't supported
+static uint64_t setup(benchmark::State &state, int page_bits, int levels, int frames, int processes, int swap) {
+	struct MM_Config config;
+	MM_DefaultConfig(&config);
+	config.page_size_bits = page_bits;
+	config.physical_memory_size_bytes = (uint64_t)frames << page_bits;
+	config.page_table_levels = levels;
+	config.max_processes = processes;
+	config.swap_path = BENCH_SWAP_PATH;
+
+	// Take the biggest address space that fits, the way mm_sweep does
+	int shift = page_bits + 20;
+	while (shift > page_bits) {
+		config.process_virtual_memory_size_shift = shift;
+		if (MM_Init(&config) == 0) break;
+		shift--;
+	}
+	if (shift == page_bits) {
+		state.SkipWithError("geometry not supported");
+		return 0;
+	}
+
+	if (swap) {
+		MM_SwapOn();
+	}
+
+	return (uint64_t)1 << (shift - page_bits);
+}
+
+static void teardown() {
+	MM_Init(NULL);
+	unlink(BENCH_SWAP_PATH);
+}
+
+// Maps the first 'pages' pages of 'pid', writeable
+static bool map_pages(benchmark::State &state, int pid, uint64_t pages, int page_bits) {
+	for (uint64_t i = 0; i < pages; i++) {
+		if (MM_Map(pid, i << page_bits, 1).error) {
+			state.SkipWithError("MM_Map() failed");
+			return false;
+		}
+	}
+	return true;
+}
+
+// Reports each op's share of what the memory manager did since 'before'
+static void report_stats(benchmark::State &state, const struct MM_Stats &before) {
+	struct MM_Stats after;
+	MM_GetStats(&after);
+
+	auto per_op = [&state](uint64_t count) {
+		return benchmark::Counter((double)count, benchmark::Counter::kAvgIterations);
+	};
+	state.counters["tlb_hits"] = per_op(after.tlb_hits - before.tlb_hits);
+	state.counters["minor_faults"] = per_op(after.minor_faults - before.minor_faults);
+	state.counters["major_faults"] = per_op(after.major_faults - before.major_faults);
+	state.counters["evictions"] = per_op(after.evictions - before.evictions);
+	state.counters["table_evictions"] = per_op(after.evictions_page_table - before.evictions_page_table);
+	state.counters["writebacks"] = per_op(after.writebacks - before.writebacks);
+}
+
+static void geometries(benchmark::internal::Benchmark *b) {
+	b->ArgNames({ "page_bits", "levels" });
+	b->ArgsProduct({ { 8, 12 }, { 1, 2, 3 } });
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TLB hits.                                                                 //
+///////////////////////////////////////////////////////////////////////////////
+
+static void BM_LoadHit(benchmark::State &state) {
+	int page_bits = (int)state.range(0);
+	if (setup(state, page_bits, (int)state.range(1), 64, 1, 0) == 0 || !map_pages(state, 0, 1, page_bits)) return;
+	MM_StoreByte(0, 0, 1);
+
+	uint8_t value;
+	for (auto _ : state) {
+		MM_LoadByte(0, 0, &value);
+		benchmark::DoNotOptimize(value);
+	}
+	teardown();
+}
+BENCHMARK(BM_LoadHit)->Apply(geometries);
+
+static void BM_StoreHit(benchmark::State &state) {
+	int page_bits = (int)state.range(0);
+	if (setup(state, page_bits, (int)state.range(1), 64, 1, 0) == 0 || !map_pages(state, 0, 1, page_bits)) return;
+
+	uint8_t value = 0;
+	for (auto _ : state) {
+		MM_StoreByte(0, 0, value++);
+	}
+	teardown();
+}
+BENCHMARK(BM_StoreHit)->Apply(geometries);
+
+// Loads that hit from several threads at once, one pid each, which only take a lock on a miss
+static void BM_LoadHitThreads(benchmark::State &state) {
+	int pid = state.thread_index() % MM_MAX_PROCESSES;
+
+	uint8_t value;
+	for (auto _ : state) {
+		MM_LoadByte(pid, 0, &value);
+		benchmark::DoNotOptimize(value);
+	}
+}
+BENCHMARK(BM_LoadHitThreads)
+	->Setup([](const benchmark::State &state) {
+		// Room for every pid's page table and page, so nothing is ever ejected
+		struct MM_Config config;
+		MM_DefaultConfig(&config);
+		config.physical_memory_size_bytes = 4 * MM_MAX_PROCESSES * MM_PAGE_SIZE_BYTES;
+		MM_Init(&config);
+		for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+			MM_Map(pid, 0, 1);
+		}
+	})
+	->Teardown([](const benchmark::State &state) { teardown(); })
+	->ThreadRange(1, 8)
+	->UseRealTime();
+
+///////////////////////////////////////////////////////////////////////////////
+// Faults and evictions.                                                     //
+///////////////////////////////////////////////////////////////////////////////
+
+// Sweeps over more pages than fit, so every op faults and ejects a page. If 'write' is set the
+// sweep stores (so every victim is dirty) and otherwise loads. If 'prefill' is set every page is
+// written once beforehand, so faults read from swap rather than zero filling a page
+static void fault_sweep(benchmark::State &state, int write, int prefill) {
+	int page_bits = (int)state.range(0);
+	uint64_t pages = setup(state, page_bits, (int)state.range(1), 32, 1, 1);
+	if (pages == 0) return;
+	if (pages > BENCH_MAX_PAGES) pages = BENCH_MAX_PAGES;
+	if (pages < 64) {
+		state.SkipWithError("address space too small to sweep");
+		teardown();
+		return;
+	}
+	if (!map_pages(state, 0, pages, page_bits)) return;
+
+	uint8_t value = 0;
+	for (uint64_t i = 0; prefill && i < pages; i++) {
+		MM_StoreByte(0, i << page_bits, 1);
+	}
+	// One lap without storing leaves every resident page clean
+	for (uint64_t i = 0; prefill && !write && i < pages; i++) {
+		MM_LoadByte(0, i << page_bits, &value);
+	}
+
+	struct MM_Stats before;
+	MM_GetStats(&before);
+
+	uint64_t page = 0;
+	for (auto _ : state) {
+		uint64_t address = page << page_bits;
+		if (write) {
+			MM_StoreByte(0, address, value++);
+		} else {
+			MM_LoadByte(0, address, &value);
+		}
+		benchmark::DoNotOptimize(value);
+		page = page + 1 == pages ? 0 : page + 1;
+	}
+
+	report_stats(state, before);
+	teardown();
+}
+
+// A page that was never written comes in as zeroes, and the clean page it replaces is dropped
+static void BM_ColdFault(benchmark::State &state) {
+	fault_sweep(state, 0, 0);
+}
+BENCHMARK(BM_ColdFault)->Apply(geometries);
+
+// Every fault reads from swap, and the victim is clean so it isn't written back
+static void BM_EvictClean(benchmark::State &state) {
+	fault_sweep(state, 0, 1);
+}
+BENCHMARK(BM_EvictClean)->Apply(geometries);
+
+// Every fault reads from swap, and the victim is dirty so it's written back first
+static void BM_EvictDirty(benchmark::State &state) {
+	fault_sweep(state, 1, 1);
+}
+BENCHMARK(BM_EvictDirty)->Apply(geometries);
+
+// Many processes with a page each and too few frames for all of their page tables, so root
+// tables keep getting ejected and brought back by load_page_table()
+static void BM_PageTableReload(benchmark::State &state) {
+	const int processes = 64;
+	int page_bits = (int)state.range(0);
+	if (setup(state, page_bits, (int)state.range(1), 16, processes, 1) == 0) return;
+	for (int pid = 0; pid < processes; pid++) {
+		if (!map_pages(state, pid, 1, page_bits)) return;
+		MM_StoreByte(pid, 0, (uint8_t)pid);
+	}
+
+	struct MM_Stats before;
+	MM_GetStats(&before);
+
+	int pid = 0;
+	uint8_t value;
+	for (auto _ : state) {
+		MM_LoadByte(pid, 0, &value);
+		benchmark::DoNotOptimize(value);
+		pid = pid + 1 == processes ? 0 : pid + 1;
+	}
+
+	report_stats(state, before);
+	teardown();
+}
+BENCHMARK(BM_PageTableReload)->Apply(geometries);
+
+// A cyclic sweep under clock over a quarter more pages than there are frames, so the hand passes
+// over every frame between faults. Its cost per op is mostly how fast the hand moves
+static void BM_ClockSweep(benchmark::State &state) {
+	const int page_bits = 8;
+	int frames = (int)state.range(0);
+	uint64_t pages = setup(state, page_bits, 3, frames, 1, 1);
+	if (pages == 0) return;
+	if (pages > (uint64_t)frames + frames / 4) pages = (uint64_t)frames + frames / 4;
+	if (MM_SetReplacementPolicy(MM_POLICY_CLOCK) != 0) {
+		state.SkipWithError("MM_SetReplacementPolicy() failed");
+		teardown();
+		return;
+	}
+	if (!map_pages(state, 0, pages, page_bits)) return;
+
+	struct MM_Stats before;
+	MM_GetStats(&before);
+
+	uint64_t page = 0;
+	uint8_t value;
+	for (auto _ : state) {
+		MM_LoadByte(0, page << page_bits, &value);
+		benchmark::DoNotOptimize(value);
+		page = page + 1 == pages ? 0 : page + 1;
+	}
+
+	report_stats(state, before);
+	teardown();
+}
+BENCHMARK(BM_ClockSweep)->ArgName("frames")->Arg(1 << 10)->Arg(1 << 16);
+
+///////////////////////////////////////////////////////////////////////////////
+// Several processes.                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+// Round robin over 'pids' processes touching 8 pages each, on one thread. With enough frames it's
+// all TLB misses and hits, and with too few the processes eject each other's pages
+static void BM_Interleaved(benchmark::State &state) {
+	const int page_bits = 12;
+	const uint64_t pages = 8;
+	int pids = (int)state.range(0);
+	int frames = (int)state.range(1);
+	if (setup(state, page_bits, 2, frames, pids, 1) == 0) return;
+	for (int pid = 0; pid < pids; pid++) {
+		if (!map_pages(state, pid, pages, page_bits)) return;
+	}
+
+	struct MM_Stats before;
+	MM_GetStats(&before);
+
+	uint64_t op = 0;
+	uint8_t value = 0;
+	for (auto _ : state) {
+		int pid = (int)(op % pids);
+		uint64_t address = ((op / pids) % pages) << page_bits;
+		if (op % 4 == 0) {
+			MM_StoreByte(pid, address, value++);
+		} else {
+			MM_LoadByte(pid, address, &value);
+		}
+		benchmark::DoNotOptimize(value);
+		op++;
+	}
+
+	report_stats(state, before);
+	teardown();
+}
+BENCHMARK(BM_Interleaved)
+	->ArgNames({ "pids", "frames" })
+	->ArgsProduct({ { 1, 4, 16 }, { 32, 512 } });
+
+BENCHMARK_MAIN();
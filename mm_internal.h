@@ -0,0 +1,308 @@
+#ifndef MM_INTERNAL_H__
+#define MM_INTERNAL_H__
+
+// State and helpers shared between the memory manager's source files. None of this is part of
+// the public API in mm_api.h.
+
+#include <pthread.h>
+
+#include "mm_api.h"
+
+extern int debug;
+// This is a helpful macro for adding debug prints through the code. Use it like printf.
+// When running a full test suite this will be silent, but when running a single test
+// Debug() will be called.
+#define DEBUG(args...)	do { if (debug) { fprintf(stderr, "%s:%d: ", __FUNCTION__, __LINE__); fprintf(stderr, args); } } while(0)
+
+// Every entry point uses this to fall back on the default geometry if MM_Init() was never called.
+// It has to be called before taking the instance's lock
+int ensure_init();
+
+// Per physical page -> virtual page mappings, such that we can choose what to eject. Each field
+// is an array of its own rather than a field of a per-frame struct, since most scans over the
+// frames only look at a flag or two. The flags are bitmaps of 64 frames to a word, so a scan can
+// pass over a word's worth of frames that don't interest it at once
+struct frame_table {
+	int *pid;		// I found it useful to store the PID in the page entry
+	int64_t *vpn;		// ...and the VPN of the installed page (for page tables, the VPN prefix it covers)
+	int *resident_children;	// For page tables, how many entries point at pages in phys_mem
+	uint8_t *level;		// For page tables, how deep in the tree it is (0 = root)
+
+	uint64_t *valid;	// Is the frame in use
+	uint64_t *page_table;	// Does it hold a page table, rather than data
+	uint64_t *pinned;	// For page tables, is its resident_children nonzero. For data, is it held in place
+	uint64_t *dirty;	// For data pages, is its PTE dirty
+	uint64_t *prefetched;	// For data pages, was it read ahead and not used yet
+
+	int num_words;		// In each bitmap
+};
+
+// Everything one memory manager keeps. Each instance is a machine of its own, with its own
+// geometry, physical memory, processes and swap device, so any number of them can run side by side
+struct MM_Instance {
+	// The geometry in use, along with the sizes derived from it. These used to be the MM_* macros,
+	// but they're set by MM_Init() now so one binary can run any geometry
+	struct MM_Config config;
+	int page_size_bytes;
+	uint64_t page_offset_mask;
+	int num_phys_pages;
+	uint64_t process_virtual_memory_size_bytes;
+	uint64_t num_virtual_pages;
+	int pte_size_bytes;
+	uint64_t pte_field_mask;	// The field above a PTE's flags, shifted down
+
+	// Every page table (at every level) is one page of PTEs, so each level indexes this many VPN bits
+	int entries_per_table;
+	int bits_per_level;
+
+	// Guards everything the instance keeps. Loads that hit in the TLB usually don't take it at all,
+	// stores that hit hold it shared (along with a per-process lock), and every other call holds it
+	// exclusively. The replacement policy has its own lock on top
+	pthread_rwlock_t lock;
+
+	// Physical memory is allocated by MM_Init(), it's NULL until then
+	uint8_t *phys_mem;
+
+	// Allocated by MM_Init() with num_phys_pages and config.max_processes entries
+	struct frame_table frames;
+	struct process *processes;
+
+	// Backing storage for every process' TLB, and the mask that picks a set from a VPN
+	struct tlb_entry *tlbs;
+	uint64_t tlb_set_mask;
+
+	int swap_enabled;
+
+	// Every frame that isn't in use, kept as a stack so reserve_ppn() never has to go looking for
+	// one. Frames only come back here when a page couldn't be brought in, since an ejected frame
+	// goes straight to whoever needed it
+	int *free_ppns;
+	int num_free_ppns;
+
+	// What read_lockfree() checks a frame against. A frame's sequence count is odd while it's being
+	// ejected, and its owner is owner_key() of the data page in it once the page is fully read in
+	// (and 0 otherwise)
+	uint32_t *frame_seq;
+	uint64_t *frame_owner;
+
+	// Faults whose page is still being read in (see struct async_fault in mm_api.c)
+	struct async_fault *async_faults;
+	int num_async_faults;
+
+	// Frames that can be handed out without waiting for a write are the free ones, plus the
+	// resident data pages that are clean. The writeback cleaner keeps enough of them around by
+	// writing dirty pages out ahead of time, sweeping a hand over the frames to find them
+	int num_data_pages;
+	int num_dirty_pages;
+	int clean_hand;
+
+	// What MM_GetStats() adds up (see mm_stats.c), allocated by MM_Init()
+	struct stat_shard *stat_shards;
+
+	// Loads that go around 'lock' (see read_lockfree() in mm_api.c) still report accesses, so the
+	// replacement policy takes this lock of its own. It outlives the policy's state, which is
+	// torn down and rebuilt whenever the policy changes
+	pthread_mutex_t policy_lock;
+
+	// What mm_policy.c, mm_swap.c and mm_stats.c keep, private to them
+	struct policy_state *policy;
+	struct swap_state *swap;
+	struct stats_dumper *dumper;
+
+	// Told apart in default swap paths, so instances don't share a swap file by accident
+	int id;
+};
+
+// The instance the calling thread is working on. Every public entry point sets it before doing
+// anything else, so everything under it can use 'mm' the way it used to use globals. The MM_*
+// calls that don't take an instance work on default_instance
+extern __thread struct MM_Instance *mm;
+extern struct MM_Instance default_instance;
+
+static inline int frame_test(const uint64_t *bitmap, int ppn) {
+	return (bitmap[ppn >> 6] >> (ppn & 63)) & 1;
+}
+
+// The frame table is only changed under the instance's exclusive lock, so these needn't be atomic
+static inline void frame_set(uint64_t *bitmap, int ppn) {
+	bitmap[ppn >> 6] |= (uint64_t)1 << (ppn & 63);
+}
+
+static inline void frame_clear(uint64_t *bitmap, int ppn) {
+	bitmap[ppn >> 6] &= ~((uint64_t)1 << (ppn & 63));
+}
+
+static inline void frame_assign(uint64_t *bitmap, int ppn, int value) {
+	if(value)
+		frame_set(bitmap, ppn);
+	else
+		frame_clear(bitmap, ppn);
+}
+
+// Keeps the pinned bit in step with resident_children
+static inline void frame_add_children(int ppn, int delta) {
+	mm->frames.resident_children[ppn] += delta;
+	frame_assign(mm->frames.pinned, ppn, mm->frames.resident_children[ppn] != 0);
+}
+
+// A frame can be ejected if it holds data that isn't being held in place, or a page table with
+// nothing resident under it. Tables that are part of a walk in progress have their
+// resident_children bumped, so they're never picked out from under it. This gives the 64 frames
+// in bitmap word 'word' at once
+static inline uint64_t frames_evictable(int word) {
+	return mm->frames.valid[word] & ~mm->frames.pinned[word];
+}
+
+static inline int frame_is_evictable(int ppn) {
+	return (frames_evictable(ppn >> 6) >> (ppn & 63)) & 1;
+}
+
+// Counters are kept in STAT_SHARDS cache line aligned shards, and each thread adds to the one it
+// was given the first time it counted something. Threads that share a shard still count correctly
+// (the adds are atomic), and a shard only shared by one thread never has its line stolen by another
+// core, so counting costs about as much as an uncontended add
+enum stat_counter {
+	STAT_TLB_HITS,
+	STAT_TLB_MISSES,
+	STAT_MINOR_FAULTS,
+	STAT_MAJOR_FAULTS,
+	STAT_EVICTIONS_DATA,
+	STAT_EVICTIONS_PAGE_TABLE,
+	STAT_EVICTIONS_SAME_PID,
+	STAT_EVICTIONS_OTHER_PID,
+	STAT_WRITEBACKS,
+	STAT_SWAP_BYTES_READ,
+	STAT_SWAP_BYTES_WRITTEN,
+	NUM_STAT_COUNTERS
+};
+
+enum stat_histogram { STAT_PAGE_IN, STAT_PAGE_OUT, NUM_STAT_HISTOGRAMS };
+
+#define STAT_SHARDS	16
+
+struct stat_shard {
+	uint64_t counters[NUM_STAT_COUNTERS];
+	struct MM_Histogram histograms[NUM_STAT_HISTOGRAMS];
+} __attribute__((aligned(64)));
+
+// Which shard the calling thread counts into, or -1 until it first counts something
+extern __thread int stat_shard_index;
+
+// Implemented in mm_stats.c. stats_init() allocates the shards and starts the periodic dump if
+// MM_Config asks for one, and stats_destroy() stops it and frees everything
+int stats_init();
+void stats_destroy();
+int stat_shard_assign();
+void stat_record(enum stat_histogram histogram, uint64_t ns);
+uint64_t stat_now_ns();
+
+static inline void stat_add(enum stat_counter counter, uint64_t n) {
+	if(stat_shard_index < 0)
+		stat_shard_index = stat_shard_assign();
+
+	__atomic_fetch_add(&mm->stat_shards[stat_shard_index].counters[counter], n, __ATOMIC_RELAXED);
+}
+
+// Identifies a page no matter which frame (if any) it's in. Page tables are told apart from data
+// pages by 'kind', which is 0 for data and the table's level + 1 otherwise
+struct page_key {
+	int pid;
+	int kind;
+	int64_t vpn;
+};
+
+// An open addressing hash map from pages to a value, used for ARC's ghost lists, for working out
+// OPT's next use times and for finding where a page lives in swap
+struct page_map_slot {
+	struct page_key key;
+	int64_t value;
+	uint8_t used;
+};
+
+struct page_map {
+	struct page_map_slot *slots;
+	size_t mask;
+	size_t size;
+};
+
+// Implemented in mm_page_map.c. page_map_find() returns NULL if the page isn't in the map, and
+// the slot it returns is only good until the map is next changed
+int page_map_init(struct page_map *map, size_t capacity);
+void page_map_free(struct page_map *map);
+struct page_map_slot *page_map_find(struct page_map *map, struct page_key key);
+int page_map_put(struct page_map *map, struct page_key key, int64_t value);
+void page_map_erase(struct page_map *map, struct page_map_slot *slot);
+
+// A replacement policy decides which resident frame eject_phys_page() gives up. mm_api.c tells
+// the policy whenever a frame becomes resident, is referenced, or stops being resident, and the
+// policy keeps whatever bookkeeping it needs in between. Any hook except choose_victim can be NULL
+struct replacement_policy {
+	const char *name;
+
+	// Set up and tear down per-frame state for num_phys_pages frames
+	int (*init)(void);
+	void (*destroy)(void);
+
+	// A page (data or page table) was just installed in 'ppn'
+	void (*insert)(int ppn);
+
+	// The data page in 'ppn' was just loaded from or stored to
+	void (*access)(int ppn);
+
+	// The page in 'ppn' is about to leave phys_mem
+	void (*remove)(int ppn);
+
+	// Pick an evictable frame to give to 'reserving_pid', or -1 if there isn't one
+	int (*choose_victim)(int reserving_pid);
+};
+
+// Implemented in mm_policy.c. These wrap the active policy's hooks
+int policy_init(enum MM_ReplacementPolicy policy);
+void policy_destroy();
+void policy_insert(int ppn);
+void policy_access(int ppn);
+void policy_remove(int ppn);
+int policy_choose_victim(int reserving_pid);
+
+// How many accesses (to any page) there have been since the page in 'ppn' was last used
+uint64_t policy_idle_time(int ppn);
+
+// policy_access() for callers that don't hold the instance's lock. The access is only recorded if the policy
+// isn't busy and '*seq' (the frame's sequence count) still equals 'expected', and is dropped
+// otherwise, much like a reference bit that's sampled rather than kept exactly
+void policy_try_access(int ppn, const uint32_t *seq, uint32_t expected);
+
+// Implemented in mm_swap.c. Every process in an instance swaps to one device, which is divided into page-sized
+// slots that are handed out as pages are swapped out. swap_read() gives back zeroes for a page
+// that has no slot, and swap_discard() frees a page's slot once the copy in it is stale.
+// swap_contains() says whether the page has a slot at all, and swap_slot() which one (or -1)
+int swap_init();
+void swap_destroy();
+int swap_write(struct page_key key, const uint8_t *mem);
+int swap_read(struct page_key key, uint8_t *mem);
+void swap_discard(struct page_key key);
+int swap_contains(struct page_key key);
+int64_t swap_slot(struct page_key key);
+
+// Whether reading the page back would have to go to the device, rather than coming back as zeroes
+// or out of a write that hasn't finished. That's what makes a fault a major one. swap_pending()
+// is just the second half, whether a write of the page hasn't finished
+int swap_on_device(struct page_key key);
+int swap_pending(struct page_key key);
+
+// With MM_Config.swap_io_threads set, swap_write() copies the page and hands it to a worker, so
+// it returns before the page is on the device (reads of the page are served from the copy until
+// then). swap_flush() waits for every write to finish
+void swap_flush();
+
+// Reads that don't wait for the device. swap_read_start() returns a handle (or -1 if too many
+// reads are in flight) that has to be passed to swap_read_finish(), which waits for the read and
+// returns 0 if it worked. swap_read_poll() says whether the read is done without waiting.
+// swap_read_wait() waits for it without finishing it, and only takes the I/O lock, so it can be
+// called with mm->lock dropped
+int swap_read_start(struct page_key key, uint8_t *mem);
+int swap_read_poll(int handle);
+void swap_read_wait(int handle);
+int swap_read_finish(int handle);
+
+#endif	// MM_INTERNAL_H__
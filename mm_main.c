@@ -2,108 +2,552 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "mm_api.h"
+#include "mm_trace.h"
+#include "mm_workload.h"
 
+// Converts a text trace (the same lines the interactive loop below reads) to a binary one.
+static int convert_trace(const char *in_path, const char *out_path)
+{
+	FILE *input = fopen(in_path, "r");
+	if (input == NULL) {
+		fprintf(stderr, "%s: %s\n", in_path, strerror(errno));
+		return 1;
+	}
+
+	struct trace_writer writer;
+	if (trace_writer_open(&writer, out_path)) {
+		fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+		fclose(input);
+		return 1;
+	}
+
+	char *line = NULL;
+	size_t linesz = 0;
+	size_t lineno = 0;
+	int ret = 0;
+
+	while (getline(&line, &linesz, input) >= 0) {
+		struct trace_op op;
+		int rc = trace_parse_line(line, &op);
+
+		lineno++;
+		if (rc < 0) {
+			fprintf(stderr, "%s:%zu: invalid input\n", in_path, lineno);
+			ret = 1;
+			break;
+		}
+		if (rc == 0) {
+			trace_writer_put(&writer, &op);
+		}
+	}
+
+	free(line);
+	fclose(input);
+	if (trace_writer_close(&writer)) {
+		fprintf(stderr, "%s: write failed\n", out_path);
+		ret = 1;
+	}
+	if (ret == 0) {
+		printf("Converted %llu ops\n", (unsigned long long)writer.count);
+	}
+
+	return ret;
+}
+
+// The geometry a run uses, from -p, -f, -v, -l, -n and -P, with 0 for any that wasn't given.
+// Those are the default geometry's, with the address space scaled to the page size so it has as
+// many pages as by default, and the fewest levels that cover it.
+static int page_bits;
+static int frames;
+static int vspace_bits;		// log2 of each process' address space in bytes
+static int levels;
+static int max_pids;
+static enum MM_ReplacementPolicy policy = MM_POLICY_SIMPLE;
+
+// The same names mm_sweep takes
+static const char *const policy_names[] = {
+	[MM_POLICY_SIMPLE] = "simple",
+	[MM_POLICY_FIFO] = "fifo",
+	[MM_POLICY_CLOCK] = "clock",
+	[MM_POLICY_SECOND_CHANCE] = "second_chance",
+	[MM_POLICY_LRU] = "lru",
+	[MM_POLICY_LRU_APPROX] = "lru_approx",
+	[MM_POLICY_LFU] = "lfu",
+	[MM_POLICY_ARC] = "arc",
+	[MM_POLICY_OPT] = "opt",
+};
+
+#define NUM_POLICIES	((int)(sizeof(policy_names) / sizeof(policy_names[0])))
+
+// Parses a positive number no bigger than 'max' into 'value'. Returns -1 if it isn't one
+static int parse_number(const char *arg, int max, int *value)
+{
+	char *end;
+	long parsed = strtol(arg, &end, 10);
+
+	if (*arg == 0 || *end != 0 || parsed < 1 || parsed > max) {
+		return -1;
+	}
+	*value = (int)parsed;
+	return 0;
+}
+
+static int parse_policy(const char *arg)
+{
+	for (int i = 0; i < NUM_POLICIES; i++) {
+		if (strcmp(arg, policy_names[i]) == 0) {
+			policy = (enum MM_ReplacementPolicy)i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+// What init_geometry() set the default instance up with
+static struct MM_Config config;
+
+// Sets up the default instance with the geometry above, the way mm_sweep sets up its instances
+static int init_geometry(void)
+{
+	page_bits = page_bits != 0 ? page_bits : MM_PAGE_SIZE_BITS;
+	frames = frames != 0 ? frames : MM_PHYSICAL_PAGES;
+	max_pids = max_pids != 0 ? max_pids : MM_MAX_PROCESSES;
+
+	MM_DefaultConfig(&config);
+	config.page_size_bits = page_bits;
+	config.physical_memory_size_bytes = (uint64_t)frames << page_bits;
+	config.process_virtual_memory_size_shift = vspace_bits != 0 ? vspace_bits :
+			page_bits + MM_PROCESS_VIRTUAL_MEMORY_SIZE_SHIFT - MM_PAGE_SIZE_BITS;
+	config.max_processes = max_pids;
+	config.replacement_policy = policy;
+
+	int last = levels != 0 ? levels : 4;
+	for (config.page_table_levels = levels != 0 ? levels : 1; config.page_table_levels <= last;
+			config.page_table_levels++) {
+		if (MM_Init(&config) == 0) {
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "unsupported geometry: %d bit pages, %d frames, %d bit address space, %d pids\n",
+			page_bits, frames, config.process_virtual_memory_size_shift, max_pids);
+	return 1;
+}
+
+// Writes a synthetic workload (see mm_workload.h) out as a binary trace, or as a text trace on
+// stdout if out_path is "-", to be piped into a batch run. The geometry flags that weren't given
+// are filled in from the workload, and a workload that doesn't fit the ones that were is refused,
+// so the flags printed at the end always run it.
+static int generate_trace(const char *spec, const char *out_path)
+{
+	struct workload_config workload_config;
+	struct workload workload;
+
+	workload_default_config(&workload_config);
+	if (workload_parse(spec, &workload_config) != 0 || workload_init(&workload, &workload_config) != 0) {
+		fprintf(stderr, "%s: invalid workload\n", spec);
+		return 1;
+	}
+
+	int footprint_bits = workload_config.page_size_bits;
+	while (footprint_bits < 63 && ((uint64_t)1 << (footprint_bits - workload_config.page_size_bits)) < workload_config.pages) {
+		footprint_bits++;
+	}
+
+	if (page_bits == 0) {
+		page_bits = workload_config.page_size_bits;
+	}
+	if (vspace_bits == 0) {
+		vspace_bits = footprint_bits;
+	}
+	if (max_pids == 0) {
+		max_pids = workload_config.pids;
+	}
+
+	if (page_bits != workload_config.page_size_bits || vspace_bits < footprint_bits ||
+			max_pids < workload_config.pids) {
+		fprintf(stderr, "%s: doesn't fit a geometry of %d bit pages, a %d bit address space and %d pids\n",
+				spec, page_bits, vspace_bits, max_pids);
+		return 1;
+	}
+	if (init_geometry() != 0) {
+		return 1;
+	}
+
+	// Anything printed goes to stderr when the trace itself is going to stdout
+	FILE *out = stdout;
+	if (strcmp(out_path, "-") == 0) {
+		if (workload_write_text(&workload, stdout) != 0) {
+			return 1;
+		}
+		out = stderr;
+	} else if (workload_write_binary(&workload, out_path) != 0) {
+		fprintf(stderr, "%s: write failed\n", out_path);
+		return 1;
+	} else {
+		fprintf(out, "Generated %llu ops\n", (unsigned long long)workload.total);
+	}
+
+	fprintf(out, "Run with: -p %d -f %d -v %d -l %d -n %d -P %s\n", page_bits, frames, vspace_bits,
+			config.page_table_levels, max_pids, policy_names[policy]);
+	return 0;
+}
+
+// What a batch run or a replay did, for the summary printed at the end.
+struct run_counts {
+	uint64_t ops[4];	// By enum trace_kind
+	uint64_t invalid;	// Lines that weren't a valid op, or were for a pid out of range
+	uint64_t failed;	// Ops the memory manager returned an error for
+};
+
+enum summary_format { SUMMARY_TEXT, SUMMARY_JSON, SUMMARY_CSV };
+
+static enum summary_format summary_format = SUMMARY_TEXT;
+
+// Every sample_every'th op is logged to stderr, or none if it's 0
+static uint64_t sample_every;
+
+// In batch mode nothing is printed per line, only the summary at the end.
+static int batch;
+#define SAY(args...)	do { if (!batch) { printf(args); } } while(0)
+
+static const char *kind_names[] = { "swap", "map", "load", "store" };
+
+static void count_op(struct run_counts *counts, const struct trace_op *op, int failed)
+{
+	uint64_t n = counts->ops[TRACE_SWAP] + counts->ops[TRACE_MAP] + counts->ops[TRACE_LOAD] +
+			counts->ops[TRACE_STORE] + 1;
+
+	counts->ops[op->kind]++;
+	counts->failed += failed != 0;
+
+	if (sample_every != 0 && n % sample_every == 0) {
+		fprintf(stderr, "op %llu: %d,%s,%llx,%u %s\n", (unsigned long long)n, op->pid,
+				kind_names[op->kind], (unsigned long long)op->address, op->value,
+				failed ? "failed" : "ok");
+	}
+}
+
+static double seconds_since(const struct timespec *start)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (double)(end.tv_sec - start->tv_sec) + (double)(end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void print_summary(const struct run_counts *counts, double seconds)
+{
+	uint64_t total = counts->ops[TRACE_SWAP] + counts->ops[TRACE_MAP] + counts->ops[TRACE_LOAD] +
+			counts->ops[TRACE_STORE];
+	struct MM_Stats stats;
+	MM_GetStats(&stats);
+
+	unsigned long long values[] = {
+		total, counts->ops[TRACE_MAP], counts->ops[TRACE_LOAD], counts->ops[TRACE_STORE],
+		counts->ops[TRACE_SWAP], counts->invalid, counts->failed, stats.tlb_hits, stats.faults,
+		stats.evictions, stats.writebacks, stats.swap_bytes_read, stats.swap_bytes_written,
+	};
+	const char *names[] = {
+		"ops", "maps", "loads", "stores", "swaps", "invalid", "failed", "tlb_hits", "faults",
+		"evictions", "writebacks", "swap_bytes_read", "swap_bytes_written",
+	};
+	int num_values = sizeof(values) / sizeof(values[0]);
+
+	if (summary_format == SUMMARY_JSON) {
+		printf("{");
+		for (int i = 0; i < num_values; i++) {
+			printf("\"%s\": %llu, ", names[i], values[i]);
+		}
+		printf("\"seconds\": %.6f}\n", seconds);
+	} else if (summary_format == SUMMARY_CSV) {
+		for (int i = 0; i < num_values; i++) {
+			printf("%s,", names[i]);
+		}
+		printf("seconds\n");
+		for (int i = 0; i < num_values; i++) {
+			printf("%llu,", values[i]);
+		}
+		printf("%.6f\n", seconds);
+	} else {
+		printf("Ran %llu ops in %.3f s (%.0f ops/s)\n", values[0], seconds,
+				seconds > 0 ? (double)total / seconds : 0.0);
+		printf("maps %llu, loads %llu, stores %llu, swaps %llu, invalid %llu, failed %llu\n",
+				values[1], values[2], values[3], values[4], values[5], values[6]);
+		printf("TLB hits %llu, faults %llu, evictions %llu, writebacks %llu\n",
+				values[7], values[8], values[9], values[10]);
+		printf("swap bytes read %llu, written %llu\n", values[11], values[12]);
+	}
+}
+
+// Runs a trace without any output until the end. A binary trace runs straight out of the mapped
+// file, anything else (a text trace, or a zstd or lz4 compressed trace of either kind) is decoded on
+// a producer thread that passes ops over through a trace_pipe.
+static int replay_trace(const char *path)
+{
+	struct trace_reader reader;
+	struct trace_pipe *pipe = NULL;
+	int mapped = trace_is_binary(path);
+
+	if (mapped ? trace_reader_open(&reader, path) != 0 : (pipe = trace_pipe_open(path)) == NULL) {
+		fprintf(stderr, "%s: can't open trace\n", path);
+		return 1;
+	}
+
+	struct run_counts counts;
+	memset(&counts, 0, sizeof(counts));
+	struct trace_op op;
+	uint8_t value;
+	int rc;
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while ((rc = mapped ? trace_reader_next(&reader, &op) : trace_pipe_next(pipe, &op)) == 1) {
+		int failed;
+
+		// Counted the same way a batch run counts them
+		if (op.kind != TRACE_SWAP && op.pid >= config.max_processes) {
+			counts.invalid++;
+			continue;
+		}
+
+		if (op.kind == TRACE_SWAP) {
+			MM_SwapOn();
+			failed = 0;
+		} else if (op.kind == TRACE_MAP) {
+			failed = MM_Map(op.pid, op.address, !!op.value).error != 0;
+		} else if (op.kind == TRACE_LOAD) {
+			failed = MM_LoadByte(op.pid, op.address, &value) != 0;
+		} else {
+			failed = MM_StoreByte(op.pid, op.address, op.value) != 0;
+		}
+
+		count_op(&counts, &op, failed);
+	}
+
+	double seconds = seconds_since(&start);
+	if (mapped) {
+		trace_reader_close(&reader);
+	} else {
+		trace_pipe_close(pipe);
+	}
+
+	if (rc < 0) {
+		fprintf(stderr, "%s: trace is corrupt or couldn't be decompressed\n", path);
+		return 1;
+	}
+
+	print_summary(&counts, seconds);
+	return 0;
+}
+
+static int usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [geometry] [-b] [-F text|json|csv] [-s N] [trace.txt]\n", argv0);
+	fprintf(stderr, "       %s [geometry] [-F text|json|csv] [-s N] -r trace\n", argv0);
+	fprintf(stderr, "       %s -c out.mmt trace.txt\n", argv0);
+	fprintf(stderr, "       %s -g workload_spec out.mmt|-\n", argv0);
+	fprintf(stderr, "geometry: [-p page_size_bits] [-f frames] [-v address_space_bits] [-l levels]\n"
+			"          [-n max_pids] [-P policy]\n");
+	fprintf(stderr, "policies:");
+	for (int i = 0; i < NUM_POLICIES; i++) {
+		fprintf(stderr, " %s", policy_names[i]);
+	}
+	fprintf(stderr, "\n");
+	return 1;
+}
 
 int main(int argc, char **argv)
 {
-	printf("Page = %d bytes, Page table size = %d bytes.\n",
-		MM_PAGE_SIZE_BYTES, MM_PAGE_TABLE_SIZE_BYTES);
-	printf("MM_MAX_PTE_SIZE_BYTES %d\n", MM_MAX_PTE_SIZE_BYTES);
-	printf("MM_MAX_PROCESSES %d\n", MM_MAX_PROCESSES);
-	printf("MM_PAGE_SIZE_BYTES %d\n", MM_PAGE_SIZE_BYTES);
-	printf("MM_PHYSICAL_MEMORY_SIZE_BYTES %d\n", MM_PHYSICAL_MEMORY_SIZE_BYTES);
-	printf("MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES %d\n", MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES);
-	printf("\n");
+	const char *convert_out = NULL;
+	const char *workload_spec = NULL;
+	const char *replay_path = NULL;
+	int format = -1;
+	int every;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "bc:g:r:F:s:p:f:v:l:n:P:")) != -1) {
+		switch (opt) {
+		case 'p':
+			if (parse_number(optarg, 16, &page_bits) != 0) {
+				return usage(argv[0]);
+			}
+			break;
+		case 'f':
+			if (parse_number(optarg, INT32_MAX, &frames) != 0) {
+				return usage(argv[0]);
+			}
+			break;
+		case 'v':
+			if (parse_number(optarg, 63, &vspace_bits) != 0) {
+				return usage(argv[0]);
+			}
+			break;
+		case 'l':
+			if (parse_number(optarg, 4, &levels) != 0) {
+				return usage(argv[0]);
+			}
+			break;
+		case 'n':
+			if (parse_number(optarg, 1 << 16, &max_pids) != 0) {
+				return usage(argv[0]);
+			}
+			break;
+		case 'P':
+			if (parse_policy(optarg) != 0) {
+				return usage(argv[0]);
+			}
+			break;
+		case 'b':
+			batch = 1;
+			break;
+		case 'c':
+			convert_out = optarg;
+			break;
+		case 'g':
+			workload_spec = optarg;
+			break;
+		case 'r':
+			replay_path = optarg;
+			break;
+		case 'F':
+			if (strcmp(optarg, "text") == 0) {
+				format = SUMMARY_TEXT;
+			} else if (strcmp(optarg, "json") == 0) {
+				format = SUMMARY_JSON;
+			} else if (strcmp(optarg, "csv") == 0) {
+				format = SUMMARY_CSV;
+			} else {
+				return usage(argv[0]);
+			}
+			break;
+		case 's':
+			if (parse_number(optarg, INT32_MAX, &every) != 0) {
+				return usage(argv[0]);
+			}
+			sample_every = (uint64_t)every;
+			break;
+		default:
+			return usage(argv[0]);
+		}
+	}
+
+	if (convert_out != NULL) {
+		return optind == argc - 1 ? convert_trace(argv[optind], convert_out) : usage(argv[0]);
+	}
+	if (workload_spec != NULL) {
+		return optind == argc - 1 ? generate_trace(workload_spec, argv[optind]) : usage(argv[0]);
+	}
+	if (replay_path != NULL) {
+		summary_format = format >= 0 ? (enum summary_format)format : SUMMARY_TEXT;
+		if (optind != argc) {
+			return usage(argv[0]);
+		}
+		return init_geometry() == 0 ? replay_trace(replay_path) : 1;
+	}
+	if (optind < argc - 1) {
+		return usage(argv[0]);
+	}
+	if (init_geometry() != 0) {
+		return 1;
+	}
+
+	// Asking for a summary or a sampled log means a batch run, which summarizes in JSON by default
+	batch |= format >= 0 || sample_every != 0;
+	summary_format = format >= 0 ? (enum summary_format)format : SUMMARY_JSON;
+
+	SAY("Page = %d bytes, %d page table level(s), policy %s.\n",
+		1 << config.page_size_bits, config.page_table_levels, policy_names[config.replacement_policy]);
+	SAY("Max processes %d\n", config.max_processes);
+	SAY("Physical memory size %llu bytes\n", (unsigned long long)config.physical_memory_size_bytes);
+	SAY("Process virtual memory size %llu bytes\n", 1ull << config.process_virtual_memory_size_shift);
+	SAY("\n");
 
 	FILE *input = NULL;
-	if (argc == 2) {
-		CHECK((input = fopen(argv[1], "r")) != NULL);
+	if (optind < argc) {
+		CHECK((input = fopen(argv[optind], "r")) != NULL);
 	}
 
+	struct run_counts counts;
+	memset(&counts, 0, sizeof(counts));
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// Lines are parsed the same way convert_trace() and replay parse them, so a trace runs the same
+	// whichever way it's fed in
+	char *line = NULL;
+	size_t linesz = 0;
+
 	while (1) {
-		ssize_t nread;
-		char linebuf[128];
-		char *line = linebuf;
-		size_t linesz = sizeof(linebuf) - 1;
-
-		int pid;
-		char *op;
-		uint32_t address;
+		struct trace_op op;
 		uint8_t value;
-		char *p;
-
 		int rc;
-		int scanned = 0;
 
-		printf("Instruction? ");
+		SAY("Instruction? ");
 
-		if ((nread = getline(&line, &linesz, input ? input : stdin)) < 0) {
+		if (getline(&line, &linesz, input ? input : stdin) < 0) {
 			break;
 		}
 
-		// Terrible parsing because sscanf is terrible.
-		while (nread > 0 && (line[nread - 1] == '\n' || line[nread - 1] == '\r')) {
-			line[nread-- - 1] = 0;
-		}
-		p = line;
-		for (char *c = line; ; c++) {
-			int done = *c == '\n' || *c == 0;
-			if (*c == ',' || done) {
-				*c = 0;
-				if ((scanned == 0 && (rc = sscanf(p, "%d", &pid)) == 1) ||
-					(scanned == 1 && (op = p)) ||
-					(scanned == 2 && (rc = sscanf(p, "%x", &address)) == 1) ||
-					(scanned == 3 && (rc = sscanf(p, "%hhu", &value)) == 1)) {
-					scanned++;
-					p = c+1;
-				}
-			}
-			if (done) break;
+		rc = trace_parse_line(line, &op);
+		if (rc == 1) {
+			continue;
 		}
-					
-
-		if (strcmp(line, "swap") == 0) {
-			printf("Swap enabled, backed by disk\n");
+		if (rc < 0) {
+			SAY("Invalid input\n");
+			counts.invalid++;
+		} else if (op.kind == TRACE_SWAP) {
+			SAY("Swap enabled, backed by disk\n");
 			MM_SwapOn();
-		} else if (scanned == 4) {
-			if (pid < 0 || pid >= MM_MAX_PROCESSES) {
-				printf("Invalid pid %d\n", pid);
-			} else if (strcmp(op, "map") == 0) {
-				struct MM_MapResult mr = MM_Map(pid, address, !!value);
-				if (mr.error) {
-					printf("Map failed\n");
-				} else if (mr.new_mapping) {
-					printf("Put page for PID %d virtual frame %u\n",
-							pid, address >> MM_PAGE_SIZE_BITS);
-				} else {
-					printf("Updating permissions for PID %d virtual page %u\n",
-							pid, address >> MM_PAGE_SIZE_BITS);
-				}
-				if (mr.message) {
-					printf("Map: %s\n", mr.message);
-				}
-			} else if (strcmp(op, "load") == 0) {
-				if ((rc = MM_LoadByte(pid, address, &value)) != 0) {
-					printf("load failed\n");
-				} else {
-					printf("Virtual address %x contains value %u\n", address, value);
-				}
-			} else if (strcmp(op, "store") == 0) {
-				if ((rc = MM_StoreByte(pid, address, value)) != 0) {
-					printf("store failed\n");
-				} else {
-					printf("Stored value %u at virtual address %x\n", value, address);
-				}
+			count_op(&counts, &op, 0);
+		} else if (op.pid >= config.max_processes) {
+			SAY("Invalid pid %d\n", op.pid);
+			counts.invalid++;
+		} else if (op.kind == TRACE_MAP) {
+			struct MM_MapResult mr = MM_Map(op.pid, op.address, !!op.value);
+			count_op(&counts, &op, mr.error);
+			if (mr.error) {
+				SAY("Map failed\n");
+			} else if (mr.new_mapping) {
+				SAY("Put page for PID %d virtual frame %llu\n",
+						op.pid, (unsigned long long)(op.address >> config.page_size_bits));
 			} else {
-				printf("Unknown operation: '%s'\n", op);
+				SAY("Updating permissions for PID %d virtual page %llu\n",
+						op.pid, (unsigned long long)(op.address >> config.page_size_bits));
+			}
+			if (mr.message) {
+				SAY("Map: %s\n", mr.message);
+			}
+		} else if (op.kind == TRACE_LOAD) {
+			rc = MM_LoadByte(op.pid, op.address, &value);
+			count_op(&counts, &op, rc);
+			if (rc != 0) {
+				SAY("load failed\n");
+			} else {
+				SAY("Virtual address %llx contains value %u\n", (unsigned long long)op.address, value);
 			}
 		} else {
-			printf("Invalid input\n");
+			rc = MM_StoreByte(op.pid, op.address, op.value);
+			count_op(&counts, &op, rc);
+			if (rc != 0) {
+				SAY("store failed\n");
+			} else {
+				SAY("Stored value %u at virtual address %llx\n", op.value, (unsigned long long)op.address);
+			}
 		}
 	}
 
+	free(line);
+
+	if (batch) {
+		print_summary(&counts, seconds_since(&start));
+	}
+
 	CHECK(input == NULL || fclose(input) == 0);
 	fflush(stdout);
 	fflush(stderr);
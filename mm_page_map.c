@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mm_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// A hash map keyed by page, shared by the replacement policies and swap.    //
+///////////////////////////////////////////////////////////////////////////////
+
+static size_t page_key_hash(struct page_key key) {
+	uint64_t h = (uint64_t)key.vpn * 0x9e3779b97f4a7c15ull;
+	h ^= ((uint64_t)(uint32_t)key.pid << 8 | (uint32_t)key.kind) * 0xc2b2ae3d27d4eb4full;
+	return (size_t)(h ^ (h >> 29));
+}
+
+static int page_key_equal(struct page_key a, struct page_key b) {
+	return a.pid == b.pid && a.kind == b.kind && a.vpn == b.vpn;
+}
+
+int page_map_init(struct page_map *map, size_t capacity) {
+	size_t slots = 16;
+	while(slots < capacity * 2)
+		slots *= 2;
+
+	map->slots = calloc(slots, sizeof(struct page_map_slot));
+	map->mask = slots - 1;
+	map->size = 0;
+
+	return map->slots == NULL ? -1 : 0;
+}
+
+void page_map_free(struct page_map *map) {
+	free(map->slots);
+	map->slots = NULL;
+}
+
+struct page_map_slot *page_map_find(struct page_map *map, struct page_key key) {
+	for(size_t i = page_key_hash(key) & map->mask; map->slots[i].used; i = (i + 1) & map->mask)
+		if(page_key_equal(map->slots[i].key, key))
+			return &map->slots[i];
+
+	return NULL;
+}
+
+// Doubles the number of slots once the map is half full, so probes stay short
+static int page_map_grow(struct page_map *map) {
+	struct page_map old = *map;
+
+	if(page_map_init(map, (old.mask + 1))) {
+		*map = old;
+		return -1;
+	}
+
+	for(size_t i = 0; i <= old.mask; i++)
+		if(old.slots[i].used)
+			page_map_put(map, old.slots[i].key, old.slots[i].value);
+
+	page_map_free(&old);
+
+	return 0;
+}
+
+int page_map_put(struct page_map *map, struct page_key key, int64_t value) {
+	struct page_map_slot *slot = page_map_find(map, key);
+
+	if(slot == NULL) {
+		if((map->size + 1) * 2 > map->mask + 1 && page_map_grow(map))
+			return -1;
+
+		size_t i = page_key_hash(key) & map->mask;
+		while(map->slots[i].used)
+			i = (i + 1) & map->mask;
+
+		slot = &map->slots[i];
+		slot->used = 1;
+		slot->key = key;
+		map->size++;
+	}
+
+	slot->value = value;
+
+	return 0;
+}
+
+// Removes a slot, shifting later entries of the same probe run back so lookups don't stop early
+void page_map_erase(struct page_map *map, struct page_map_slot *slot) {
+	size_t hole = slot - map->slots;
+	map->slots[hole].used = 0;
+	map->size--;
+
+	for(size_t i = (hole + 1) & map->mask; map->slots[i].used; i = (i + 1) & map->mask) {
+		size_t home = page_key_hash(map->slots[i].key) & map->mask;
+
+		// Entries whose home is cyclically in (hole, i] are still reachable where they are
+		int reachable = hole <= i ? (home > hole && home <= i) : (home > hole || home <= i);
+		if(reachable)
+			continue;
+
+		map->slots[hole] = map->slots[i];
+		map->slots[i].used = 0;
+		hole = i;
+	}
+}
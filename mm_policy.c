@@ -0,0 +1,1052 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mm_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Page replacement policies used by eject_phys_page().                      //
+///////////////////////////////////////////////////////////////////////////////
+
+// Bookkeeping for each frame. Each policy only uses the fields it needs
+struct frame_state {
+	int prev, next;		// Links for whichever list the policy keeps the frame on
+	int table_prev, table_next;	// Links for the list of page tables the engine keeps
+	uint8_t arc_list;	// Which of ARC's lists the frame is on
+	int heap_index;		// Position in the LFU or OPT heap
+	uint64_t last_access;	// Access clock at the last access (or when it was installed)
+	uint64_t count;		// How many times it's been accessed since it was installed
+	uint64_t next_use;	// When OPT expects it to be accessed next
+};
+
+// A doubly linked list threaded through frames[].prev/next. A frame is on at most one list
+struct frame_list {
+	int head, tail, size;
+};
+
+// ARC's ghosts remember pages that aren't resident anymore, so they live in their own pool
+struct arc_ghost {
+	struct page_key key;
+	int prev, next;
+	int list;
+};
+
+struct ghost_list {
+	int head, tail, size;
+};
+
+// One access in the reference string OPT was given
+struct oracle_entry {
+	int pid;
+	int64_t vpn;
+	uint64_t next_use;	// Position of the next access to the same page
+};
+
+// Everything the policies keep for one instance (see mm->policy)
+struct policy_state {
+	struct frame_state *frames;
+
+	// A bit per frame, laid out like the frame table's bitmaps. Set on every access, cleared by
+	// clock and second chance
+	uint64_t *referenced;
+	const struct replacement_policy *active;
+
+	// Ticks once per access, so LRU-ish policies can tell which frame was touched longest ago
+	uint64_t access_clock;
+
+	// Every resident page table, whatever the policy. Policies that only track data pages fall
+	// back on this once there's no data left to eject
+	int tables_head;
+	int tables_tail;
+
+	// Simple: each process' resident data pages, oldest first, and the processes that have data
+	// pages resident, in the order they got their first one. This way finding another process to
+	// take a page from never means looking at every process
+	struct frame_list *pid_frames;
+	int *owner_prev;
+	int *owner_next;
+	int owner_head;
+	int owner_tail;
+
+	// FIFO, second chance and LRU's queue, and clock's hand
+	struct frame_list queue;
+	int clock_hand;
+
+	// Approximate LRU's random number generator
+	uint64_t sample_state;
+
+	// The heap shared by LFU and OPT, frames popped off it while looking for one that can be
+	// ejected, and whether frame 'a' belongs closer to the top than frame 'b'
+	int *heap;
+	int heap_size;
+	int *heap_stash;
+	int (*heap_less)(int a, int b);
+
+	// ARC's lists, its pool of ghosts, and the adaptive target size for T1
+	struct frame_list arc_t1, arc_t2;
+	struct arc_ghost *ghosts;
+	int ghost_capacity;
+	int ghost_free;
+	struct ghost_list arc_b1, arc_b2;
+	struct page_map ghost_map;
+	int arc_p;
+
+	// OPT's reference string, and how far into it we are
+	struct oracle_entry *oracle;
+	size_t oracle_count;
+	size_t oracle_pos;
+};
+
+static void list_init(struct frame_list *list) {
+	list->head = -1;
+	list->tail = -1;
+	list->size = 0;
+}
+
+static void list_push_back(struct frame_list *list, int ppn) {
+	mm->policy->frames[ppn].prev = list->tail;
+	mm->policy->frames[ppn].next = -1;
+
+	if(list->tail != -1)
+		mm->policy->frames[list->tail].next = ppn;
+	else
+		list->head = ppn;
+
+	list->tail = ppn;
+	list->size++;
+}
+
+static void list_unlink(struct frame_list *list, int ppn) {
+	if(mm->policy->frames[ppn].prev != -1)
+		mm->policy->frames[mm->policy->frames[ppn].prev].next = mm->policy->frames[ppn].next;
+	else
+		list->head = mm->policy->frames[ppn].next;
+
+	if(mm->policy->frames[ppn].next != -1)
+		mm->policy->frames[mm->policy->frames[ppn].next].prev = mm->policy->frames[ppn].prev;
+	else
+		list->tail = mm->policy->frames[ppn].prev;
+
+	mm->policy->frames[ppn].prev = -1;
+	mm->policy->frames[ppn].next = -1;
+	list->size--;
+}
+
+// The frame closest to the front of the list that's allowed to be ejected
+static int list_first_evictable(struct frame_list *list) {
+	for(int ppn = list->head; ppn != -1; ppn = mm->policy->frames[ppn].next)
+		if(frame_is_evictable(ppn))
+			return ppn;
+
+	return -1;
+}
+
+static void tables_push_back(int ppn) {
+	mm->policy->frames[ppn].table_prev = mm->policy->tables_tail;
+	mm->policy->frames[ppn].table_next = -1;
+
+	if(mm->policy->tables_tail != -1)
+		mm->policy->frames[mm->policy->tables_tail].table_next = ppn;
+	else
+		mm->policy->tables_head = ppn;
+
+	mm->policy->tables_tail = ppn;
+}
+
+static void tables_unlink(int ppn) {
+	if(mm->policy->frames[ppn].table_prev != -1)
+		mm->policy->frames[mm->policy->frames[ppn].table_prev].table_next = mm->policy->frames[ppn].table_next;
+	else
+		mm->policy->tables_head = mm->policy->frames[ppn].table_next;
+
+	if(mm->policy->frames[ppn].table_next != -1)
+		mm->policy->frames[mm->policy->frames[ppn].table_next].table_prev = mm->policy->frames[ppn].table_prev;
+	else
+		mm->policy->tables_tail = mm->policy->frames[ppn].table_prev;
+
+	mm->policy->frames[ppn].table_prev = -1;
+	mm->policy->frames[ppn].table_next = -1;
+}
+
+// A page table with nothing resident under it, preferably from another process. When no data is
+// resident, the only tables with resident children are the ones above other tables, so this
+// doesn't have to look far
+static int first_evictable_table(int reserving_pid) {
+	int fallback = -1;
+
+	for(int ppn = mm->policy->tables_head; ppn != -1; ppn = mm->policy->frames[ppn].table_next) {
+		if(!frame_is_evictable(ppn))
+			continue;
+
+		if(mm->frames.pid[ppn] != reserving_pid)
+			return ppn;
+
+		if(fallback == -1)
+			fallback = ppn;
+	}
+
+	return fallback;
+}
+
+// Last resort for policies whose own bookkeeping only turned up frames that can't be ejected
+static int first_evictable_frame() {
+	for(int word = 0; word < mm->frames.num_words; word++) {
+		uint64_t evictable = frames_evictable(word);
+		if(evictable != 0)
+			return word * 64 + __builtin_ctzll(evictable);
+	}
+
+	return -1;
+}
+
+static struct page_key key_for_frame(int ppn) {
+	struct page_key key;
+	key.pid = mm->frames.pid[ppn];
+	key.kind = frame_test(mm->frames.page_table, ppn) ? mm->frames.level[ppn] + 1 : 0;
+	key.vpn = mm->frames.vpn[ppn];
+
+	return key;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Simple: the original heuristic. Data pages from other processes go first, //
+// then the reserving process' own, then page tables.                        //
+///////////////////////////////////////////////////////////////////////////////
+
+static int simple_init() {
+	mm->policy->pid_frames = calloc(mm->config.max_processes, sizeof(struct frame_list));
+	mm->policy->owner_prev = calloc(mm->config.max_processes, sizeof(int));
+	mm->policy->owner_next = calloc(mm->config.max_processes, sizeof(int));
+	mm->policy->owner_head = -1;
+	mm->policy->owner_tail = -1;
+
+	if(mm->policy->pid_frames == NULL || mm->policy->owner_prev == NULL || mm->policy->owner_next == NULL)
+		return -1;
+
+	for(int i = 0; i < mm->config.max_processes; i++)
+		list_init(&mm->policy->pid_frames[i]);
+
+	return 0;
+}
+
+static void simple_destroy() {
+	free(mm->policy->pid_frames);
+	free(mm->policy->owner_prev);
+	free(mm->policy->owner_next);
+	mm->policy->pid_frames = NULL;
+	mm->policy->owner_prev = NULL;
+	mm->policy->owner_next = NULL;
+}
+
+static void simple_insert(int ppn) {
+	if(frame_test(mm->frames.page_table, ppn))
+		return;
+
+	int pid = mm->frames.pid[ppn];
+
+	if(mm->policy->pid_frames[pid].size == 0) {
+		mm->policy->owner_prev[pid] = mm->policy->owner_tail;
+		mm->policy->owner_next[pid] = -1;
+
+		if(mm->policy->owner_tail != -1)
+			mm->policy->owner_next[mm->policy->owner_tail] = pid;
+		else
+			mm->policy->owner_head = pid;
+
+		mm->policy->owner_tail = pid;
+	}
+
+	list_push_back(&mm->policy->pid_frames[pid], ppn);
+}
+
+static void simple_remove(int ppn) {
+	if(frame_test(mm->frames.page_table, ppn))
+		return;
+
+	int pid = mm->frames.pid[ppn];
+	list_unlink(&mm->policy->pid_frames[pid], ppn);
+
+	if(mm->policy->pid_frames[pid].size == 0) {
+		if(mm->policy->owner_prev[pid] != -1)
+			mm->policy->owner_next[mm->policy->owner_prev[pid]] = mm->policy->owner_next[pid];
+		else
+			mm->policy->owner_head = mm->policy->owner_next[pid];
+
+		if(mm->policy->owner_next[pid] != -1)
+			mm->policy->owner_prev[mm->policy->owner_next[pid]] = mm->policy->owner_prev[pid];
+		else
+			mm->policy->owner_tail = mm->policy->owner_prev[pid];
+	}
+}
+
+static int simple_choose_victim(int reserving_pid) {
+	// An ideal candidate is a data page that isn't part of the current process
+	int owner = mm->policy->owner_head;
+	if(owner == reserving_pid)
+		owner = mm->policy->owner_next[owner];
+
+	if(owner != -1)
+		return mm->policy->pid_frames[owner].head;
+
+	// A good secondary candidate is a data page from the current process. The old scan settled on
+	// its last data frame, which is the one it brought in most recently, so that's kept here
+	if(mm->policy->pid_frames[reserving_pid].size > 0)
+		return mm->policy->pid_frames[reserving_pid].tail;
+
+	// If neither could be found (all pages in memory are full of page tables), then we pick a page
+	// table with nothing resident under it
+	return first_evictable_table(reserving_pid);
+}
+
+static const struct replacement_policy policy_simple = {
+	.name = "simple",
+	.init = simple_init,
+	.destroy = simple_destroy,
+	.insert = simple_insert,
+	.remove = simple_remove,
+	.choose_victim = simple_choose_victim,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// FIFO, second chance and LRU all keep frames on one queue.                 //
+///////////////////////////////////////////////////////////////////////////////
+
+static int queue_init() {
+	list_init(&mm->policy->queue);
+	return 0;
+}
+
+static void queue_insert(int ppn) {
+	list_push_back(&mm->policy->queue, ppn);
+}
+
+static void queue_remove(int ppn) {
+	list_unlink(&mm->policy->queue, ppn);
+}
+
+static int queue_choose_victim(int reserving_pid) {
+	return list_first_evictable(&mm->policy->queue);
+}
+
+// LRU moves a frame to the back of the queue every time it's used
+static void lru_access(int ppn) {
+	list_unlink(&mm->policy->queue, ppn);
+	list_push_back(&mm->policy->queue, ppn);
+}
+
+// Second chance gives referenced frames at the front another trip through the queue
+static int second_chance_choose_victim(int reserving_pid) {
+	for(int steps = 0; steps <= 2 * mm->policy->queue.size && mm->policy->queue.head != -1; steps++) {
+		int ppn = mm->policy->queue.head;
+
+		if(frame_is_evictable(ppn) && !frame_test(mm->policy->referenced, ppn))
+			return ppn;
+
+		frame_clear(mm->policy->referenced, ppn);
+		list_unlink(&mm->policy->queue, ppn);
+		list_push_back(&mm->policy->queue, ppn);
+	}
+
+	return list_first_evictable(&mm->policy->queue);
+}
+
+static const struct replacement_policy policy_fifo = {
+	.name = "fifo",
+	.init = queue_init,
+	.insert = queue_insert,
+	.remove = queue_remove,
+	.choose_victim = queue_choose_victim,
+};
+
+static const struct replacement_policy policy_second_chance = {
+	.name = "second-chance",
+	.init = queue_init,
+	.insert = queue_insert,
+	.remove = queue_remove,
+	.choose_victim = second_chance_choose_victim,
+};
+
+static const struct replacement_policy policy_lru = {
+	.name = "lru",
+	.init = queue_init,
+	.insert = queue_insert,
+	.access = lru_access,
+	.remove = queue_remove,
+	.choose_victim = queue_choose_victim,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Clock: a hand sweeping over the frames in physical order.                 //
+///////////////////////////////////////////////////////////////////////////////
+
+static int clock_init() {
+	mm->policy->clock_hand = 0;
+	return 0;
+}
+
+// The hand moves a bitmap word at a time, which picks the same frame as moving it one frame at a
+// time would: the first evictable frame that wasn't referenced, after clearing the referenced bits
+// of the evictable frames it passes on the way
+static int clock_choose_victim(int reserving_pid) {
+	// Two full sweeps are enough to clear every referenced bit and come back around
+	for(int steps = 0; steps < 2 * mm->num_phys_pages;) {
+		int ppn = mm->policy->clock_hand;
+		int bit = ppn & 63;
+		int span = 64 - bit < mm->num_phys_pages - ppn ? 64 - bit : mm->num_phys_pages - ppn;
+
+		// The frames from the hand to the end of its word (or of the frames)
+		uint64_t ahead = (span == 64 ? ~(uint64_t)0 : ((uint64_t)1 << span) - 1) << bit;
+		uint64_t evictable = frames_evictable(ppn >> 6) & ahead;
+		uint64_t *referenced = &mm->policy->referenced[ppn >> 6];
+		uint64_t victims = evictable & ~*referenced;
+
+		if(victims != 0) {
+			int victim_bit = __builtin_ctzll(victims);
+			*referenced &= ~(evictable & (((uint64_t)1 << victim_bit) - 1));
+			mm->policy->clock_hand = (ppn - bit + victim_bit + 1) % mm->num_phys_pages;
+			return ppn - bit + victim_bit;
+		}
+
+		*referenced &= ~evictable;
+		mm->policy->clock_hand = (ppn + span) % mm->num_phys_pages;
+		steps += span;
+	}
+
+	return first_evictable_frame();
+}
+
+static const struct replacement_policy policy_clock = {
+	.name = "clock",
+	.init = clock_init,
+	.choose_victim = clock_choose_victim,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Approximate LRU: the oldest of a few randomly sampled frames.             //
+///////////////////////////////////////////////////////////////////////////////
+
+#define LRU_APPROX_SAMPLES	8
+
+static uint64_t sample_next() {
+	mm->policy->sample_state ^= mm->policy->sample_state << 13;
+	mm->policy->sample_state ^= mm->policy->sample_state >> 7;
+	mm->policy->sample_state ^= mm->policy->sample_state << 17;
+	return mm->policy->sample_state;
+}
+
+static int lru_approx_choose_victim(int reserving_pid) {
+	int best = -1;
+	int sampled = 0;
+
+	// Frames that can't be ejected don't count towards the sample, but give up eventually
+	for(int tries = 0; tries < 4 * LRU_APPROX_SAMPLES && sampled < LRU_APPROX_SAMPLES; tries++) {
+		int ppn = (int)(sample_next() % (uint64_t)mm->num_phys_pages);
+
+		if(!frame_is_evictable(ppn))
+			continue;
+
+		sampled++;
+		if(best == -1 || mm->policy->frames[ppn].last_access < mm->policy->frames[best].last_access)
+			best = ppn;
+	}
+
+	return best != -1 ? best : first_evictable_frame();
+}
+
+static const struct replacement_policy policy_lru_approx = {
+	.name = "lru-approx",
+	.choose_victim = lru_approx_choose_victim,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// A binary heap of frames, shared by LFU and OPT.                           //
+///////////////////////////////////////////////////////////////////////////////
+
+static void heap_place(int i, int ppn) {
+	mm->policy->heap[i] = ppn;
+	mm->policy->frames[ppn].heap_index = i;
+}
+
+static void heap_sift_up(int i) {
+	int ppn = mm->policy->heap[i];
+
+	while(i > 0 && mm->policy->heap_less(ppn, mm->policy->heap[(i - 1) / 2])) {
+		heap_place(i, mm->policy->heap[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+
+	heap_place(i, ppn);
+}
+
+static void heap_sift_down(int i) {
+	int ppn = mm->policy->heap[i];
+
+	while(2 * i + 1 < mm->policy->heap_size) {
+		int child = 2 * i + 1;
+		if(child + 1 < mm->policy->heap_size && mm->policy->heap_less(mm->policy->heap[child + 1], mm->policy->heap[child]))
+			child++;
+
+		if(!mm->policy->heap_less(mm->policy->heap[child], ppn))
+			break;
+
+		heap_place(i, mm->policy->heap[child]);
+		i = child;
+	}
+
+	heap_place(i, ppn);
+}
+
+static int heap_init(int (*less)(int a, int b)) {
+	mm->policy->heap = calloc(mm->num_phys_pages, sizeof(int));
+	mm->policy->heap_stash = calloc(mm->num_phys_pages, sizeof(int));
+	mm->policy->heap_size = 0;
+	mm->policy->heap_less = less;
+
+	return mm->policy->heap == NULL || mm->policy->heap_stash == NULL ? -1 : 0;
+}
+
+static void heap_destroy() {
+	free(mm->policy->heap);
+	free(mm->policy->heap_stash);
+	mm->policy->heap = NULL;
+	mm->policy->heap_stash = NULL;
+}
+
+static void heap_push(int ppn) {
+	heap_place(mm->policy->heap_size++, ppn);
+	heap_sift_up(mm->policy->heap_size - 1);
+}
+
+static void heap_erase(int ppn) {
+	int i = mm->policy->frames[ppn].heap_index;
+	int last = mm->policy->heap[--mm->policy->heap_size];
+	mm->policy->frames[ppn].heap_index = -1;
+
+	if(i == mm->policy->heap_size)
+		return;
+
+	heap_place(i, last);
+	heap_sift_up(i);
+	heap_sift_down(mm->policy->frames[last].heap_index);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LFU: a min-heap ordered by access count, then by last access.             //
+///////////////////////////////////////////////////////////////////////////////
+
+static int lfu_less(int a, int b) {
+	if(mm->policy->frames[a].count != mm->policy->frames[b].count)
+		return mm->policy->frames[a].count < mm->policy->frames[b].count;
+
+	return mm->policy->frames[a].last_access < mm->policy->frames[b].last_access;
+}
+
+static int lfu_init() {
+	return heap_init(lfu_less);
+}
+
+static void lfu_access(int ppn) {
+	// The count only ever goes up, so the frame can only move down
+	mm->policy->frames[ppn].count++;
+	heap_sift_down(mm->policy->frames[ppn].heap_index);
+}
+
+static int lfu_choose_victim(int reserving_pid) {
+	int victim = -1;
+	int stashed = 0;
+
+	// Page tables with resident children can sit at the top of the heap, so they're set aside
+	// until something that can be ejected turns up
+	while(mm->policy->heap_size > 0) {
+		int ppn = mm->policy->heap[0];
+
+		if(frame_is_evictable(ppn)) {
+			victim = ppn;
+			break;
+		}
+
+		heap_erase(ppn);
+		mm->policy->heap_stash[stashed++] = ppn;
+	}
+
+	for(int i = 0; i < stashed; i++)
+		heap_push(mm->policy->heap_stash[i]);
+
+	return victim;
+}
+
+static const struct replacement_policy policy_lfu = {
+	.name = "lfu",
+	.init = lfu_init,
+	.destroy = heap_destroy,
+	.insert = heap_push,
+	.access = lfu_access,
+	.remove = heap_erase,
+	.choose_victim = lfu_choose_victim,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// ARC (Megiddo & Modha): recency (T1) and frequency (T2) lists of resident  //
+// frames, plus ghost lists (B1, B2) of recently ejected pages that steer    //
+// the target size of T1.                                                    //
+///////////////////////////////////////////////////////////////////////////////
+
+enum { ARC_T1 = 1, ARC_T2, ARC_B1, ARC_B2 };
+
+static int arc_init() {
+	list_init(&mm->policy->arc_t1);
+	list_init(&mm->policy->arc_t2);
+	mm->policy->arc_b1 = (struct ghost_list){ -1, -1, 0 };
+	mm->policy->arc_b2 = (struct ghost_list){ -1, -1, 0 };
+	mm->policy->arc_p = 0;
+
+	// There are never more than 2c ghosts once the lists are trimmed, plus one being added
+	mm->policy->ghost_capacity = 2 * mm->num_phys_pages + 1;
+	mm->policy->ghosts = calloc(mm->policy->ghost_capacity, sizeof(struct arc_ghost));
+	if(mm->policy->ghosts == NULL || page_map_init(&mm->policy->ghost_map, mm->policy->ghost_capacity))
+		return -1;
+
+	mm->policy->ghost_free = 0;
+	for(int i = 0; i < mm->policy->ghost_capacity; i++)
+		mm->policy->ghosts[i].next = i + 1 < mm->policy->ghost_capacity ? i + 1 : -1;
+
+	return 0;
+}
+
+static void arc_destroy() {
+	free(mm->policy->ghosts);
+	mm->policy->ghosts = NULL;
+	page_map_free(&mm->policy->ghost_map);
+}
+
+static void ghost_unlink(struct ghost_list *list, int g) {
+	if(mm->policy->ghosts[g].prev != -1)
+		mm->policy->ghosts[mm->policy->ghosts[g].prev].next = mm->policy->ghosts[g].next;
+	else
+		list->head = mm->policy->ghosts[g].next;
+
+	if(mm->policy->ghosts[g].next != -1)
+		mm->policy->ghosts[mm->policy->ghosts[g].next].prev = mm->policy->ghosts[g].prev;
+	else
+		list->tail = mm->policy->ghosts[g].prev;
+
+	list->size--;
+}
+
+// Forgets a ghost completely
+static void ghost_drop(int g) {
+	ghost_unlink(mm->policy->ghosts[g].list == ARC_B1 ? &mm->policy->arc_b1 : &mm->policy->arc_b2, g);
+	page_map_erase(&mm->policy->ghost_map, page_map_find(&mm->policy->ghost_map, mm->policy->ghosts[g].key));
+
+	mm->policy->ghosts[g].next = mm->policy->ghost_free;
+	mm->policy->ghost_free = g;
+}
+
+static void ghost_add(int list_id, struct page_key key) {
+	struct ghost_list *list = list_id == ARC_B1 ? &mm->policy->arc_b1 : &mm->policy->arc_b2;
+	int g = mm->policy->ghost_free;
+	mm->policy->ghost_free = mm->policy->ghosts[g].next;
+
+	mm->policy->ghosts[g].key = key;
+	mm->policy->ghosts[g].list = list_id;
+	mm->policy->ghosts[g].next = -1;
+	mm->policy->ghosts[g].prev = list->tail;
+
+	if(list->tail != -1)
+		mm->policy->ghosts[list->tail].next = g;
+	else
+		list->head = g;
+
+	list->tail = g;
+	list->size++;
+
+	page_map_put(&mm->policy->ghost_map, key, g);
+}
+
+static void arc_insert(int ppn) {
+	struct page_map_slot *slot = page_map_find(&mm->policy->ghost_map, key_for_frame(ppn));
+
+	if(slot == NULL) {
+		// Never seen recently, so it starts out on the recency side
+		list_push_back(&mm->policy->arc_t1, ppn);
+		mm->policy->frames[ppn].arc_list = ARC_T1;
+		return;
+	}
+
+	// A ghost hit means we ejected the page too early, so the side it was ejected from grows
+	int g = (int)slot->value;
+	if(mm->policy->ghosts[g].list == ARC_B1) {
+		int delta = mm->policy->arc_b2.size > mm->policy->arc_b1.size ? mm->policy->arc_b2.size / mm->policy->arc_b1.size : 1;
+		mm->policy->arc_p = mm->policy->arc_p + delta < mm->num_phys_pages ? mm->policy->arc_p + delta : mm->num_phys_pages;
+	} else {
+		int delta = mm->policy->arc_b1.size > mm->policy->arc_b2.size ? mm->policy->arc_b1.size / mm->policy->arc_b2.size : 1;
+		mm->policy->arc_p = mm->policy->arc_p > delta ? mm->policy->arc_p - delta : 0;
+	}
+
+	ghost_drop(g);
+	list_push_back(&mm->policy->arc_t2, ppn);
+	mm->policy->frames[ppn].arc_list = ARC_T2;
+}
+
+static void arc_access(int ppn) {
+	// Anything used more than once is frequent
+	list_unlink(mm->policy->frames[ppn].arc_list == ARC_T1 ? &mm->policy->arc_t1 : &mm->policy->arc_t2, ppn);
+	list_push_back(&mm->policy->arc_t2, ppn);
+	mm->policy->frames[ppn].arc_list = ARC_T2;
+}
+
+static void arc_remove(int ppn) {
+	int from_t1 = mm->policy->frames[ppn].arc_list == ARC_T1;
+	list_unlink(from_t1 ? &mm->policy->arc_t1 : &mm->policy->arc_t2, ppn);
+	ghost_add(from_t1 ? ARC_B1 : ARC_B2, key_for_frame(ppn));
+
+	// Keep |T1| + |B1| <= c and the whole directory <= 2c
+	while(mm->policy->arc_t1.size + mm->policy->arc_b1.size > mm->num_phys_pages && mm->policy->arc_b1.size > 0)
+		ghost_drop(mm->policy->arc_b1.head);
+
+	while(mm->policy->arc_t1.size + mm->policy->arc_t2.size + mm->policy->arc_b1.size + mm->policy->arc_b2.size > 2 * mm->num_phys_pages)
+		ghost_drop(mm->policy->arc_b2.size > 0 ? mm->policy->arc_b2.head : mm->policy->arc_b1.head);
+}
+
+static int arc_choose_victim(int reserving_pid) {
+	int from_t1 = mm->policy->arc_t1.size > 0 && (mm->policy->arc_t1.size > mm->policy->arc_p || mm->policy->arc_t2.size == 0);
+
+	int ppn = list_first_evictable(from_t1 ? &mm->policy->arc_t1 : &mm->policy->arc_t2);
+	if(ppn == -1)
+		ppn = list_first_evictable(from_t1 ? &mm->policy->arc_t2 : &mm->policy->arc_t1);
+
+	return ppn;
+}
+
+static const struct replacement_policy policy_arc = {
+	.name = "arc",
+	.init = arc_init,
+	.destroy = arc_destroy,
+	.insert = arc_insert,
+	.access = arc_access,
+	.remove = arc_remove,
+	.choose_victim = arc_choose_victim,
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// OPT: evict whichever page the oracle says is used furthest in the future. //
+///////////////////////////////////////////////////////////////////////////////
+
+#define OPT_NEVER		UINT64_MAX
+
+// How far ahead to look for the current access when it doesn't line up with the oracle (say,
+// because a call in the reference string failed and never counted as an access)
+#define OPT_RESYNC_WINDOW	16
+
+// A max-heap by next use. Page tables aren't in the reference string, so only data pages go in it
+static int opt_later(int a, int b) {
+	return mm->policy->frames[a].next_use > mm->policy->frames[b].next_use;
+}
+
+static int opt_init() {
+	return heap_init(opt_later);
+}
+
+static void opt_insert(int ppn) {
+	mm->policy->frames[ppn].next_use = OPT_NEVER;
+	mm->policy->frames[ppn].heap_index = -1;
+
+	if(!frame_test(mm->frames.page_table, ppn))
+		heap_push(ppn);
+}
+
+static void opt_remove(int ppn) {
+	if(mm->policy->frames[ppn].heap_index != -1)
+		heap_erase(ppn);
+}
+
+// The next use can move either way, so the frame is sifted in both directions
+static void opt_update(int ppn) {
+	heap_sift_up(mm->policy->frames[ppn].heap_index);
+	heap_sift_down(mm->policy->frames[ppn].heap_index);
+}
+
+static void opt_access(int ppn) {
+	mm->policy->frames[ppn].next_use = OPT_NEVER;
+
+	for(size_t i = mm->policy->oracle_pos; i < mm->policy->oracle_count && i < mm->policy->oracle_pos + OPT_RESYNC_WINDOW; i++) {
+		if(mm->policy->oracle[i].pid == mm->frames.pid[ppn] && mm->policy->oracle[i].vpn == mm->frames.vpn[ppn]) {
+			mm->policy->frames[ppn].next_use = mm->policy->oracle[i].next_use;
+			mm->policy->oracle_pos = i + 1;
+			break;
+		}
+	}
+
+	opt_update(ppn);
+}
+
+static int opt_choose_victim(int reserving_pid) {
+	// Page tables are only given up when there's no data page left to give
+	if(mm->policy->heap_size > 0)
+		return mm->policy->heap[0];
+
+	return first_evictable_table(reserving_pid);
+}
+
+static const struct replacement_policy policy_opt = {
+	.name = "opt",
+	.init = opt_init,
+	.destroy = heap_destroy,
+	.insert = opt_insert,
+	.access = opt_access,
+	.remove = opt_remove,
+	.choose_victim = opt_choose_victim,
+};
+
+// MM_SetOracle(), once mm->lock is held
+static int set_oracle(const struct MM_Access *future, size_t count) {
+	struct oracle_entry *entries = calloc(count + 1, sizeof(struct oracle_entry));
+	struct page_map last_seen;
+	if(entries == NULL || page_map_init(&last_seen, 1024)) {
+		free(entries);
+		return -1;
+	}
+
+	// Walking backwards, the last time we saw a page is the next time it'll be used
+	for(size_t i = count; i-- > 0; ) {
+		struct page_key key = { future[i].pid, 0, (int64_t)(future[i].address >> mm->config.page_size_bits) };
+		struct page_map_slot *slot = page_map_find(&last_seen, key);
+
+		entries[i].pid = key.pid;
+		entries[i].vpn = key.vpn;
+		entries[i].next_use = slot != NULL ? (uint64_t)slot->value : OPT_NEVER;
+
+		if(page_map_put(&last_seen, key, (int64_t)i)) {
+			page_map_free(&last_seen);
+			free(entries);
+			return -1;
+		}
+	}
+
+	page_map_free(&last_seen);
+
+	free(mm->policy->oracle);
+	mm->policy->oracle = entries;
+	mm->policy->oracle_count = count;
+	mm->policy->oracle_pos = 0;
+
+	return 0;
+}
+
+int MM_SetOracle_ex(struct MM_Instance *instance, const struct MM_Access *future, size_t count) {
+	mm = instance;
+
+	if(ensure_init())
+		return -1;
+
+	pthread_rwlock_wrlock(&mm->lock);
+	int ret = set_oracle(future, count);
+	pthread_rwlock_unlock(&mm->lock);
+
+	return ret;
+}
+
+int MM_SetOracle(const struct MM_Access *future, size_t count) {
+	return MM_SetOracle_ex(&default_instance, future, count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// The engine that mm_api.c talks to.                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+static const struct replacement_policy *const policies[] = {
+	[MM_POLICY_SIMPLE] = &policy_simple,
+	[MM_POLICY_FIFO] = &policy_fifo,
+	[MM_POLICY_CLOCK] = &policy_clock,
+	[MM_POLICY_SECOND_CHANCE] = &policy_second_chance,
+	[MM_POLICY_LRU] = &policy_lru,
+	[MM_POLICY_LRU_APPROX] = &policy_lru_approx,
+	[MM_POLICY_LFU] = &policy_lfu,
+	[MM_POLICY_ARC] = &policy_arc,
+	[MM_POLICY_OPT] = &policy_opt,
+};
+
+// Tears down the active policy, but leaves the oracle alone
+static void policy_stop() {
+	if(mm->policy->active != NULL && mm->policy->active->destroy != NULL)
+		mm->policy->active->destroy();
+
+	free(mm->policy->frames);
+	free(mm->policy->referenced);
+	mm->policy->frames = NULL;
+	mm->policy->referenced = NULL;
+	mm->policy->active = NULL;
+}
+
+static int policy_start(enum MM_ReplacementPolicy policy) {
+	if((unsigned)policy >= sizeof(policies) / sizeof(policies[0])) {
+		DEBUG("unknown replacement policy %d\n", (int)policy);
+		return -1;
+	}
+
+	// The state is set up the first time a policy starts, and lives until policy_destroy()
+	if(mm->policy == NULL) {
+		mm->policy = calloc(1, sizeof(struct policy_state));
+		if(mm->policy == NULL)
+			return -1;
+
+		// A fixed seed keeps runs reproducible
+		mm->policy->sample_state = 0x2545f4914f6cdd1dull;
+	}
+
+	policy_stop();
+
+	mm->policy->frames = calloc(mm->num_phys_pages, sizeof(struct frame_state));
+	mm->policy->referenced = calloc(mm->frames.num_words, sizeof(uint64_t));
+	if(mm->policy->frames == NULL || mm->policy->referenced == NULL)
+		return -1;
+
+	for(int i = 0; i < mm->num_phys_pages; i++) {
+		mm->policy->frames[i].prev = -1;
+		mm->policy->frames[i].next = -1;
+		mm->policy->frames[i].table_prev = -1;
+		mm->policy->frames[i].table_next = -1;
+	}
+
+	mm->policy->tables_head = -1;
+	mm->policy->tables_tail = -1;
+
+	mm->policy->active = policies[policy];
+	if(mm->policy->active->init != NULL && mm->policy->active->init()) {
+		DEBUG("unable to set up %s replacement policy\n", mm->policy->active->name);
+		policy_stop();
+		return -1;
+	}
+
+	return 0;
+}
+
+int policy_init(enum MM_ReplacementPolicy policy) {
+	pthread_mutex_lock(&mm->policy_lock);
+	int ret = policy_start(policy);
+	pthread_mutex_unlock(&mm->policy_lock);
+
+	return ret;
+}
+
+void policy_destroy() {
+	pthread_mutex_lock(&mm->policy_lock);
+	if(mm->policy != NULL) {
+		policy_stop();
+		free(mm->policy->oracle);
+		free(mm->policy);
+		mm->policy = NULL;
+	}
+	pthread_mutex_unlock(&mm->policy_lock);
+}
+
+// policy_insert(), once policy_lock is held
+static void insert_frame(int ppn) {
+	frame_clear(mm->policy->referenced, ppn);
+	mm->policy->frames[ppn].count = 0;
+	mm->policy->frames[ppn].last_access = mm->policy->access_clock;
+
+	if(frame_test(mm->frames.page_table, ppn))
+		tables_push_back(ppn);
+
+	if(mm->policy->active->insert != NULL)
+		mm->policy->active->insert(ppn);
+}
+
+void policy_insert(int ppn) {
+	pthread_mutex_lock(&mm->policy_lock);
+	insert_frame(ppn);
+	pthread_mutex_unlock(&mm->policy_lock);
+}
+
+static void record_access(int ppn) {
+	frame_set(mm->policy->referenced, ppn);
+	mm->policy->frames[ppn].last_access = ++mm->policy->access_clock;
+
+	if(mm->policy->active->access != NULL)
+		mm->policy->active->access(ppn);
+}
+
+void policy_access(int ppn) {
+	pthread_mutex_lock(&mm->policy_lock);
+	record_access(ppn);
+	pthread_mutex_unlock(&mm->policy_lock);
+}
+
+void policy_try_access(int ppn, const uint32_t *seq, uint32_t expected) {
+	if(pthread_mutex_trylock(&mm->policy_lock))
+		return;
+
+	// The frame can only leave the policy with this lock held, so if it hasn't started changing
+	// by now it's still safe to touch
+	if(__atomic_load_n(seq, __ATOMIC_ACQUIRE) == expected)
+		record_access(ppn);
+	pthread_mutex_unlock(&mm->policy_lock);
+}
+
+void policy_remove(int ppn) {
+	pthread_mutex_lock(&mm->policy_lock);
+	if(frame_test(mm->frames.page_table, ppn))
+		tables_unlink(ppn);
+
+	if(mm->policy->active->remove != NULL)
+		mm->policy->active->remove(ppn);
+	pthread_mutex_unlock(&mm->policy_lock);
+}
+
+int policy_choose_victim(int reserving_pid) {
+	pthread_mutex_lock(&mm->policy_lock);
+	int ppn = mm->policy->active->choose_victim(reserving_pid);
+
+	// Some policies take any data page without asking, which could be one that's held in place
+	if(ppn != -1 && !frame_is_evictable(ppn))
+		ppn = first_evictable_frame();
+	pthread_mutex_unlock(&mm->policy_lock);
+
+	return ppn;
+}
+
+uint64_t policy_idle_time(int ppn) {
+	pthread_mutex_lock(&mm->policy_lock);
+	uint64_t idle = mm->policy->access_clock - mm->policy->frames[ppn].last_access;
+	pthread_mutex_unlock(&mm->policy_lock);
+
+	return idle;
+}
+
+int MM_SetReplacementPolicy_ex(struct MM_Instance *instance, enum MM_ReplacementPolicy policy) {
+	mm = instance;
+
+	if(ensure_init())
+		return -1;
+
+	pthread_rwlock_wrlock(&mm->lock);
+
+	// Lock-free loads don't take mm->lock, so policy_lock is held until every resident frame is
+	// back in. Otherwise one could record an access to a frame the new policy doesn't have yet
+	pthread_mutex_lock(&mm->policy_lock);
+
+	int ret = 0;
+
+	if(policy_start(policy)) {
+		// Don't leave things without a policy
+		CHECK(policy_start(mm->config.replacement_policy) == 0);
+		ret = -1;
+	} else {
+		mm->config.replacement_policy = policy;
+	}
+
+	// Either way, the policy starts out knowing nothing about what's resident
+	for(int i = 0; i < mm->num_phys_pages; i++)
+		if(frame_test(mm->frames.valid, i))
+			insert_frame(i);
+
+	pthread_mutex_unlock(&mm->policy_lock);
+	pthread_rwlock_unlock(&mm->lock);
+
+	return ret;
+}
+
+int MM_SetReplacementPolicy(enum MM_ReplacementPolicy policy) {
+	return MM_SetReplacementPolicy_ex(&default_instance, policy);
+}
@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mm_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Statistics: per-thread counters and latency histograms.                  //
+///////////////////////////////////////////////////////////////////////////////
+
+#define SUB_BUCKETS	(1 << MM_HISTOGRAM_SUB_BITS)
+
+__thread int stat_shard_index = -1;
+
+// Handed out round robin, so the first STAT_SHARDS threads each get a shard to themselves
+static int next_shard;
+
+// The thread that writes MM_GetStats() out every stats_dump_interval_ms
+struct stats_dumper {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	int stopping;
+	FILE *file;
+	struct timespec start;
+};
+
+int stat_shard_assign() {
+	return __atomic_fetch_add(&next_shard, 1, __ATOMIC_RELAXED) % STAT_SHARDS;
+}
+
+uint64_t stat_now_ns() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+// Values under SUB_BUCKETS get a bucket each. Past that, the top bit picks a group of SUB_BUCKETS
+// buckets and the next MM_HISTOGRAM_SUB_BITS bits pick the bucket within it
+static int histogram_bucket(uint64_t ns) {
+	if(ns < SUB_BUCKETS)
+		return (int)ns;
+
+	int top = 63 - __builtin_clzll(ns);
+	if(top >= MM_HISTOGRAM_MAX_BITS)
+		return MM_HISTOGRAM_BUCKETS - 1;
+
+	int shift = top - MM_HISTOGRAM_SUB_BITS;
+	return ((shift + 1) << MM_HISTOGRAM_SUB_BITS) + (int)((ns >> shift) & (SUB_BUCKETS - 1));
+}
+
+// The largest value that lands in 'bucket'
+static uint64_t histogram_bucket_top(int bucket) {
+	if(bucket < SUB_BUCKETS)
+		return (uint64_t)bucket;
+
+	int shift = (bucket >> MM_HISTOGRAM_SUB_BITS) - 1;
+	uint64_t bottom = (uint64_t)(SUB_BUCKETS + (bucket & (SUB_BUCKETS - 1))) << shift;
+	return bottom + ((uint64_t)1 << shift) - 1;
+}
+
+void stat_record(enum stat_histogram histogram, uint64_t ns) {
+	if(stat_shard_index < 0)
+		stat_shard_index = stat_shard_assign();
+
+	struct MM_Histogram *h = &mm->stat_shards[stat_shard_index].histograms[histogram];
+	__atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&h->total_ns, ns, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&h->buckets[histogram_bucket(ns)], 1, __ATOMIC_RELAXED);
+}
+
+uint64_t MM_HistogramPercentile(const struct MM_Histogram *histogram, double percentile) {
+	if(histogram->count == 0)
+		return 0;
+
+	// The rank of the value we're after, counting from 1
+	uint64_t rank = (uint64_t)(percentile / 100.0 * (double)histogram->count + 0.999999);
+	if(rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for(int i = 0; i < MM_HISTOGRAM_BUCKETS; i++) {
+		seen += histogram->buckets[i];
+		if(seen >= rank)
+			return histogram_bucket_top(i);
+	}
+
+	return histogram_bucket_top(MM_HISTOGRAM_BUCKETS - 1);
+}
+
+static void add_histogram(struct MM_Histogram *sum, const struct MM_Histogram *h) {
+	sum->count += __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+	sum->total_ns += __atomic_load_n(&h->total_ns, __ATOMIC_RELAXED);
+	for(int i = 0; i < MM_HISTOGRAM_BUCKETS; i++)
+		sum->buckets[i] += __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+}
+
+// Adds up every shard. Counting doesn't stop while this runs, so the counts are each exact as of
+// some moment during the call, not necessarily all the same one
+static void collect_stats(struct MM_Stats *stats) {
+	memset(stats, 0, sizeof(*stats));
+	if(mm->stat_shards == NULL)
+		return;
+
+	uint64_t counters[NUM_STAT_COUNTERS] = {0};
+	for(int i = 0; i < STAT_SHARDS; i++) {
+		for(int c = 0; c < NUM_STAT_COUNTERS; c++)
+			counters[c] += __atomic_load_n(&mm->stat_shards[i].counters[c], __ATOMIC_RELAXED);
+
+		add_histogram(&stats->page_in, &mm->stat_shards[i].histograms[STAT_PAGE_IN]);
+		add_histogram(&stats->page_out, &mm->stat_shards[i].histograms[STAT_PAGE_OUT]);
+	}
+
+	stats->tlb_hits = counters[STAT_TLB_HITS];
+	stats->translations = counters[STAT_TLB_HITS] + counters[STAT_TLB_MISSES];
+	stats->minor_faults = counters[STAT_MINOR_FAULTS];
+	stats->major_faults = counters[STAT_MAJOR_FAULTS];
+	stats->faults = stats->minor_faults + stats->major_faults;
+	stats->evictions_data = counters[STAT_EVICTIONS_DATA];
+	stats->evictions_page_table = counters[STAT_EVICTIONS_PAGE_TABLE];
+	stats->evictions = stats->evictions_data + stats->evictions_page_table;
+	stats->evictions_same_pid = counters[STAT_EVICTIONS_SAME_PID];
+	stats->evictions_other_pid = counters[STAT_EVICTIONS_OTHER_PID];
+	stats->writebacks = counters[STAT_WRITEBACKS];
+	stats->swap_bytes_read = counters[STAT_SWAP_BYTES_READ];
+	stats->swap_bytes_written = counters[STAT_SWAP_BYTES_WRITTEN];
+}
+
+// MM_GetStats() doesn't take the instance's lock, so it's cheap enough to call while other threads
+// are busy with the instance
+void MM_GetStats_ex(struct MM_Instance *instance, struct MM_Stats *stats) {
+	mm = instance;
+
+	if(ensure_init()) {
+		memset(stats, 0, sizeof(*stats));
+		return;
+	}
+
+	collect_stats(stats);
+}
+
+void MM_GetStats(struct MM_Stats *stats) {
+	MM_GetStats_ex(&default_instance, stats);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Periodic dumps.                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+static void dump_histogram(FILE *file, const char *name, const struct MM_Histogram *h) {
+	fprintf(file, ", \"%s_count\": %llu, \"%s_mean_ns\": %llu, \"%s_p50_ns\": %llu, \"%s_p99_ns\": %llu, \"%s_max_ns\": %llu",
+		name, (unsigned long long)h->count,
+		name, (unsigned long long)(h->count > 0 ? h->total_ns / h->count : 0),
+		name, (unsigned long long)MM_HistogramPercentile(h, 50),
+		name, (unsigned long long)MM_HistogramPercentile(h, 99),
+		name, (unsigned long long)MM_HistogramPercentile(h, 100));
+}
+
+// One JSON object per line, so a dump file can be read back a line at a time
+static void dump_stats(struct stats_dumper *dumper) {
+	// MM_Stats is a few pages big, so it doesn't go on the stack
+	static __thread struct MM_Stats stats;
+	collect_stats(&stats);
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double seconds = (double)(now.tv_sec - dumper->start.tv_sec) + (double)(now.tv_nsec - dumper->start.tv_nsec) / 1e9;
+
+	const char *names[] = {
+		"translations", "tlb_hits", "faults", "minor_faults", "major_faults", "evictions", "evictions_data",
+		"evictions_page_table", "evictions_same_pid", "evictions_other_pid", "writebacks", "swap_bytes_read",
+		"swap_bytes_written",
+	};
+	uint64_t values[] = {
+		stats.translations, stats.tlb_hits, stats.faults, stats.minor_faults, stats.major_faults, stats.evictions,
+		stats.evictions_data, stats.evictions_page_table, stats.evictions_same_pid, stats.evictions_other_pid,
+		stats.writebacks, stats.swap_bytes_read, stats.swap_bytes_written,
+	};
+
+	fprintf(dumper->file, "{\"instance\": %d, \"seconds\": %.3f", mm->id, seconds);
+	for(size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+		fprintf(dumper->file, ", \"%s\": %llu", names[i], (unsigned long long)values[i]);
+
+	dump_histogram(dumper->file, "page_in", &stats.page_in);
+	dump_histogram(dumper->file, "page_out", &stats.page_out);
+	fprintf(dumper->file, "}\n");
+	fflush(dumper->file);
+}
+
+// Each dumper belongs to the instance passed in as 'arg'
+static void *stats_dumper_main(void *arg) {
+	mm = arg;
+	struct stats_dumper *dumper = mm->dumper;
+
+	pthread_mutex_lock(&dumper->lock);
+
+	struct timespec next = dumper->start;
+	while(!dumper->stopping) {
+		uint64_t ns = (uint64_t)next.tv_nsec + (uint64_t)mm->config.stats_dump_interval_ms * 1000000;
+		next.tv_sec += (time_t)(ns / 1000000000);
+		next.tv_nsec = (long)(ns % 1000000000);
+
+		while(!dumper->stopping && pthread_cond_timedwait(&dumper->wake, &dumper->lock, &next) != ETIMEDOUT)
+			;
+
+		// The last dump is made on the way out, so a short run still gets one
+		dump_stats(dumper);
+	}
+
+	pthread_mutex_unlock(&dumper->lock);
+
+	return NULL;
+}
+
+static int start_dumper() {
+	struct stats_dumper *dumper = calloc(1, sizeof(struct stats_dumper));
+	if(dumper == NULL)
+		return -1;
+
+	dumper->file = stderr;
+	if(mm->config.stats_dump_path != NULL && (dumper->file = fopen(mm->config.stats_dump_path, "a")) == NULL) {
+		DEBUG("unable to open %s: %s\n", mm->config.stats_dump_path, strerror(errno));
+		free(dumper);
+		return -1;
+	}
+
+	// The timed waits are against CLOCK_MONOTONIC, like everything else that's timed
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&dumper->wake, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_mutex_init(&dumper->lock, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &dumper->start);
+
+	mm->dumper = dumper;
+	if(pthread_create(&dumper->thread, NULL, stats_dumper_main, mm)) {
+		DEBUG("unable to start stats dump thread\n");
+		mm->dumper = NULL;
+		if(dumper->file != stderr)
+			fclose(dumper->file);
+		pthread_cond_destroy(&dumper->wake);
+		pthread_mutex_destroy(&dumper->lock);
+		free(dumper);
+		return -1;
+	}
+
+	return 0;
+}
+
+int stats_init() {
+	mm->stat_shards = aligned_alloc(64, STAT_SHARDS * sizeof(struct stat_shard));
+	if(mm->stat_shards == NULL)
+		return -1;
+
+	memset(mm->stat_shards, 0, STAT_SHARDS * sizeof(struct stat_shard));
+
+	if(mm->config.stats_dump_interval_ms > 0)
+		return start_dumper();
+
+	return 0;
+}
+
+void stats_destroy() {
+	struct stats_dumper *dumper = mm->dumper;
+
+	if(dumper != NULL) {
+		pthread_mutex_lock(&dumper->lock);
+		dumper->stopping = 1;
+		pthread_cond_signal(&dumper->wake);
+		pthread_mutex_unlock(&dumper->lock);
+		pthread_join(dumper->thread, NULL);
+
+		if(dumper->file != stderr)
+			fclose(dumper->file);
+		pthread_cond_destroy(&dumper->wake);
+		pthread_mutex_destroy(&dumper->lock);
+		free(dumper);
+		mm->dumper = NULL;
+	}
+
+	free(mm->stat_shards);
+	mm->stat_shards = NULL;
+}
@@ -0,0 +1,797 @@
+#define _GNU_SOURCE	// For O_DIRECT
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#include "mm_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Swap: one device per instance, divided into page-sized slots.             //
+///////////////////////////////////////////////////////////////////////////////
+
+// O_DIRECT wants the buffer, the file offset and the length all aligned to the device's logical
+// block size. 4 KiB covers every device we care about
+#define SWAP_DIRECT_ALIGN	4096
+
+// How many writes (and, separately, reads) can be in flight at once
+#define SWAP_MAX_IN_FLIGHT	64
+
+// How many times a background write that failed is tried again before its page is given up on
+#define SWAP_WRITE_RETRIES	3
+
+// One pread() or pwrite() for the workers to do. Everything but 'done', 'result' and 'next' is
+// only touched by whoever submitted it
+struct swap_io {
+	int write;
+	uint8_t *buf;
+	size_t len;
+	off_t offset;
+
+	int done;		// Set by the worker once 'result' is filled in
+	int result;		// 0 on success, -1 on failure
+	struct swap_io *next;	// Link in the submission queue
+};
+
+// A dirty page that's been ejected, but that a worker might not have written out yet. Its data
+// is copied into 'buf', so the frame it came from can be reused right away, and until the write
+// is reaped, reads of the page are served straight from 'buf'
+struct pending_write {
+	struct swap_io io;
+	struct page_key key;
+	int64_t slot;
+	uint8_t *buf;
+	uint8_t used : 1;
+	uint8_t mapped : 1;	// Is this still the page's latest copy (and in pending_map)?
+	uint8_t release : 1;	// Was the slot discarded while the write was in flight?
+	uint8_t retries;	// How many times the write has been tried again after failing
+};
+
+// An asynchronous read started by swap_read_start()
+struct pending_read {
+	struct swap_io io;
+	uint8_t *mem;		// Where the page goes
+	uint8_t *bounce;	// With direct I/O, the aligned buffer it's read into first
+	uint8_t used : 1;
+	uint8_t copy : 1;	// Does the page still have to be copied from 'bounce' to 'mem'?
+};
+
+// Everything the swap device keeps for one instance (see mm->swap)
+struct swap_state {
+	// Every page that's swapped out, no matter its process, goes into one swap device. It's opened
+	// the first time it's needed, so runs that never swap don't leave a file behind
+	int swap_fd;
+	char *swap_path;
+
+	// Which slot each swapped out page is in
+	struct page_map slot_map;
+
+	// Slots that were used once and given back, reused before the device grows
+	uint64_t *free_slots;
+	size_t num_free_slots;
+	size_t free_slots_capacity;
+
+	// Slots at or past this have never been handed out. max_slots is 0 if the device can keep
+	// growing
+	uint64_t next_slot;
+	uint64_t max_slots;
+
+	// How far apart slots are in the swap device. This is just the page size, unless direct I/O
+	// needs every slot to start on a block boundary
+	size_t slot_bytes;
+
+	// With direct I/O, pages go through this aligned buffer, since phys_mem pages usually aren't
+	// aligned (or big enough) on their own
+	uint8_t *bounce;
+	int direct_io;
+
+	// The pool of workers doing pread()/pwrite() calls
+	pthread_t *io_threads;
+	int num_io_threads;
+	int io_stopping;
+
+	// The queue of submitted I/O, and the lock that guards it along with every swap_io's 'done'
+	// and 'result'. Workers wait on io_submitted, and anyone waiting for I/O to finish on
+	// io_completed
+	pthread_mutex_t io_lock;
+	pthread_cond_t io_submitted;
+	pthread_cond_t io_completed;
+	struct swap_io *io_head;
+	struct swap_io *io_tail;
+
+	// Writes that might not be on the device yet, and the latest one for each page
+	struct pending_write *pending;
+	int num_pending;
+	struct page_map pending_map;
+
+	// Pages whose background write never made it to the device, so what's in their slot is stale.
+	// Reading one back is an error, until the page is written again or discarded
+	struct page_map failed_map;
+	int num_failed;
+
+	struct pending_read *reads;
+};
+
+// Returns the swap device's file descriptor, opening it the first time it's needed
+static int get_swap_fd() {
+	if(mm->swap->swap_fd != -1)
+		return mm->swap->swap_fd;
+
+	int flags = O_RDWR | O_CREAT;
+	int fd = open(mm->swap->swap_path, flags | (mm->swap->direct_io ? O_DIRECT : 0), 0644);
+
+	// Some filesystems (tmpfs, for one) don't do direct I/O at all, in which case we still want
+	// to be able to swap, just through the page cache
+	if(fd == -1 && mm->swap->direct_io && errno == EINVAL) {
+		DEBUG("direct I/O not supported for %s, using buffered I/O\n", mm->swap->swap_path);
+		fd = open(mm->swap->swap_path, flags, 0644);
+	}
+
+	if(fd == -1) {
+		DEBUG("unable to open swap device %s: %s\n", mm->swap->swap_path, strerror(errno));
+		return -1;
+	}
+
+	// A regular file starts out empty, since nothing in it means anything anymore. A block device
+	// (or anything else) is used as is, and can't grow past its end
+	struct stat st;
+	if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		if(ftruncate(fd, 0))
+			DEBUG("unable to truncate swap file %s: %s\n", mm->swap->swap_path, strerror(errno));
+	} else {
+		off_t end = lseek(fd, 0, SEEK_END);
+		uint64_t device_slots = end > 0 ? (uint64_t)end / mm->swap->slot_bytes : 0;
+
+		if(mm->swap->max_slots == 0 || device_slots < mm->swap->max_slots)
+			mm->swap->max_slots = device_slots;
+	}
+
+	mm->swap->swap_fd = fd;
+
+	return fd;
+}
+
+// Hands out a free slot, or -1 if the swap device is full
+static int64_t alloc_slot() {
+	if(mm->swap->num_free_slots > 0)
+		return (int64_t)mm->swap->free_slots[--mm->swap->num_free_slots];
+
+	if(mm->swap->max_slots != 0 && mm->swap->next_slot >= mm->swap->max_slots) {
+		DEBUG("swap device full\n");
+		return -1;
+	}
+
+	return (int64_t)mm->swap->next_slot++;
+}
+
+static int release_slot(uint64_t slot) {
+	if(mm->swap->num_free_slots == mm->swap->free_slots_capacity) {
+		size_t capacity = mm->swap->free_slots_capacity ? mm->swap->free_slots_capacity * 2 : 64;
+		uint64_t *grown = realloc(mm->swap->free_slots, capacity * sizeof(uint64_t));
+		if(grown == NULL)
+			return -1;
+
+		mm->swap->free_slots = grown;
+		mm->swap->free_slots_capacity = capacity;
+	}
+
+	mm->swap->free_slots[mm->swap->num_free_slots++] = slot;
+
+	return 0;
+}
+
+// pwrite() can write less than asked for (say, if it's interrupted), so this keeps going
+static int write_fully(int fd, const uint8_t *buf, size_t len, off_t offset) {
+	uint64_t start = stat_now_ns();
+
+	while(len > 0) {
+		ssize_t n = pwrite(fd, buf, len, offset);
+
+		if(n < 0 && errno == EINTR)
+			continue;
+
+		if(n <= 0) {
+			DEBUG("swap write failed: %s\n", strerror(errno));
+			return -1;
+		}
+
+		stat_add(STAT_SWAP_BYTES_WRITTEN, (uint64_t)n);
+		buf += n;
+		len -= n;
+		offset += n;
+	}
+
+	stat_record(STAT_PAGE_OUT, stat_now_ns() - start);
+	return 0;
+}
+
+// Like write_fully(), but anything past the end of the file reads back as zeroes, since a page
+// that was never written out is a page of zeroes
+static int read_fully(int fd, uint8_t *buf, size_t len, off_t offset) {
+	uint64_t start = stat_now_ns();
+
+	while(len > 0) {
+		ssize_t n = pread(fd, buf, len, offset);
+
+		if(n < 0 && errno == EINTR)
+			continue;
+
+		if(n < 0) {
+			DEBUG("swap read failed: %s\n", strerror(errno));
+			return -1;
+		}
+
+		if(n == 0) {
+			memset(buf, 0, len);
+			break;
+		}
+
+		stat_add(STAT_SWAP_BYTES_READ, (uint64_t)n);
+		buf += n;
+		len -= n;
+		offset += n;
+	}
+
+	stat_record(STAT_PAGE_IN, stat_now_ns() - start);
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Asynchronous I/O: a pool of worker threads doing pread()/pwrite() calls.  //
+///////////////////////////////////////////////////////////////////////////////
+
+// Each worker belongs to the instance passed in as 'arg'
+static void *swap_worker(void *arg) {
+	mm = arg;
+
+	pthread_mutex_lock(&mm->swap->io_lock);
+
+	for(;;) {
+		while(mm->swap->io_head == NULL && !mm->swap->io_stopping)
+			pthread_cond_wait(&mm->swap->io_submitted, &mm->swap->io_lock);
+
+		// Everything that was submitted gets done before the workers stop
+		if(mm->swap->io_head == NULL)
+			break;
+
+		struct swap_io *io = mm->swap->io_head;
+		mm->swap->io_head = io->next;
+		if(mm->swap->io_head == NULL)
+			mm->swap->io_tail = NULL;
+
+		pthread_mutex_unlock(&mm->swap->io_lock);
+
+		int result = io->write ? write_fully(mm->swap->swap_fd, io->buf, io->len, io->offset) :
+				read_fully(mm->swap->swap_fd, io->buf, io->len, io->offset);
+
+		pthread_mutex_lock(&mm->swap->io_lock);
+		io->result = result;
+		io->done = 1;
+		pthread_cond_broadcast(&mm->swap->io_completed);
+	}
+
+	pthread_mutex_unlock(&mm->swap->io_lock);
+
+	return NULL;
+}
+
+// Hands I/O to the workers, or just does it if there aren't any
+static void io_submit(struct swap_io *io) {
+	io->next = NULL;
+
+	if(mm->swap->num_io_threads == 0) {
+		io->result = io->write ? write_fully(mm->swap->swap_fd, io->buf, io->len, io->offset) :
+				read_fully(mm->swap->swap_fd, io->buf, io->len, io->offset);
+		io->done = 1;
+		return;
+	}
+
+	// 'done' can be looked at by swap_read_wait() without mm->lock, so it only changes under io_lock
+	pthread_mutex_lock(&mm->swap->io_lock);
+	io->done = 0;
+
+	if(mm->swap->io_tail != NULL)
+		mm->swap->io_tail->next = io;
+	else
+		mm->swap->io_head = io;
+
+	mm->swap->io_tail = io;
+
+	pthread_cond_signal(&mm->swap->io_submitted);
+	pthread_mutex_unlock(&mm->swap->io_lock);
+}
+
+static int io_done(struct swap_io *io) {
+	pthread_mutex_lock(&mm->swap->io_lock);
+	int done = io->done;
+	pthread_mutex_unlock(&mm->swap->io_lock);
+
+	return done;
+}
+
+static int io_wait(struct swap_io *io) {
+	pthread_mutex_lock(&mm->swap->io_lock);
+	while(!io->done)
+		pthread_cond_wait(&mm->swap->io_completed, &mm->swap->io_lock);
+	pthread_mutex_unlock(&mm->swap->io_lock);
+
+	return io->result;
+}
+
+// Cleans up after a write that's finished, freeing up its pending entry. The frame the page came
+// from is long gone, so if the write failed and the buffer is still the page's latest copy, it's
+// tried again right away. If that fails too the entry is kept, so reads are still served from the
+// buffer and the next reap tries again. After SWAP_WRITE_RETRIES tries the page is given up on,
+// and its slot is marked failed so reading it back is an error rather than stale data. Returns 1
+// if the entry was freed, or 0 if it was kept
+static int reap_write(int i) {
+	struct pending_write *w = &mm->swap->pending[i];
+
+	if(w->io.result && w->mapped) {
+		w->io.result = write_fully(mm->swap->swap_fd, w->io.buf, w->io.len, w->io.offset);
+
+		if(w->io.result && ++w->retries < SWAP_WRITE_RETRIES) {
+			DEBUG("swap write failed, keeping the page to try again\n");
+			return 0;
+		}
+
+		if(w->io.result) {
+			DEBUG("lost a page that couldn't be written to swap\n");
+			if(page_map_find(&mm->swap->failed_map, w->key) == NULL && page_map_put(&mm->swap->failed_map, w->key, w->slot) == 0)
+				mm->swap->num_failed++;
+		}
+	}
+
+	if(w->mapped)
+		page_map_erase(&mm->swap->pending_map, page_map_find(&mm->swap->pending_map, w->key));
+
+	if(w->release)
+		release_slot((uint64_t)w->slot);
+
+	w->used = 0;
+	mm->swap->num_pending--;
+
+	return 1;
+}
+
+// A page that's written again (or discarded) doesn't have a stale copy anymore
+static void clear_failed(struct page_key key) {
+	if(mm->swap->num_failed == 0)
+		return;
+
+	struct page_map_slot *failed = page_map_find(&mm->swap->failed_map, key);
+	if(failed != NULL) {
+		page_map_erase(&mm->swap->failed_map, failed);
+		mm->swap->num_failed--;
+	}
+}
+
+static int is_failed(struct page_key key) {
+	return mm->swap->num_failed > 0 && page_map_find(&mm->swap->failed_map, key) != NULL;
+}
+
+// Reaps every write that's finished. If 'wait' is set and nothing could be freed, this waits
+// until a write that's still in flight finishes
+static void reap_writes(int wait) {
+	for(;;) {
+		int reaped = 0;
+
+		for(int i = 0; i < SWAP_MAX_IN_FLIGHT; i++) {
+			if(mm->swap->pending[i].used && io_done(&mm->swap->pending[i].io))
+				reaped += reap_write(i);
+		}
+
+		if(reaped > 0 || !wait)
+			return;
+
+		// Looking for a finished write and going to sleep have to happen under one hold of io_lock.
+		// Otherwise the last write could finish in between, and its broadcast would never be seen
+		pthread_mutex_lock(&mm->swap->io_lock);
+
+		int done;
+		int in_flight;
+		for(;;) {
+			done = 0;
+			in_flight = 0;
+
+			for(int i = 0; i < SWAP_MAX_IN_FLIGHT; i++) {
+				if(!mm->swap->pending[i].used)
+					continue;
+
+				if(mm->swap->pending[i].io.done)
+					done++;
+				else
+					in_flight++;
+			}
+
+			if(done > 0 || in_flight == 0)
+				break;
+
+			pthread_cond_wait(&mm->swap->io_completed, &mm->swap->io_lock);
+		}
+
+		pthread_mutex_unlock(&mm->swap->io_lock);
+
+		if(done == 0)
+			return;
+	}
+}
+
+void swap_flush() {
+	if(mm->swap->pending == NULL)
+		return;
+
+	for(int i = 0; i < SWAP_MAX_IN_FLIGHT; i++) {
+		if(mm->swap->pending[i].used) {
+			io_wait(&mm->swap->pending[i].io);
+			while(!reap_write(i))
+				;
+		}
+	}
+}
+
+// Hands a page to the workers to write into 'slot', returning right away
+static int swap_write_async(struct page_key key, int64_t slot, const uint8_t *mem) {
+	// A page only ever has one write in flight, so an older one has to finish first
+	// Its buffer isn't the page's latest copy anymore either, so if it failed it's not retried
+	struct page_map_slot *entry = page_map_find(&mm->swap->pending_map, key);
+	if(entry != NULL) {
+		struct pending_write *old = &mm->swap->pending[entry->value];
+		io_wait(&old->io);
+		old->mapped = 0;
+		page_map_erase(&mm->swap->pending_map, entry);
+		reap_write((int)(old - mm->swap->pending));
+	}
+
+	if(mm->swap->num_pending == SWAP_MAX_IN_FLIGHT)
+		reap_writes(1);
+
+	// Every entry can be holding on to a write that keeps failing
+	if(mm->swap->num_pending == SWAP_MAX_IN_FLIGHT) {
+		DEBUG("no room for another swap write\n");
+		return -1;
+	}
+
+	int i = 0;
+	while(mm->swap->pending[i].used)
+		i++;
+
+	struct pending_write *w = &mm->swap->pending[i];
+	if(page_map_put(&mm->swap->pending_map, key, i))
+		return -1;
+
+	w->used = 1;
+	w->mapped = 1;
+	w->release = 0;
+	w->retries = 0;
+	w->key = key;
+	w->slot = slot;
+	mm->swap->num_pending++;
+
+	memcpy(w->buf, mem, mm->page_size_bytes);
+	memset(w->buf + mm->page_size_bytes, 0, mm->swap->slot_bytes - mm->page_size_bytes);
+
+	w->io.write = 1;
+	w->io.buf = w->buf;
+	w->io.len = mm->swap->direct_io ? mm->swap->slot_bytes : (size_t)mm->page_size_bytes;
+	w->io.offset = (off_t)((uint64_t)slot * mm->swap->slot_bytes);
+	io_submit(&w->io);
+
+	return 0;
+}
+
+// A buffer big enough for a slot, aligned for direct I/O
+static int swap_buffer_alloc(uint8_t **buf) {
+	if(posix_memalign((void**)buf, SWAP_DIRECT_ALIGN, mm->swap->slot_bytes)) {
+		*buf = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+int swap_init() {
+	mm->swap = calloc(1, sizeof(struct swap_state));
+	if(mm->swap == NULL)
+		return -1;
+
+	mm->swap->swap_fd = -1;
+	pthread_mutex_init(&mm->swap->io_lock, NULL);
+	pthread_cond_init(&mm->swap->io_submitted, NULL);
+	pthread_cond_init(&mm->swap->io_completed, NULL);
+
+	mm->swap->direct_io = mm->config.swap_direct_io;
+	mm->swap->slot_bytes = mm->page_size_bytes;
+
+	if(mm->swap->direct_io)
+		mm->swap->slot_bytes = (mm->page_size_bytes + SWAP_DIRECT_ALIGN - 1) / SWAP_DIRECT_ALIGN * SWAP_DIRECT_ALIGN;
+
+	mm->swap->max_slots = mm->config.swap_size_bytes / mm->swap->slot_bytes;
+
+	// The path is copied, since the caller's config doesn't have to outlive MM_Init(). Instances
+	// besides the default one get a path of their own, so they don't write over each other
+	char path[64] = "./mm.swp";
+	if(mm != &default_instance)
+		snprintf(path, sizeof(path), "./mm.%d.swp", mm->id);
+
+	mm->swap->swap_path = strdup(mm->config.swap_path != NULL ? mm->config.swap_path : path);
+	if(mm->swap->swap_path == NULL || page_map_init(&mm->swap->slot_map, 1024))
+		return -1;
+
+	if(mm->swap->direct_io && swap_buffer_alloc(&mm->swap->bounce))
+		return -1;
+
+	mm->swap->reads = calloc(SWAP_MAX_IN_FLIGHT, sizeof(struct pending_read));
+	if(mm->swap->reads == NULL)
+		return -1;
+
+	for(int i = 0; i < SWAP_MAX_IN_FLIGHT && mm->swap->direct_io; i++)
+		if(swap_buffer_alloc(&mm->swap->reads[i].bounce))
+			return -1;
+
+	// The writeback cleaner is only any use if its writes happen in the background, so it gets a
+	// worker even if none were asked for
+	int threads = mm->config.swap_io_threads;
+	if(threads == 0 && mm->config.writeback_low_watermark > 0)
+		threads = 1;
+
+	// Without any workers, all I/O is done right when it's asked for and nothing is ever pending
+	if(threads == 0)
+		return 0;
+
+	mm->swap->pending = calloc(SWAP_MAX_IN_FLIGHT, sizeof(struct pending_write));
+	mm->swap->io_threads = calloc(threads, sizeof(pthread_t));
+	if(mm->swap->pending == NULL || mm->swap->io_threads == NULL || page_map_init(&mm->swap->pending_map, 2 * SWAP_MAX_IN_FLIGHT) ||
+		page_map_init(&mm->swap->failed_map, 64))
+		return -1;
+
+	for(int i = 0; i < SWAP_MAX_IN_FLIGHT; i++)
+		if(swap_buffer_alloc(&mm->swap->pending[i].buf))
+			return -1;
+
+	mm->swap->io_stopping = 0;
+	for(; mm->swap->num_io_threads < threads; mm->swap->num_io_threads++) {
+		if(pthread_create(&mm->swap->io_threads[mm->swap->num_io_threads], NULL, swap_worker, mm)) {
+			DEBUG("unable to start swap I/O thread\n");
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void swap_destroy() {
+	if(mm->swap == NULL)
+		return;
+
+	// The workers finish whatever's queued (including reads into phys_mem) before stopping
+	swap_flush();
+
+	pthread_mutex_lock(&mm->swap->io_lock);
+	mm->swap->io_stopping = 1;
+	pthread_cond_broadcast(&mm->swap->io_submitted);
+	pthread_mutex_unlock(&mm->swap->io_lock);
+
+	for(int i = 0; i < mm->swap->num_io_threads; i++)
+		pthread_join(mm->swap->io_threads[i], NULL);
+
+	if(mm->swap->swap_fd != -1)
+		close(mm->swap->swap_fd);
+
+	for(int i = 0; mm->swap->pending != NULL && i < SWAP_MAX_IN_FLIGHT; i++)
+		free(mm->swap->pending[i].buf);
+
+	for(int i = 0; mm->swap->reads != NULL && i < SWAP_MAX_IN_FLIGHT; i++)
+		free(mm->swap->reads[i].bounce);
+
+	free(mm->swap->swap_path);
+	free(mm->swap->free_slots);
+	free(mm->swap->bounce);
+	free(mm->swap->pending);
+	free(mm->swap->reads);
+	free(mm->swap->io_threads);
+	page_map_free(&mm->swap->slot_map);
+	page_map_free(&mm->swap->pending_map);
+	page_map_free(&mm->swap->failed_map);
+	pthread_mutex_destroy(&mm->swap->io_lock);
+	pthread_cond_destroy(&mm->swap->io_submitted);
+	pthread_cond_destroy(&mm->swap->io_completed);
+	free(mm->swap);
+	mm->swap = NULL;
+}
+
+int swap_write(struct page_key key, const uint8_t *mem) {
+	int fd = get_swap_fd();
+	if(fd == -1)
+		return -1;
+
+	// A page that's been swapped out before goes back into the same slot
+	struct page_map_slot *entry = page_map_find(&mm->swap->slot_map, key);
+	int64_t slot = entry != NULL ? entry->value : alloc_slot();
+	if(slot == -1)
+		return -1;
+
+	if(mm->swap->num_io_threads > 0) {
+		if(entry == NULL && page_map_put(&mm->swap->slot_map, key, slot)) {
+			release_slot(slot);
+			return -1;
+		}
+
+		int ret = swap_write_async(key, slot, mem);
+		if(ret == 0)
+			clear_failed(key);
+
+		return ret;
+	}
+
+	off_t offset = (off_t)((uint64_t)slot * mm->swap->slot_bytes);
+	int ret;
+
+	if(!mm->swap->direct_io) {
+		ret = write_fully(fd, mem, mm->page_size_bytes, offset);
+	} else {
+		memcpy(mm->swap->bounce, mem, mm->page_size_bytes);
+		memset(mm->swap->bounce + mm->page_size_bytes, 0, mm->swap->slot_bytes - mm->page_size_bytes);
+		ret = write_fully(fd, mm->swap->bounce, mm->swap->slot_bytes, offset);
+	}
+
+	if(entry == NULL && (ret || page_map_put(&mm->swap->slot_map, key, slot))) {
+		release_slot(slot);
+		return -1;
+	}
+
+	return ret;
+}
+
+int swap_read(struct page_key key, uint8_t *mem) {
+	// A page that hasn't made it out to the device yet is still sitting in its write buffer
+	if(mm->swap->num_pending > 0) {
+		struct page_map_slot *write = page_map_find(&mm->swap->pending_map, key);
+		if(write != NULL) {
+			memcpy(mem, mm->swap->pending[write->value].buf, mm->page_size_bytes);
+			return 0;
+		}
+	}
+
+	if(is_failed(key)) {
+		DEBUG("page was lost when it couldn't be written to swap\n");
+		return -1;
+	}
+
+	// A page that was never swapped out is a page of zeroes
+	struct page_map_slot *entry = page_map_find(&mm->swap->slot_map, key);
+	if(entry == NULL) {
+		memset(mem, 0, mm->page_size_bytes);
+		return 0;
+	}
+
+	int fd = get_swap_fd();
+	if(fd == -1)
+		return -1;
+
+	off_t offset = (off_t)((uint64_t)entry->value * mm->swap->slot_bytes);
+
+	if(!mm->swap->direct_io)
+		return read_fully(fd, mem, mm->page_size_bytes, offset);
+
+	if(read_fully(fd, mm->swap->bounce, mm->swap->slot_bytes, offset))
+		return -1;
+
+	memcpy(mem, mm->swap->bounce, mm->page_size_bytes);
+
+	return 0;
+}
+
+void swap_discard(struct page_key key) {
+	clear_failed(key);
+
+	struct page_map_slot *entry = page_map_find(&mm->swap->slot_map, key);
+	if(entry == NULL)
+		return;
+
+	// A slot that's still being written to can't be handed out again until the write is done
+	struct page_map_slot *write = mm->swap->num_pending > 0 ? page_map_find(&mm->swap->pending_map, key) : NULL;
+	if(write != NULL) {
+		mm->swap->pending[write->value].mapped = 0;
+		mm->swap->pending[write->value].release = 1;
+		page_map_erase(&mm->swap->pending_map, write);
+	} else {
+		// If the slot can't be remembered as free it's just lost, which only wastes a little space
+		release_slot((uint64_t)entry->value);
+	}
+
+	page_map_erase(&mm->swap->slot_map, entry);
+}
+
+int swap_contains(struct page_key key) {
+	return page_map_find(&mm->swap->slot_map, key) != NULL;
+}
+
+int64_t swap_slot(struct page_key key) {
+	struct page_map_slot *entry = page_map_find(&mm->swap->slot_map, key);
+	return entry != NULL ? entry->value : -1;
+}
+
+int swap_pending(struct page_key key) {
+	return mm->swap->num_pending > 0 && page_map_find(&mm->swap->pending_map, key) != NULL;
+}
+
+int swap_on_device(struct page_key key) {
+	return !swap_pending(key) && swap_contains(key);
+}
+
+int swap_read_start(struct page_key key, uint8_t *mem) {
+	int i = 0;
+	while(i < SWAP_MAX_IN_FLIGHT && mm->swap->reads[i].used)
+		i++;
+
+	if(i == SWAP_MAX_IN_FLIGHT) {
+		DEBUG("too many swap reads in flight\n");
+		return -1;
+	}
+
+	struct pending_read *r = &mm->swap->reads[i];
+	r->used = 1;
+	r->copy = 0;
+	r->mem = mem;
+	r->io.write = 0;
+	r->io.result = 0;
+
+	// A fault waiting on this handle with mm->lock dropped may still be looking at it, if another
+	// thread finished its read and the handle was handed out again
+	pthread_mutex_lock(&mm->swap->io_lock);
+	r->io.done = 1;
+	pthread_mutex_unlock(&mm->swap->io_lock);
+
+	// Pages that don't need the device are read right away
+	struct page_map_slot *write = mm->swap->num_pending > 0 ? page_map_find(&mm->swap->pending_map, key) : NULL;
+	struct page_map_slot *entry = page_map_find(&mm->swap->slot_map, key);
+	if(write != NULL || entry == NULL || is_failed(key)) {
+		r->io.result = swap_read(key, mem);
+		return i;
+	}
+
+	if(get_swap_fd() == -1) {
+		r->io.result = -1;
+		return i;
+	}
+
+	// With direct I/O the page goes through an aligned buffer, and is copied over when it's done
+	r->copy = mm->swap->direct_io;
+	r->io.buf = mm->swap->direct_io ? r->bounce : mem;
+	r->io.len = mm->swap->direct_io ? mm->swap->slot_bytes : (size_t)mm->page_size_bytes;
+	r->io.offset = (off_t)((uint64_t)entry->value * mm->swap->slot_bytes);
+	io_submit(&r->io);
+
+	return i;
+}
+
+int swap_read_poll(int handle) {
+	return io_done(&mm->swap->reads[handle].io);
+}
+
+void swap_read_wait(int handle) {
+	struct swap_io *io = &mm->swap->reads[handle].io;
+
+	pthread_mutex_lock(&mm->swap->io_lock);
+	while(!io->done)
+		pthread_cond_wait(&mm->swap->io_completed, &mm->swap->io_lock);
+	pthread_mutex_unlock(&mm->swap->io_lock);
+}
+
+int swap_read_finish(int handle) {
+	struct pending_read *r = &mm->swap->reads[handle];
+	int result = io_wait(&r->io);
+
+	if(result == 0 && r->copy)
+		memcpy(r->mem, r->io.buf, mm->page_size_bytes);
+
+	r->used = 0;
+
+	return result;
+}
@@ -0,0 +1,516 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "mm_api.h"
+#include "mm_trace.h"
+#include "mm_workload.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Replays one trace (text or binary, see mm_trace.h) against every point    //
+// of a grid of frame counts, page sizes and policies, each in its own       //
+// instance, and writes a CSV row of counts per point.                       //
+///////////////////////////////////////////////////////////////////////////////
+
+// The most values any one axis of the grid can have
+#define SWEEP_MAX_VALUES	64
+
+// The whole trace, read once up front and shared (read only) by every point
+struct trace {
+	struct trace_op *ops;
+	size_t count;
+	size_t capacity;
+	int max_pid;
+	uint64_t max_address;
+
+	// The accesses in the trace, for MM_POLICY_OPT
+	struct MM_Access *future;
+	size_t future_count;
+};
+
+// One configuration to run, and what came of it
+struct point {
+	int frames;
+	int page_size_bits;
+	enum MM_ReplacementPolicy policy;
+
+	int supported;		// Could an instance be created with this geometry at all?
+	uint64_t failures;	// Calls in the trace that returned an error
+	struct MM_Stats stats;
+	double seconds;
+};
+
+// A deque of points per worker. Workers take their own points from the tail and, once they run
+// out, steal from the head of someone else's. Points take wildly different amounts of time (a few
+// frames thrash, a lot of frames barely fault), so handing them out up front leaves threads idle
+struct worker {
+	pthread_mutex_t lock;
+	int *points;
+	int head, tail;
+	pthread_t thread;
+};
+
+static struct trace trace;
+static struct point *points = NULL;
+static int num_points = 0;
+static struct worker *workers = NULL;
+static int num_workers = 0;
+static const char *swap_dir = ".";
+
+static const char *const policy_names[] = {
+	[MM_POLICY_SIMPLE] = "simple",
+	[MM_POLICY_FIFO] = "fifo",
+	[MM_POLICY_CLOCK] = "clock",
+	[MM_POLICY_SECOND_CHANCE] = "second_chance",
+	[MM_POLICY_LRU] = "lru",
+	[MM_POLICY_LRU_APPROX] = "lru_approx",
+	[MM_POLICY_LFU] = "lfu",
+	[MM_POLICY_ARC] = "arc",
+	[MM_POLICY_OPT] = "opt",
+};
+
+#define NUM_POLICIES	((int)(sizeof(policy_names) / sizeof(policy_names[0])))
+
+static int trace_push(struct trace_op op) {
+	if(trace.count == trace.capacity) {
+		size_t capacity = trace.capacity ? trace.capacity * 2 : 1024;
+		struct trace_op *ops = realloc(trace.ops, capacity * sizeof(struct trace_op));
+		if(ops == NULL)
+			return -1;
+
+		trace.ops = ops;
+		trace.capacity = capacity;
+	}
+
+	trace.ops[trace.count++] = op;
+	return 0;
+}
+
+static int add_op(struct trace_op op) {
+	if(trace_push(op))
+		return -1;
+
+	if(op.kind != TRACE_SWAP) {
+		if(op.pid > trace.max_pid)
+			trace.max_pid = op.pid;
+		if(op.address > trace.max_address)
+			trace.max_address = op.address;
+	}
+
+	return 0;
+}
+
+static int load_binary_trace(const char *path) {
+	struct trace_reader reader;
+	if(trace_reader_open(&reader, path)) {
+		fprintf(stderr, "%s: can't map trace\n", path);
+		return -1;
+	}
+
+	struct trace_op op;
+	int rc;
+	while((rc = trace_reader_next(&reader, &op)) == 1) {
+		if(add_op(op)) {
+			rc = -1;
+			break;
+		}
+	}
+
+	trace_reader_close(&reader);
+	if(rc < 0)
+		fprintf(stderr, "%s: trace is corrupt\n", path);
+
+	return rc;
+}
+
+static int load_text_trace(const char *path) {
+	FILE *input = fopen(path, "r");
+	if(input == NULL) {
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	char *line = NULL;
+	size_t line_size = 0;
+	size_t line_no = 0;
+	int ret = 0;
+
+	while(getline(&line, &line_size, input) >= 0) {
+		line_no++;
+
+		struct trace_op op;
+		int rc = trace_parse_line(line, &op);
+		if(rc < 0) {
+			fprintf(stderr, "%s:%zu: can't parse line\n", path, line_no);
+			ret = -1;
+			break;
+		}
+
+		if(rc == 0 && add_op(op)) {
+			fprintf(stderr, "out of memory reading %s\n", path);
+			ret = -1;
+			break;
+		}
+	}
+
+	free(line);
+	fclose(input);
+
+	return ret;
+}
+
+static int load_compressed_trace(const char *path) {
+	struct trace_pipe *pipe = trace_pipe_open(path);
+	if(pipe == NULL) {
+		fprintf(stderr, "%s: can't open trace\n", path);
+		return -1;
+	}
+
+	struct trace_op op;
+	int rc;
+	while((rc = trace_pipe_next(pipe, &op)) == 1) {
+		if(add_op(op)) {
+			rc = -1;
+			break;
+		}
+	}
+
+	trace_pipe_close(pipe);
+	if(rc < 0)
+		fprintf(stderr, "%s: trace is corrupt or couldn't be decompressed\n", path);
+
+	return rc;
+}
+
+// A synthetic workload in place of a trace, see mm_workload.h
+static int load_workload(const char *spec) {
+	struct workload_config config;
+	struct workload workload;
+
+	workload_default_config(&config);
+	if(workload_parse(spec, &config) || workload_init(&workload, &config)) {
+		fprintf(stderr, "%s: invalid workload\n", spec);
+		return -1;
+	}
+
+	struct trace_op op;
+	while(workload_next(&workload, &op)) {
+		if(add_op(op)) {
+			fprintf(stderr, "out of memory generating %s\n", spec);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int load_trace(const char *path, int generate) {
+	int rc;
+	if(generate)
+		rc = load_workload(path);
+	else if(trace_is_binary(path))
+		rc = load_binary_trace(path);
+	else if(trace_is_compressed(path))
+		rc = load_compressed_trace(path);
+	else
+		rc = load_text_trace(path);
+
+	if(rc)
+		return -1;
+
+	// OPT is told about every map, load and store ahead of time
+	trace.future = calloc(trace.count + 1, sizeof(struct MM_Access));
+	if(trace.future == NULL)
+		return -1;
+
+	for(size_t i = 0; i < trace.count; i++) {
+		if(trace.ops[i].kind == TRACE_SWAP)
+			continue;
+
+		trace.future[trace.future_count].pid = trace.ops[i].pid;
+		trace.future[trace.future_count].address = trace.ops[i].address;
+		trace.future_count++;
+	}
+
+	return 0;
+}
+
+// Creates an instance for 'point', with an address space just big enough for the trace and as
+// few page table levels as fit it. Returns NULL if the geometry isn't supported
+static struct MM_Instance *create_instance(struct point *point, const char *swap_path) {
+	struct MM_Config config;
+	MM_DefaultConfig(&config);
+	config.page_size_bits = point->page_size_bits;
+	config.physical_memory_size_bytes = (uint64_t)point->frames << point->page_size_bits;
+	config.max_processes = trace.max_pid + 1;
+	config.replacement_policy = point->policy;
+	config.swap_path = swap_path;
+
+	config.process_virtual_memory_size_shift = point->page_size_bits;
+	while(config.process_virtual_memory_size_shift < 48 &&
+			((uint64_t)1 << config.process_virtual_memory_size_shift) <= trace.max_address)
+		config.process_virtual_memory_size_shift++;
+
+	for(config.page_table_levels = 1; config.page_table_levels <= 4; config.page_table_levels++) {
+		struct MM_Instance *instance = MM_Create(&config);
+		if(instance != NULL)
+			return instance;
+	}
+
+	return NULL;
+}
+
+static void run_point(int index) {
+	struct point *point = &points[index];
+
+	char swap_path[4096];
+	snprintf(swap_path, sizeof(swap_path), "%s/mm_sweep.%d.%d.swp", swap_dir, (int)getpid(), index);
+
+	struct MM_Instance *instance = create_instance(point, swap_path);
+	if(instance == NULL)
+		return;
+
+	point->supported = 1;
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if(point->policy == MM_POLICY_OPT && MM_SetOracle_ex(instance, trace.future, trace.future_count))
+		point->failures++;
+
+	for(size_t i = 0; i < trace.count; i++) {
+		const struct trace_op *op = &trace.ops[i];
+		uint8_t value;
+
+		switch(op->kind) {
+		case TRACE_SWAP:
+			MM_SwapOn_ex(instance);
+			break;
+		case TRACE_MAP:
+			point->failures += MM_Map_ex(instance, op->pid, op->address, op->value != 0).error != 0;
+			break;
+		case TRACE_LOAD:
+			point->failures += MM_LoadByte_ex(instance, op->pid, op->address, &value) != 0;
+			break;
+		case TRACE_STORE:
+			point->failures += MM_StoreByte_ex(instance, op->pid, op->address, op->value) != 0;
+			break;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	point->seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+
+	MM_GetStats_ex(instance, &point->stats);
+	MM_Destroy(instance);
+	unlink(swap_path);
+}
+
+// Takes the next point for worker 'self' to run, stealing one if its own deque is empty. Returns
+// -1 once every deque is empty, since nothing new is ever added
+static int next_point(int self) {
+	struct worker *own = &workers[self];
+	int index = -1;
+
+	pthread_mutex_lock(&own->lock);
+	if(own->head != own->tail)
+		index = own->points[--own->tail];
+	pthread_mutex_unlock(&own->lock);
+
+	for(int i = 1; i < num_workers && index == -1; i++) {
+		struct worker *victim = &workers[(self + i) % num_workers];
+
+		pthread_mutex_lock(&victim->lock);
+		if(victim->head != victim->tail)
+			index = victim->points[victim->head++];
+		pthread_mutex_unlock(&victim->lock);
+	}
+
+	return index;
+}
+
+static void *worker_main(void *arg) {
+	int self = (int)(intptr_t)arg;
+
+	for(int index = next_point(self); index != -1; index = next_point(self))
+		run_point(index);
+
+	return NULL;
+}
+
+// Parses a comma separated list of numbers (or, with 'names' set, policy names) into 'values'.
+// Returns how many there were, or -1 if any of them isn't valid
+static int parse_list(const char *arg, int *values, int names) {
+	char *copy = strdup(arg);
+	if(copy == NULL)
+		return -1;
+
+	int count = 0;
+	for(char *item = strtok(copy, ","); item != NULL; item = strtok(NULL, ",")) {
+		if(count == SWEEP_MAX_VALUES) {
+			count = -1;
+			break;
+		}
+
+		int value = -1;
+		if(names) {
+			for(int i = 0; i < NUM_POLICIES; i++)
+				if(strcmp(item, policy_names[i]) == 0)
+					value = i;
+		} else {
+			char *end;
+			long parsed = strtol(item, &end, 10);
+			if(*end == 0 && parsed > 0 && parsed <= INT32_MAX)
+				value = (int)parsed;
+		}
+
+		if(value == -1) {
+			fprintf(stderr, "invalid value '%s'\n", item);
+			count = -1;
+			break;
+		}
+
+		values[count++] = value;
+	}
+
+	free(copy);
+	return count;
+}
+
+static void usage(const char *argv0) {
+	fprintf(stderr, "usage: %s [-j threads] [-f frames,...] [-p page_size_bits,...] [-P policy,...]\n"
+		"       [-d swap_dir] [-o out.csv] trace\n", argv0);
+	fprintf(stderr, "       %s [options as above] -g workload_spec\n", argv0);
+	fprintf(stderr, "policies:");
+	for(int i = 0; i < NUM_POLICIES; i++)
+		fprintf(stderr, " %s", policy_names[i]);
+	fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv) {
+	int frames[SWEEP_MAX_VALUES] = { 4, 8, 16, 32, 64 };
+	int num_frames = 5;
+	int page_bits[SWEEP_MAX_VALUES] = { MM_PAGE_SIZE_BITS };
+	int num_page_bits = 1;
+	int policies[SWEEP_MAX_VALUES] = { MM_POLICY_SIMPLE };
+	int num_policies = 1;
+	const char *output_path = NULL;
+	int generate = 0;
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	num_workers = cpus > 0 ? (int)cpus : 1;
+
+	int opt;
+	while((opt = getopt(argc, argv, "j:f:p:P:d:o:gh")) != -1) {
+		switch(opt) {
+		case 'j':
+			num_workers = atoi(optarg);
+			break;
+		case 'f':
+			num_frames = parse_list(optarg, frames, 0);
+			break;
+		case 'p':
+			num_page_bits = parse_list(optarg, page_bits, 0);
+			break;
+		case 'P':
+			num_policies = parse_list(optarg, policies, 1);
+			break;
+		case 'd':
+			swap_dir = optarg;
+			break;
+		case 'o':
+			output_path = optarg;
+			break;
+		case 'g':
+			generate = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if(optind != argc - 1 || num_workers < 1 || num_frames < 1 || num_page_bits < 1 || num_policies < 1) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if(load_trace(argv[optind], generate))
+		return 1;
+
+	FILE *output = stdout;
+	if(output_path != NULL && (output = fopen(output_path, "w")) == NULL) {
+		fprintf(stderr, "%s: %s\n", output_path, strerror(errno));
+		return 1;
+	}
+
+	num_points = num_frames * num_page_bits * num_policies;
+	points = calloc(num_points, sizeof(struct point));
+	CHECK(points != NULL);
+
+	int index = 0;
+	for(int f = 0; f < num_frames; f++) {
+		for(int p = 0; p < num_page_bits; p++) {
+			for(int P = 0; P < num_policies; P++) {
+				points[index].frames = frames[f];
+				points[index].page_size_bits = page_bits[p];
+				points[index].policy = (enum MM_ReplacementPolicy)policies[P];
+				index++;
+			}
+		}
+	}
+
+	// Points are dealt out round robin to start with, and stolen from there
+	if(num_workers > num_points)
+		num_workers = num_points;
+
+	workers = calloc(num_workers, sizeof(struct worker));
+	CHECK(workers != NULL);
+
+	for(int w = 0; w < num_workers; w++) {
+		pthread_mutex_init(&workers[w].lock, NULL);
+		workers[w].points = calloc(num_points / num_workers + 1, sizeof(int));
+		CHECK(workers[w].points != NULL);
+	}
+
+	for(int i = 0; i < num_points; i++) {
+		struct worker *worker = &workers[i % num_workers];
+		worker->points[worker->tail++] = i;
+	}
+
+	for(int w = 0; w < num_workers; w++)
+		CHECK(pthread_create(&workers[w].thread, NULL, worker_main, (void*)(intptr_t)w) == 0);
+
+	for(int w = 0; w < num_workers; w++)
+		pthread_join(workers[w].thread, NULL);
+
+	fprintf(output, "frames,page_size_bits,policy,supported,ops,failures,tlb_hits,faults,evictions,writebacks,swap_bytes_read,swap_bytes_written,seconds\n");
+	for(int i = 0; i < num_points; i++) {
+		struct point *point = &points[i];
+		fprintf(output, "%d,%d,%s,%d,%zu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%.6f\n", point->frames, point->page_size_bits,
+			policy_names[point->policy], point->supported, trace.count, (unsigned long long)point->failures,
+			(unsigned long long)point->stats.tlb_hits, (unsigned long long)point->stats.faults,
+			(unsigned long long)point->stats.evictions, (unsigned long long)point->stats.writebacks,
+			(unsigned long long)point->stats.swap_bytes_read, (unsigned long long)point->stats.swap_bytes_written,
+			point->seconds);
+	}
+
+	CHECK(output == stdout || fclose(output) == 0);
+
+	for(int w = 0; w < num_workers; w++) {
+		pthread_mutex_destroy(&workers[w].lock);
+		free(workers[w].points);
+	}
+
+	free(workers);
+	free(points);
+	free(trace.ops);
+	free(trace.future);
+
+	return 0;
+}
@@ -3,10 +3,13 @@
 
 #include <string>
 #include <map>
+#include <set>
 #include <tuple>
 #include <vector>
 #include <functional>
+#include <algorithm>
 #include <thread>
+#include <atomic>
 
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -14,6 +17,8 @@
 #include <fcntl.h>
 
 #include "mm_api.h"
+#include "mm_trace.h"
+#include "mm_workload.h"
 
 #define FAIL_IF(x)		do { if ((x)) { std::cout << __FILE__ << ":" << __LINE__ << ": " << #x << std::endl; exit(1); } } while(0)
 #define FAIL_UNLESS_EQ(x, y)	do { auto xval = (x); auto yval = (y); if ((xval) != (yval)) { std::cout << __FILE__ << ":" << __LINE__ << ": " << #x << " (" << ((uint32_t)xval) << ") != " << #y << " (" << ((uint32_t)yval) << ")" << std::endl; exit(1); } } while(0)
@@ -520,6 +525,2214 @@ static std::vector<section_tests> section_tests = {
 			},
 		},
 	},
+	{
+		.name = "Section 3: (10 pts) Memory geometry is configured at runtime with MM_Init().",
+		.tests = {
+			{
+				.name = "Unsupported geometries should be rejected",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 17;
+					FAIL_IF(MM_Init(&config) == 0);
+					MM_DefaultConfig(&config);
+					config.physical_memory_size_bytes += 1;
+					FAIL_IF(MM_Init(&config) == 0);
+					MM_DefaultConfig(&config);
+					config.process_virtual_memory_size_shift = 20;
+					FAIL_IF(MM_Init(&config) == 0);
+					MM_DefaultConfig(&config);
+					config.max_processes = 0;
+					FAIL_IF(MM_Init(&config) == 0);
+					FAIL_UNLESS_EQ(MM_Init(NULL), 0);
+					return true;
+				},
+			},
+			{
+				.name = "64 KiB pages in a gigabyte of physical memory should retain values",
+				.points = 3,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 16;
+					config.physical_memory_size_bytes = 1ull << 30;
+					config.process_virtual_memory_size_shift = 30;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					std::map<uint32_t, uint8_t> writes;
+					for (uint32_t addr = 0; addr < (1u << 30); addr += (1u << 24) + 12345) {
+						struct MM_MapResult mr = MM_Map(0, addr, 1);
+						print_mapresult(mr);
+						FAIL_UNLESS_EQ(mr.error, 0);
+						uint8_t value = rand() % 256;
+						FAIL_IF(MM_StoreByte(0, addr, value) != 0);
+						writes[addr] = value;
+					}
+					for (auto [addr, want] : writes) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(0, addr, &got) != 0);
+						FAIL_UNLESS_EQ(got, want);
+					}
+					uint8_t value;
+					FAIL_IF(MM_LoadByte(0, 1u << 30, &value) == 0);
+					return true;
+				},
+			},
+			{
+				.name = "Thousands of pids should each keep their own values",
+				.points = 3,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 12;
+					config.physical_memory_size_bytes = 8192ull << 12;
+					config.process_virtual_memory_size_shift = 20;
+					config.max_processes = 4096;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					for (int pid = 0; pid < 4096; pid++) {
+						struct MM_MapResult mr = MM_Map(pid, 0x1234, 1);
+						print_mapresult(mr);
+						FAIL_UNLESS_EQ(mr.error, 0);
+						FAIL_IF(MM_StoreByte(pid, 0x1234, (uint8_t)(pid * 7)) != 0);
+					}
+					for (int pid = 0; pid < 4096; pid++) {
+						uint8_t value;
+						FAIL_IF(MM_LoadByte(pid, 0x1234, &value) != 0);
+						FAIL_UNLESS_EQ(value, (uint8_t)(pid * 7));
+					}
+					struct MM_MapResult mr = MM_Map(4096, 0, 1);
+					print_mapresult(mr);
+					FAIL_IF(!mr.error);
+					return true;
+				},
+			},
+			{
+				.name = "Swapping with a non-default geometry should retain values",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 8;
+					config.physical_memory_size_bytes = 4 << 8;
+					config.process_virtual_memory_size_shift = 12;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+					std::map<std::tuple<int, uint32_t>, uint8_t> writes;
+					for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+						for (uint32_t addr = 0; addr < (1u << 12); addr += 256) {
+							FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+						}
+					}
+					srand(1337);
+					for (int i = 0; i < 2000; i++) {
+						int pid = rand() % MM_MAX_PROCESSES;
+						uint32_t addr = rand() % (1u << 12);
+						uint8_t value = rand() % 256;
+						FAIL_IF(MM_StoreByte(pid, addr, value) != 0);
+						writes[{pid, addr}] = value;
+					}
+					for (auto [key, want] : writes) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(std::get<0>(key), std::get<1>(key), &got) != 0);
+						FAIL_UNLESS_EQ(got, want);
+					}
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 4: (10 pts) Multi-level page tables support large virtual address spaces.",
+		.tests = {
+			{
+				.name = "Too few levels for the address space should be rejected",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 12;
+					config.physical_memory_size_bytes = 64 << 12;
+					config.process_virtual_memory_size_shift = 48;
+					config.page_table_levels = 3;
+					FAIL_IF(MM_Init(&config) == 0);
+					config.page_table_levels = 4;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					return true;
+				},
+			},
+			{
+				.name = "Sparse writes across a 48 bit address space should retain values",
+				.points = 4,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 12;
+					config.physical_memory_size_bytes = 256 << 12;
+					config.process_virtual_memory_size_shift = 48;
+					config.page_table_levels = 4;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					std::map<uint64_t, uint8_t> writes;
+					for (int i = 0; i < 32; i++) {
+						uint64_t addr = ((uint64_t)rand() << 17 ^ (uint64_t)rand()) & ((1ull << 48) - 1);
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+						uint8_t value = rand() % 256;
+						FAIL_IF(MM_StoreByte(0, addr, value) != 0);
+						writes[addr] = value;
+					}
+					for (auto [addr, want] : writes) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(0, addr, &got) != 0);
+						FAIL_UNLESS_EQ(got, want);
+					}
+					uint8_t value;
+					FAIL_IF(MM_LoadByte(0, 1ull << 48, &value) == 0);
+					return true;
+				},
+			},
+			{
+				.name = "Page tables swapped out under memory pressure should come back",
+				.points = 4,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 8;
+					config.physical_memory_size_bytes = 8 << 8;
+					config.process_virtual_memory_size_shift = 32;
+					config.page_table_levels = 4;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+					std::vector<std::tuple<int, uint64_t>> pages;
+					for (int pid = 0; pid < 2; pid++) {
+						for (int i = 0; i < 16; i++) {
+							uint64_t addr = ((uint64_t)rand() << 8) & 0xffffff00ull;
+							FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+							pages.push_back({pid, addr});
+						}
+					}
+					std::map<std::tuple<int, uint64_t>, uint8_t> writes;
+					srand(1337);
+					for (int i = 0; i < 2000; i++) {
+						auto [pid, page] = pages[rand() % pages.size()];
+						uint64_t addr = page + rand() % 256;
+						uint8_t value = rand() % 256;
+						FAIL_IF(MM_StoreByte(pid, addr, value) != 0);
+						writes[{pid, addr}] = value;
+					}
+					for (auto [key, want] : writes) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(std::get<0>(key), std::get<1>(key), &got) != 0);
+						FAIL_UNLESS_EQ(got, want);
+					}
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 5: (6 pts) The software TLB never returns a stale translation.",
+		.tests = {
+			{
+				.name = "Remapping a cached page read-only should make stores fail",
+				.points = 2,
+				.runtest = [](){
+					FAIL_UNLESS_EQ(MM_Map(0, addrN(2,0), 1).error, 0);
+					FAIL_IF(MM_StoreByte(0, addrN(2,2), 0xaa) != 0);
+					FAIL_IF(MM_StoreByte(0, addrN(2,3), 0xbb) != 0);
+					FAIL_UNLESS_EQ(MM_Map(0, addrN(2,0), 0).error, 0);
+					FAIL_IF(MM_StoreByte(0, addrN(2,2), 0xcc) == 0);
+					uint8_t value;
+					FAIL_IF(MM_LoadByte(0, addrN(2,2), &value) != 0);
+					FAIL_UNLESS_EQ(value, 0xaa);
+					return true;
+				},
+			},
+			{
+				.name = "Small TLBs should retain values while pages are swapped",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					for (int ways : {1, 2}) {
+						config.tlb_entries = 2;
+						config.tlb_associativity = ways;
+						FAIL_UNLESS_EQ(MM_Init(&config), 0);
+						MM_SwapOn();
+						for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+							for (int addr = 0; addr < MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES; addr += MM_PAGE_SIZE_BYTES) {
+								FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+							}
+						}
+						std::map<std::tuple<int, uint32_t>, uint8_t> writes;
+						srand(1337);
+						for (int i = 0; i < 5000; i++) {
+							int pid = rand() % MM_MAX_PROCESSES;
+							uint32_t addr = rand() % MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES;
+							uint8_t value = rand() % 256;
+							FAIL_IF(MM_StoreByte(pid, addr, value) != 0);
+							writes[{pid, addr}] = value;
+							uint8_t got;
+							FAIL_IF(MM_LoadByte(pid, addr, &got) != 0);
+							FAIL_UNLESS_EQ(got, value);
+						}
+						for (auto [key, want] : writes) {
+							uint8_t got;
+							FAIL_IF(MM_LoadByte(std::get<0>(key), std::get<1>(key), &got) != 0);
+							FAIL_UNLESS_EQ(got, want);
+						}
+					}
+					return true;
+				},
+			},
+			{
+				.name = "TLB sizes that aren't powers of two should be rejected",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.tlb_entries = 48;
+					FAIL_IF(MM_Init(&config) == 0);
+					config.tlb_entries = 16;
+					config.tlb_associativity = 3;
+					FAIL_IF(MM_Init(&config) == 0);
+					config.tlb_associativity = 32;
+					FAIL_IF(MM_Init(&config) == 0);
+					config.tlb_entries = 0;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 6: (9 pts) Every replacement policy keeps memory consistent.",
+		.tests = {
+			{
+				.name = "Multi-pid stress test under every replacement policy",
+				.points = 4,
+				.runtest = [](){
+					for (int policy = MM_POLICY_SIMPLE; policy <= MM_POLICY_OPT; policy++) {
+						struct MM_Config config;
+						MM_DefaultConfig(&config);
+						config.page_size_bits = 6;
+						config.physical_memory_size_bytes = 8 << 6;
+						config.process_virtual_memory_size_shift = 12;
+						config.page_table_levels = 2;
+						config.replacement_policy = (enum MM_ReplacementPolicy)policy;
+						FAIL_UNLESS_EQ(MM_Init(&config), 0);
+						MM_SwapOn();
+
+						std::vector<struct MM_Access> future;
+						srand(1337);
+						for (int i = 0; i < 3000; i++) {
+							future.push_back({rand() % MM_MAX_PROCESSES, (uint64_t)(rand() % (1 << 12))});
+						}
+						for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+							for (uint32_t addr = 0; addr < (1u << 12); addr += 64) {
+								FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+							}
+						}
+						FAIL_UNLESS_EQ(MM_SetOracle(future.data(), future.size()), 0);
+
+						std::map<std::tuple<int, uint64_t>, uint8_t> writes;
+						for (size_t i = 0; i < future.size(); i++) {
+							auto [pid, addr] = future[i];
+							if (i % 3 == 0) {
+								uint8_t got;
+								uint8_t want = writes.count({pid, addr}) ? writes[{pid, addr}] : 0;
+								FAIL_IF(MM_LoadByte(pid, addr, &got) != 0);
+								FAIL_UNLESS_EQ(got, want);
+							} else {
+								uint8_t value = rand() % 256;
+								FAIL_IF(MM_StoreByte(pid, addr, value) != 0);
+								writes[{pid, addr}] = value;
+							}
+						}
+					}
+					return true;
+				},
+			},
+			{
+				.name = "Switching policies mid-run should retain values",
+				.points = 2,
+				.runtest = [](){
+					MM_SwapOn();
+					for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+						for (int addr = 0; addr < MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES; addr += MM_PAGE_SIZE_BYTES) {
+							FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+						}
+					}
+					std::map<std::tuple<int, uint32_t>, uint8_t> writes;
+					srand(1337);
+					for (int i = 0; i < 9000; i++) {
+						if (i % 1000 == 0) {
+							FAIL_UNLESS_EQ(MM_SetReplacementPolicy((enum MM_ReplacementPolicy)(i / 1000)), 0);
+						}
+						int pid = rand() % MM_MAX_PROCESSES;
+						uint32_t addr = rand() % MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES;
+						uint8_t value = rand() % 256;
+						FAIL_IF(MM_StoreByte(pid, addr, value) != 0);
+						writes[{pid, addr}] = value;
+					}
+					for (auto [key, want] : writes) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(std::get<0>(key), std::get<1>(key), &got) != 0);
+						FAIL_UNLESS_EQ(got, want);
+					}
+					return true;
+				},
+			},
+			{
+				.name = "Unknown policies should be rejected",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.replacement_policy = (enum MM_ReplacementPolicy)100;
+					FAIL_IF(MM_Init(&config) == 0);
+					FAIL_UNLESS_EQ(MM_Init(NULL), 0);
+					FAIL_IF(MM_SetReplacementPolicy((enum MM_ReplacementPolicy)100) == 0);
+					FAIL_UNLESS_EQ(MM_Map(0, 0, 1).error, 0);
+					return true;
+				},
+			},
+			{
+				.name = "The simple policy should evict a lone pid's last page, as it always has",
+				.points = 1,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 8 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					for (uint32_t addr = 0; addr < 16 * 64; addr += 64) {
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+						FAIL_IF(MM_StoreByte(0, addr, (uint8_t)(addr / 64 + 1)) != 0);
+					}
+
+					// The first pages brought in were never picked, only the ones after them
+					std::vector<uint64_t> addrs = {0, 64, 14 * 64};
+					std::vector<uint64_t> phys(addrs.size());
+					std::vector<uint8_t> status(addrs.size());
+					FAIL_UNLESS_EQ(MM_TranslateBatch(0, addrs.data(), addrs.size(), phys.data(), status.data()), 3);
+					FAIL_UNLESS_EQ(status[0], MM_TRANSLATE_HIT);
+					FAIL_UNLESS_EQ(status[1], MM_TRANSLATE_HIT);
+					FAIL_UNLESS_EQ(status[2], MM_TRANSLATE_FAULTED);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 7: (4 pts) Frame allocation and eviction keep up with large physical memories.",
+		.tests = {
+			{
+				.name = "Filling and then thrashing a quarter million frames should finish in time",
+				.points = 4,
+				.runtest = [](){
+					for (int policy = MM_POLICY_SIMPLE; policy <= MM_POLICY_OPT; policy += MM_POLICY_OPT - MM_POLICY_SIMPLE) {
+						struct MM_Config config;
+						MM_DefaultConfig(&config);
+						config.page_size_bits = 8;
+						config.physical_memory_size_bytes = (uint64_t)1 << 26;
+						config.process_virtual_memory_size_shift = 28;
+						config.page_table_levels = 4;
+						config.replacement_policy = (enum MM_ReplacementPolicy)policy;
+						FAIL_UNLESS_EQ(MM_Init(&config), 0);
+
+						// Without swap, mapping stops once every frame is in use
+						uint64_t mapped = 0;
+						while (MM_Map(0, mapped << 8, 1).error == 0) {
+							FAIL_IF(MM_StoreByte(0, mapped << 8, (uint8_t)mapped) != 0);
+							mapped++;
+						}
+						FAIL_IF(mapped < (1 << 18) - (1 << 14));
+
+						// With swap on, every new page has to eject one
+						MM_SwapOn();
+						for (uint64_t vpn = mapped; vpn < mapped + (1 << 14); vpn++) {
+							FAIL_UNLESS_EQ(MM_Map(1, vpn << 8, 1).error, 0);
+							FAIL_IF(MM_StoreByte(1, vpn << 8, (uint8_t)vpn) != 0);
+						}
+						for (uint64_t vpn = 0; vpn < mapped; vpn += 4099) {
+							uint8_t got;
+							FAIL_IF(MM_LoadByte(0, vpn << 8, &got) != 0);
+							FAIL_UNLESS_EQ(got, (uint8_t)vpn);
+						}
+					}
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 8: (4 pts) Swap I/O moves whole pages, through the page cache or around it.",
+		.tests = {
+			{
+				.name = "Random stores should survive swapping with and without direct I/O",
+				.points = 4,
+				.runtest = [](){
+					for (int page_size_bits : {4, 12}) {
+						for (int direct : {0, 1}) {
+							struct MM_Config config;
+							MM_DefaultConfig(&config);
+							config.page_size_bits = page_size_bits;
+							config.physical_memory_size_bytes = 4 << page_size_bits;
+							config.process_virtual_memory_size_shift = page_size_bits + 6;
+							config.page_table_levels = 2;
+							config.swap_direct_io = direct;
+							FAIL_UNLESS_EQ(MM_Init(&config), 0);
+							MM_SwapOn();
+
+							uint64_t size = (uint64_t)1 << config.process_virtual_memory_size_shift;
+							for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+								for (uint64_t addr = 0; addr < size; addr += (1 << page_size_bits)) {
+									FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+								}
+							}
+							std::map<std::tuple<int, uint64_t>, uint8_t> writes;
+							srand(1337);
+							for (int i = 0; i < 2000; i++) {
+								int pid = rand() % MM_MAX_PROCESSES;
+								uint64_t addr = rand() % size;
+								uint8_t value = rand() % 256;
+								FAIL_IF(MM_StoreByte(pid, addr, value) != 0);
+								writes[{pid, addr}] = value;
+							}
+							for (auto [key, want] : writes) {
+								uint8_t got;
+								FAIL_IF(MM_LoadByte(std::get<0>(key), std::get<1>(key), &got) != 0);
+								FAIL_UNLESS_EQ(got, want);
+							}
+						}
+					}
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 9: (6 pts) One swap device holds every process' pages, sized by what's swapped out.",
+		.tests = {
+			{
+				.name = "A thousand processes should share one small swap file",
+				.points = 3,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 8;
+					config.physical_memory_size_bytes = 16 << 8;
+					config.process_virtual_memory_size_shift = 24;
+					config.page_table_levels = 3;
+					config.max_processes = 1024;
+					config.swap_path = "tests.out/swap.img";
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					// Each process touches one page near the bottom and one near the top
+					for (int pid = 0; pid < 1024; pid++) {
+						FAIL_UNLESS_EQ(MM_Map(pid, 0, 1).error, 0);
+						FAIL_UNLESS_EQ(MM_Map(pid, (1 << 24) - 1, 1).error, 0);
+						FAIL_IF(MM_StoreByte(pid, 0, (uint8_t)pid) != 0);
+						FAIL_IF(MM_StoreByte(pid, (1 << 24) - 1, (uint8_t)(pid * 7)) != 0);
+					}
+					for (int pid = 0; pid < 1024; pid++) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(pid, 0, &got) != 0);
+						FAIL_UNLESS_EQ(got, (uint8_t)pid);
+						FAIL_IF(MM_LoadByte(pid, (1 << 24) - 1, &got) != 0);
+						FAIL_UNLESS_EQ(got, (uint8_t)(pid * 7));
+					}
+
+					// At most two data pages and five tables per process were ever swapped out
+					struct stat st;
+					FAIL_UNLESS_EQ(stat("tests.out/swap.img", &st), 0);
+					FAIL_IF(st.st_size > 1024 * 7 * 256);
+					return true;
+				},
+			},
+			{
+				.name = "Stale slots should be reused, and a full swap device should fail cleanly",
+				.points = 3,
+				.runtest = [](){
+					// Every page of every process can be swapped out at once, but only just
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.swap_size_bytes = MM_MAX_PROCESSES * (MM_NUM_PTES + 1) * MM_PAGE_SIZE_BYTES;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+						for (int addr = 0; addr < MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES; addr += MM_PAGE_SIZE_BYTES) {
+							FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+						}
+					}
+					std::map<std::tuple<int, uint32_t>, uint8_t> writes;
+					srand(1337);
+					for (int i = 0; i < 5000; i++) {
+						int pid = rand() % MM_MAX_PROCESSES;
+						uint32_t addr = rand() % MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES;
+						uint8_t value = rand() % 256;
+						FAIL_IF(MM_StoreByte(pid, addr, value) != 0);
+						writes[{pid, addr}] = value;
+					}
+					for (auto [key, want] : writes) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(std::get<0>(key), std::get<1>(key), &got) != 0);
+						FAIL_UNLESS_EQ(got, want);
+					}
+
+					// With room for only two pages, storing everywhere has to fail at some point
+					config.swap_size_bytes = 2 * MM_PAGE_SIZE_BYTES;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+					writes.clear();
+					int failures = 0;
+					for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+						if (MM_Map(pid, 0, 1).error == 0 && MM_StoreByte(pid, 0, (uint8_t)(pid + 1)) == 0) {
+							writes[{pid, 0}] = pid + 1;
+						} else {
+							failures++;
+						}
+					}
+					FAIL_IF(failures == 0);
+					for (auto [key, want] : writes) {
+						uint8_t got;
+						if (MM_LoadByte(std::get<0>(key), std::get<1>(key), &got) == 0) {
+							FAIL_UNLESS_EQ(got, want);
+						}
+					}
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 10: (8 pts) Swap I/O can run in the background, and faults can be overlapped.",
+		.tests = {
+			{
+				.name = "Random stores should survive swapping through worker threads",
+				.points = 3,
+				.runtest = [](){
+					for (int direct : {0, 1}) {
+						struct MM_Config config;
+						MM_DefaultConfig(&config);
+						config.page_size_bits = 6;
+						config.physical_memory_size_bytes = 6 << 6;
+						config.process_virtual_memory_size_shift = 12;
+						config.page_table_levels = 2;
+						config.swap_direct_io = direct;
+						config.swap_io_threads = 4;
+						FAIL_UNLESS_EQ(MM_Init(&config), 0);
+						MM_SwapOn();
+
+						for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+							for (uint32_t addr = 0; addr < (1u << 12); addr += 64) {
+								FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+							}
+						}
+						std::map<std::tuple<int, uint64_t>, uint8_t> writes;
+						srand(1337);
+						for (int i = 0; i < 5000; i++) {
+							int pid = rand() % MM_MAX_PROCESSES;
+							uint64_t addr = rand() % (1 << 12);
+							if (i % 3 == 0) {
+								uint8_t got;
+								uint8_t want = writes.count({pid, addr}) ? writes[{pid, addr}] : 0;
+								FAIL_IF(MM_LoadByte(pid, addr, &got) != 0);
+								FAIL_UNLESS_EQ(got, want);
+							} else {
+								uint8_t value = rand() % 256;
+								FAIL_IF(MM_StoreByte(pid, addr, value) != 0);
+								writes[{pid, addr}] = value;
+							}
+						}
+					}
+					return true;
+				},
+			},
+			{
+				.name = "Asynchronous faults should complete with the right data",
+				.points = 3,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 16 << 6;
+					config.process_virtual_memory_size_shift = 10;
+					config.page_table_levels = 2;
+					config.swap_io_threads = 2;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					FAIL_UNLESS_EQ(MM_FaultAsync(0, 0), -1);
+					for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+						for (uint32_t addr = 0; addr < (1u << 10); addr += 64) {
+							FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+							FAIL_IF(MM_StoreByte(pid, addr, (uint8_t)(pid * 16 + addr / 64)) != 0);
+						}
+					}
+
+					// Pages of pids 1-3 are brought in while pid 0 keeps working
+					for (int round = 0; round < 4; round++) {
+						int started = 0;
+						for (int pid = 1; pid < MM_MAX_PROCESSES; pid++) {
+							int ret = MM_FaultAsync(pid, (round * 4 + pid) * 64);
+							FAIL_IF(ret < 0);
+							started += ret;
+						}
+						for (uint32_t addr = 0; addr < 4 * 64; addr += 64) {
+							uint8_t got;
+							FAIL_IF(MM_LoadByte(0, addr, &got) != 0);
+							FAIL_UNLESS_EQ(got, addr / 64);
+						}
+						struct MM_Access done[8];
+						int completed = 0;
+						while (completed < started) {
+							int n = MM_FaultComplete(done, 8, 1);
+							FAIL_IF(n <= 0);
+							for (int i = 0; i < n; i++) {
+								uint8_t got;
+								FAIL_IF(MM_LoadByte(done[i].pid, done[i].address, &got) != 0);
+								FAIL_UNLESS_EQ(got, done[i].pid * 16 + done[i].address / 64);
+							}
+							completed += n;
+						}
+					}
+
+					// Touching a page that's on its way in waits for it
+					FAIL_IF(MM_FaultAsync(2, 15 * 64) < 0);
+					uint8_t got;
+					FAIL_IF(MM_LoadByte(2, 15 * 64, &got) != 0);
+					FAIL_UNLESS_EQ(got, 2 * 16 + 15);
+					struct MM_Access done[1];
+					FAIL_UNLESS_EQ(MM_FaultComplete(done, 1, 1), 0);
+					return true;
+				},
+			},
+			{
+				.name = "Pages whose background writes fail should never read back wrong",
+				.points = 2,
+				.runtest = [](){
+					// Every write to /dev/full fails, so no page makes it out to swap. Those pages
+					// have to keep reading back right from their write buffers, and once there are
+					// too many of them, faults have to fail rather than read back stale data
+					if (access("/dev/full", W_OK) != 0) return true;
+
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 8 << 6;
+					config.process_virtual_memory_size_shift = 14;
+					config.page_table_levels = 2;
+					config.swap_io_threads = 1;
+					config.swap_path = "/dev/full";
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					std::map<uint64_t, uint8_t> stored;
+					std::set<uint64_t> unmapped;
+					int failures = 0;
+					for (int round = 0; round < 2; round++) {
+						for (uint64_t vpn = 0; vpn < 200; vpn++) {
+							uint64_t addr = vpn << 6;
+							// Mapping can need a frame for a page table, which can fail like any fault
+							if (round == 0 && MM_Map(0, addr, 1).error != 0) {
+								failures++;
+								unmapped.insert(vpn);
+							}
+							if (unmapped.count(vpn)) continue;
+
+							uint8_t got;
+							if (MM_LoadByte(0, addr, &got) != 0) {
+								failures++;
+								continue;
+							}
+							FAIL_UNLESS_EQ(got, stored.count(vpn) ? stored[vpn] : 0);
+
+							uint8_t value = (uint8_t)(vpn * 7 + round + 1);
+							if (MM_StoreByte(0, addr, value) == 0) {
+								stored[vpn] = value;
+							} else {
+								failures++;
+							}
+						}
+					}
+					FAIL_IF(failures == 0);
+					MM_Init(NULL);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 11: (5 pts) Dirty pages are written back ahead of time once free frames run low.",
+		.tests = {
+			{
+				.name = "Dirty pages should reach swap before anything is ejected",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 16 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					config.writeback_low_watermark = 4;
+					config.writeback_high_watermark = 8;
+					config.swap_path = "tests.out/writeback.img";
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					// Two tables and twelve data pages leave two frames free, which is under the low
+					// watermark, but nothing has had to be ejected
+					for (uint32_t addr = 0; addr < 12 * 64; addr += 64) {
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+						FAIL_IF(MM_StoreByte(0, addr, (uint8_t)(addr / 64 + 1)) != 0);
+					}
+					FAIL_UNLESS_EQ(MM_Map(0, 12 * 64, 1).error, 0);
+
+					// The writes happen in the background, so give them a moment
+					struct stat st;
+					for (int tries = 0; tries < 1000; tries++) {
+						if (stat("tests.out/writeback.img", &st) == 0 && st.st_size > 0) break;
+						usleep(1000);
+					}
+					FAIL_IF(stat("tests.out/writeback.img", &st) != 0 || st.st_size == 0);
+
+					for (uint32_t addr = 0; addr < 12 * 64; addr += 64) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(0, addr, &got) != 0);
+						FAIL_UNLESS_EQ(got, addr / 64 + 1);
+					}
+					return true;
+				},
+			},
+			{
+				.name = "Random stores should survive swapping with writeback on",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 12 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					config.writeback_low_watermark = 3;
+					config.writeback_high_watermark = 6;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+						for (uint32_t addr = 0; addr < (1u << 12); addr += 64) {
+							FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+						}
+					}
+					std::map<std::tuple<int, uint64_t>, uint8_t> writes;
+					srand(1337);
+					for (int i = 0; i < 5000; i++) {
+						int pid = rand() % MM_MAX_PROCESSES;
+						uint64_t addr = rand() % (1 << 12);
+						if (i % 3 == 0) {
+							uint8_t got;
+							uint8_t want = writes.count({pid, addr}) ? writes[{pid, addr}] : 0;
+							FAIL_IF(MM_LoadByte(pid, addr, &got) != 0);
+							FAIL_UNLESS_EQ(got, want);
+						} else {
+							uint8_t value = rand() % 256;
+							FAIL_IF(MM_StoreByte(pid, addr, value) != 0);
+							writes[{pid, addr}] = value;
+						}
+					}
+					return true;
+				},
+			},
+			{
+				.name = "Watermarks out of range should be rejected",
+				.points = 1,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.writeback_low_watermark = 3;
+					config.writeback_high_watermark = 2;
+					FAIL_IF(MM_Init(&config) == 0);
+					config.writeback_high_watermark = MM_PHYSICAL_PAGES + 1;
+					FAIL_IF(MM_Init(&config) == 0);
+					config.writeback_high_watermark = MM_PHYSICAL_PAGES;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 12: (5 pts) Pages along a sequential or strided fault pattern are read ahead.",
+		.tests = {
+			{
+				.name = "A sequential scan should bring in the next pages before they're used",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 16 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					config.readahead_max_pages = 4;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					// Enough pages that the first few end up in swap
+					for (uint32_t addr = 0; addr < 40 * 64; addr += 64) {
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+						FAIL_IF(MM_StoreByte(0, addr, (uint8_t)(addr / 64 + 1)) != 0);
+					}
+
+					// Pages 0, 1 and 2 set the stride, so 3 and 4 get read ahead. Using 3 finishes 4
+					for (uint32_t page = 0; page < 4; page++) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(0, page * 64, &got) != 0);
+						FAIL_UNLESS_EQ(got, page + 1);
+					}
+					FAIL_UNLESS_EQ(MM_FaultAsync(0, 4 * 64), 0);
+
+					for (uint32_t page = 4; page < 40; page++) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(0, page * 64, &got) != 0);
+						FAIL_UNLESS_EQ(got, page + 1);
+					}
+					return true;
+				},
+			},
+			{
+				.name = "A strided scan should bring in pages along the stride",
+				.points = 1,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 16 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					config.readahead_max_pages = 4;
+					config.replacement_policy = MM_POLICY_FIFO;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					for (uint32_t addr = 0; addr < 40 * 64; addr += 64) {
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+						FAIL_IF(MM_StoreByte(0, addr, (uint8_t)(addr / 64 + 1)) != 0);
+					}
+
+					for (uint32_t page = 0; page <= 9; page += 3) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(0, page * 64, &got) != 0);
+						FAIL_UNLESS_EQ(got, page + 1);
+					}
+					FAIL_UNLESS_EQ(MM_FaultAsync(0, 12 * 64), 0);
+
+					uint8_t got;
+					FAIL_IF(MM_LoadByte(0, 12 * 64, &got) != 0);
+					FAIL_UNLESS_EQ(got, 13);
+					return true;
+				},
+			},
+			{
+				.name = "Random stores should survive swapping with readahead and io threads",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 12 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					config.readahead_max_pages = 16;
+					config.swap_io_threads = 2;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+						for (uint32_t addr = 0; addr < (1u << 12); addr += 64) {
+							FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+						}
+					}
+					// Runs of sequential accesses keep readahead busy between the random ones
+					std::map<std::tuple<int, uint64_t>, uint8_t> writes;
+					srand(1337);
+					for (int i = 0; i < 5000; i++) {
+						int pid = rand() % MM_MAX_PROCESSES;
+						uint64_t addr = rand() % (1 << 12);
+						if (i % 5 == 0) {
+							for (uint64_t a = addr; a < (1 << 12) && a < addr + 8 * 64; a += 64) {
+								uint8_t got;
+								uint8_t want = writes.count({pid, a}) ? writes[{pid, a}] : 0;
+								FAIL_IF(MM_LoadByte(pid, a, &got) != 0);
+								FAIL_UNLESS_EQ(got, want);
+							}
+						} else if (i % 3 == 0) {
+							uint8_t got;
+							uint8_t want = writes.count({pid, addr}) ? writes[{pid, addr}] : 0;
+							FAIL_IF(MM_LoadByte(pid, addr, &got) != 0);
+							FAIL_UNLESS_EQ(got, want);
+						} else {
+							uint8_t value = rand() % 256;
+							FAIL_IF(MM_StoreByte(pid, addr, value) != 0);
+							writes[{pid, addr}] = value;
+						}
+					}
+
+					config.readahead_max_pages = 17;
+					FAIL_IF(MM_Init(&config) == 0);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 13: (5 pts) Ranges of bytes are copied in and out a page at a time.",
+		.tests = {
+			{
+				.name = "Ranges that cross pages should read back what was written while swapping",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 12 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					std::vector<uint8_t> mirror[2];
+					for (int pid = 0; pid < 2; pid++) {
+						mirror[pid].assign(1 << 12, 0);
+						for (uint32_t addr = 0; addr < (1u << 12); addr += 64) {
+							FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+						}
+					}
+
+					srand(1337);
+					uint8_t buf[256];
+					for (int i = 0; i < 2000; i++) {
+						int pid = rand() % 2;
+						size_t len = rand() % sizeof(buf);
+						uint64_t addr = rand() % ((1 << 12) - len + 1);
+						if (i % 2 == 0) {
+							for (size_t j = 0; j < len; j++) buf[j] = rand() % 256;
+							FAIL_UNLESS_EQ(MM_Write(pid, addr, buf, len), 0);
+							memcpy(&mirror[pid][addr], buf, len);
+						} else {
+							FAIL_UNLESS_EQ(MM_Read(pid, addr, buf, len), 0);
+							FAIL_IF(memcmp(&mirror[pid][addr], buf, len) != 0);
+						}
+					}
+
+					// The bytes should line up with the single byte accessors too
+					for (uint64_t addr = 0; addr < (1 << 12); addr += 7) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(1, addr, &got) != 0);
+						FAIL_UNLESS_EQ(got, mirror[1][addr]);
+					}
+					return true;
+				},
+			},
+			{
+				.name = "Ranges out of bounds or over read only pages should fail",
+				.points = 1,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 12 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+
+					uint8_t buf[128] = {1};
+					FAIL_UNLESS_EQ(MM_Map(0, 0, 1).error, 0);
+					FAIL_UNLESS_EQ(MM_Map(0, 64, 0).error, 0);
+					FAIL_UNLESS_EQ(MM_Write(0, 0, buf, 64), 0);
+					FAIL_IF(MM_Write(0, 32, buf, 64) == 0);
+					FAIL_UNLESS_EQ(MM_Read(0, 32, buf, 64), 0);
+					FAIL_IF(MM_Read(0, (1 << 12) - 64, buf, 65) == 0);
+					FAIL_IF(MM_Read(0, UINT64_MAX, buf, 2) == 0);
+					FAIL_IF(MM_Read(MM_MAX_PROCESSES, 0, buf, 1) == 0);
+					FAIL_UNLESS_EQ(MM_Read(0, 1 << 12, buf, 0), 0);
+					return true;
+				},
+			},
+			{
+				.name = "Copying 64 MiB through a large memory should finish in time",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 12;
+					config.physical_memory_size_bytes = (uint64_t)1 << 26;
+					config.process_virtual_memory_size_shift = 28;
+					config.page_table_levels = 3;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+
+					const uint64_t size = (uint64_t)1 << 24;
+					for (uint64_t addr = 0; addr < size; addr += 1 << 12) {
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+					}
+
+					std::vector<uint8_t> buf(1 << 16), got(1 << 16);
+					for (int pass = 0; pass < 4; pass++) {
+						for (uint64_t addr = 0; addr < size; addr += buf.size()) {
+							for (size_t j = 0; j < buf.size(); j += 4096) buf[j] = (uint8_t)(addr + j + pass);
+							FAIL_UNLESS_EQ(MM_Write(0, addr, buf.data(), buf.size()), 0);
+							FAIL_UNLESS_EQ(MM_Read(0, addr, got.data(), got.size()), 0);
+							FAIL_IF(memcmp(buf.data(), got.data(), buf.size()) != 0);
+						}
+					}
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 14: (5 pts) Words are loaded and stored whole, in either byte order.",
+		.tests = {
+			{
+				.name = "Words in and across pages should read back in the chosen byte order",
+				.points = 2,
+				.runtest = [](){
+					for (int endianness : {MM_LITTLE_ENDIAN, MM_BIG_ENDIAN}) {
+						struct MM_Config config;
+						MM_DefaultConfig(&config);
+						config.page_size_bits = 4;
+						config.physical_memory_size_bytes = 6 << 4;
+						config.process_virtual_memory_size_shift = 8;
+						config.page_table_levels = 2;
+						config.endianness = (enum MM_Endianness)endianness;
+						FAIL_UNLESS_EQ(MM_Init(&config), 0);
+						MM_SwapOn();
+
+						for (uint32_t addr = 0; addr < (1u << 8); addr += 16) {
+							FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+						}
+
+						// 14 puts a 64 bit value across two pages, 16 is aligned
+						for (uint64_t addr : {14, 16}) {
+							FAIL_UNLESS_EQ(MM_Store64(0, addr, 0x0102030405060708ull), 0);
+							for (int i = 0; i < 8; i++) {
+								uint8_t got;
+								FAIL_IF(MM_LoadByte(0, addr + i, &got) != 0);
+								FAIL_UNLESS_EQ(got, endianness == MM_LITTLE_ENDIAN ? 8 - i : i + 1);
+							}
+						}
+
+						// Every alignment, with enough pages touched in between to swap them out
+						srand(1337);
+						for (uint64_t addr = 0; addr + 8 <= (1 << 8); addr += 5) {
+							uint64_t value = ((uint64_t)rand() << 32) | rand();
+							FAIL_UNLESS_EQ(MM_Store16(0, addr, (uint16_t)value), 0);
+							uint16_t got16;
+							FAIL_UNLESS_EQ(MM_Load16(0, addr, &got16), 0);
+							FAIL_UNLESS_EQ(got16, (uint16_t)value);
+							FAIL_UNLESS_EQ(MM_Store32(0, addr, (uint32_t)value), 0);
+							uint32_t got32;
+							FAIL_UNLESS_EQ(MM_Load32(0, addr, &got32), 0);
+							FAIL_UNLESS_EQ(got32, (uint32_t)value);
+							FAIL_UNLESS_EQ(MM_Store64(0, addr, value), 0);
+							for (uint64_t other = 0; other < (1 << 8); other += 16) {
+								uint8_t byte;
+								FAIL_IF(MM_LoadByte(0, (addr + 8 + other) % (1 << 8), &byte) != 0);
+							}
+							uint64_t got64;
+							FAIL_UNLESS_EQ(MM_Load64(0, addr, &got64), 0);
+							FAIL_UNLESS_EQ(got64, value);
+						}
+					}
+					return true;
+				},
+			},
+			{
+				.name = "A store across into a read only page should change nothing",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 4;
+					config.physical_memory_size_bytes = 6 << 4;
+					config.process_virtual_memory_size_shift = 8;
+					config.page_table_levels = 2;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+
+					FAIL_UNLESS_EQ(MM_Map(0, 0, 1).error, 0);
+					FAIL_UNLESS_EQ(MM_Map(0, 16, 0).error, 0);
+					FAIL_UNLESS_EQ(MM_Store32(0, 8, 0xdeadbeef), 0);
+					FAIL_IF(MM_Store64(0, 12, 0x1122334455667788ull) == 0);
+					FAIL_IF(MM_Store16(0, 16, 0x1122) == 0);
+					uint32_t got;
+					FAIL_UNLESS_EQ(MM_Load32(0, 8, &got), 0);
+					FAIL_UNLESS_EQ(got, 0xdeadbeef);
+					uint64_t got64;
+					FAIL_UNLESS_EQ(MM_Load64(0, 8, &got64), 0);
+					FAIL_UNLESS_EQ(got64, 0xdeadbeefu);
+					FAIL_IF(MM_Load64(0, (1 << 8) - 4, &got64) == 0);
+					FAIL_IF(MM_Store16(0, UINT64_MAX, 0) == 0);
+
+					// Nor should it dirty a writeable page after the read only one, so once that page
+					// has been written out it's never written again
+					MM_SwapOn();
+					FAIL_UNLESS_EQ(MM_Map(0, 32, 0).error, 0);
+					for (uint32_t addr = 48; addr < 144; addr += 16) {
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+					}
+					FAIL_UNLESS_EQ(MM_Store32(0, 48, 0xfeedface), 0);
+					uint8_t byte;
+					for (uint32_t addr = 64; addr < 144; addr += 16) {
+						FAIL_UNLESS_EQ(MM_LoadByte(0, addr, &byte), 0);
+					}
+					struct MM_Stats before;
+					MM_GetStats(&before);
+					FAIL_IF(MM_Store64(0, 44, 0x1122334455667788ull) == 0);
+					for (uint32_t addr = 64; addr < 144; addr += 16) {
+						FAIL_UNLESS_EQ(MM_LoadByte(0, addr, &byte), 0);
+					}
+					struct MM_Stats after;
+					MM_GetStats(&after);
+					FAIL_UNLESS_EQ(after.writebacks, before.writebacks);
+					FAIL_UNLESS_EQ(MM_Load32(0, 48, &got), 0);
+					FAIL_UNLESS_EQ(got, 0xfeedface);
+					return true;
+				},
+			},
+			{
+				.name = "A store across into a page that can't be brought in should change nothing",
+				.points = 1,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 8 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					config.swap_size_bytes = 4 << 6;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					for (uint32_t addr = 0; addr < 16 * 64; addr += 64) {
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+					}
+
+					// Dirty pages until swap is too full to make room for another
+					uint32_t page = 0;
+					FAIL_UNLESS_EQ(MM_Store32(0, 60, 0x01020304), 0);
+					for (;;) {
+						FAIL_IF(page == 14);
+						if (MM_Store32(0, (page + 1) * 64 + 60, 0x01020304) != 0) {
+							break;
+						}
+						page++;
+					}
+
+					// 'page' was just stored to so it's resident, and the one after it never came in
+					FAIL_IF(MM_Store64(0, page * 64 + 60, 0x1122334455667788ull) == 0);
+					uint32_t got;
+					FAIL_UNLESS_EQ(MM_Load32(0, page * 64 + 60, &got), 0);
+					FAIL_UNLESS_EQ(got, 0x01020304u);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 15: (4 pts) Many addresses are translated in one call.",
+		.tests = {
+			{
+				.name = "A batch should translate resident, swapped out and bad addresses",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 16 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					config.swap_io_threads = 2;
+					config.replacement_policy = MM_POLICY_FIFO;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					for (uint32_t addr = 0; addr < 40 * 64; addr += 64) {
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+						FAIL_IF(MM_StoreByte(0, addr, (uint8_t)(addr / 64 + 1)) != 0);
+					}
+
+					// The early pages are in swap, and the last few are resident
+					std::vector<uint64_t> addrs;
+					for (uint64_t page : {0, 1, 2, 3, 37, 38, 39}) addrs.push_back(page * 64 + page);
+					addrs.push_back(1 << 12);
+					std::vector<uint64_t> phys(addrs.size());
+					std::vector<uint8_t> status(addrs.size());
+					int translated = MM_TranslateBatch(0, addrs.data(), addrs.size(), phys.data(), status.data());
+					FAIL_UNLESS_EQ(translated, 7);
+					for (int i = 0; i < 4; i++) FAIL_UNLESS_EQ(status[i], MM_TRANSLATE_FAULTED);
+					for (int i = 4; i < 7; i++) FAIL_UNLESS_EQ(status[i], MM_TRANSLATE_HIT);
+					FAIL_UNLESS_EQ(status[7], MM_TRANSLATE_ERROR);
+
+					std::set<uint64_t> frames;
+					for (int i = 0; i < 7; i++) {
+						FAIL_UNLESS_EQ(phys[i] % 64, addrs[i] % 64);
+						frames.insert(phys[i] / 64);
+					}
+					FAIL_UNLESS_EQ(frames.size(), 7u);
+
+					// Everything that was brought in should still read back
+					for (uint64_t page = 0; page < 40; page++) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(0, page * 64, &got) != 0);
+						FAIL_UNLESS_EQ(got, page + 1);
+					}
+					// A pid with no page table can't translate anything
+					FAIL_UNLESS_EQ(MM_TranslateBatch(1, addrs.data(), addrs.size(), phys.data(), status.data()), 0);
+					FAIL_UNLESS_EQ(MM_TranslateBatch(MM_MAX_PROCESSES, addrs.data(), addrs.size(), phys.data(), status.data()), -1);
+					return true;
+				},
+			},
+			{
+				.name = "A batch bigger than memory should report the pages it had to eject again",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 8 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					std::vector<uint64_t> addrs;
+					for (uint32_t addr = 0; addr < (1u << 12); addr += 64) {
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+						FAIL_IF(MM_StoreByte(0, addr, (uint8_t)(addr / 64)) != 0);
+						addrs.push_back(addr);
+					}
+
+					std::vector<uint64_t> phys(addrs.size());
+					std::vector<uint8_t> status(addrs.size());
+					int translated = MM_TranslateBatch(0, addrs.data(), addrs.size(), phys.data(), status.data());
+					FAIL_IF(translated <= 0 || translated >= 8);
+					int ejected = 0;
+					for (uint8_t st : status) {
+						FAIL_IF(st == MM_TRANSLATE_ERROR);
+						ejected += st == MM_TRANSLATE_EJECTED;
+					}
+					FAIL_UNLESS_EQ(ejected + translated, (int)addrs.size());
+
+					// The last page in the batch was translated last, so it's still there
+					FAIL_IF(status.back() == MM_TRANSLATE_EJECTED);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 16: (4 pts) Threads can drive the memory manager at the same time.",
+		.tests = {
+			{
+				.name = "One thread per pid should only ever see its own stores while swapping",
+				.points = 3,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 24 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					config.swap_io_threads = 2;
+					config.readahead_max_pages = 4;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					std::vector<std::thread> threads;
+					for (int pid = 0; pid < MM_MAX_PROCESSES; pid++) {
+						threads.emplace_back([pid]() {
+							for (uint32_t addr = 0; addr < (1u << 12); addr += 64) {
+								FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+							}
+
+							// Mostly a few hot pages, so the TLB gets hit, with the odd access
+							// anywhere to keep pages moving in and out of swap
+							std::vector<uint8_t> mirror(1 << 12, 0);
+							unsigned int seed = pid;
+							for (int i = 0; i < 20000; i++) {
+								uint64_t addr = rand_r(&seed) % (i % 10 == 0 ? (1 << 12) : 256);
+								if (i % 1000 == 0) {
+									uint8_t buf[512];
+									uint64_t start = addr % ((1 << 12) - sizeof(buf));
+									FAIL_UNLESS_EQ(MM_Read(pid, start, buf, sizeof(buf)), 0);
+									FAIL_IF(memcmp(buf, &mirror[start], sizeof(buf)) != 0);
+								} else if (i % 3 == 0) {
+									uint8_t got;
+									FAIL_IF(MM_LoadByte(pid, addr, &got) != 0);
+									FAIL_UNLESS_EQ(got, mirror[addr]);
+								} else {
+									uint8_t value = rand_r(&seed) % 256;
+									FAIL_IF(MM_StoreByte(pid, addr, value) != 0);
+									mirror[addr] = value;
+								}
+							}
+						});
+					}
+					for (auto &thread : threads) thread.join();
+					return true;
+				},
+			},
+			{
+				.name = "Each thread should get its own MM_Map() message",
+				.points = 1,
+				.runtest = [](){
+					FAIL_UNLESS_EQ(MM_Init(NULL), 0);
+					std::thread bad([]() {
+						for (int i = 0; i < 10000; i++) {
+							FAIL_IF(strcmp(MM_Map(0, MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES, 1).message, "address out of range") != 0);
+						}
+					});
+					for (int i = 0; i < 10000; i++) {
+						FAIL_IF(strcmp(MM_Map(1, 0, 1).message, "success") != 0);
+					}
+					bad.join();
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 17: (5 pts) Loads of cached pages don't take a lock, but never see another page.",
+		.tests = {
+			{
+				.name = "Readers should see the right bytes while another pid keeps ejecting their pages",
+				.points = 3,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 12 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					config.replacement_policy = MM_POLICY_FIFO;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					// Every byte of pid 0's pages says where it lives, so a read from the wrong frame shows
+					for (uint32_t addr = 0; addr < 8 * 64; addr += 64) {
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+					}
+					for (uint32_t addr = 0; addr < 8 * 64; addr++) {
+						FAIL_IF(MM_StoreByte(0, addr, (uint8_t)(addr * 7 + 1)) != 0);
+					}
+					for (uint32_t addr = 0; addr < (1u << 12); addr += 64) {
+						FAIL_UNLESS_EQ(MM_Map(1, addr, 1).error, 0);
+					}
+
+					std::atomic<bool> done(false);
+					std::vector<std::thread> readers;
+					for (int t = 0; t < 3; t++) {
+						readers.emplace_back([t, &done]() {
+							unsigned int seed = t;
+							while (!done.load()) {
+								uint64_t addr = rand_r(&seed) % (8 * 64 - 64);
+								if (t == 0) {
+									uint8_t buf[64];
+									FAIL_UNLESS_EQ(MM_Read(0, addr, buf, sizeof(buf)), 0);
+									for (uint64_t i = 0; i < sizeof(buf); i++) {
+										FAIL_UNLESS_EQ(buf[i], (uint8_t)((addr + i) * 7 + 1));
+									}
+								} else {
+									uint8_t got;
+									FAIL_IF(MM_LoadByte(0, addr, &got) != 0);
+									FAIL_UNLESS_EQ(got, (uint8_t)(addr * 7 + 1));
+								}
+							}
+						});
+					}
+
+					for (int pass = 0; pass < 20; pass++) {
+						for (uint32_t addr = 0; addr < (1u << 12); addr += 64) {
+							FAIL_IF(MM_StoreByte(1, addr, (uint8_t)pass) != 0);
+						}
+					}
+					done = true;
+					for (auto &reader : readers) reader.join();
+					return true;
+				},
+			},
+			{
+				.name = "Readers should keep going while the replacement policy is switched under them",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 6;
+					config.physical_memory_size_bytes = 12 << 6;
+					config.process_virtual_memory_size_shift = 12;
+					config.page_table_levels = 2;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					MM_SwapOn();
+
+					for (uint32_t addr = 0; addr < 4 * 64; addr += 64) {
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+					}
+					for (uint32_t addr = 0; addr < 4 * 64; addr++) {
+						FAIL_IF(MM_StoreByte(0, addr, (uint8_t)(addr * 7 + 1)) != 0);
+					}
+					for (uint32_t addr = 0; addr < 16 * 64; addr += 64) {
+						FAIL_UNLESS_EQ(MM_Map(1, addr, 1).error, 0);
+					}
+
+					std::atomic<bool> done(false);
+					std::vector<std::thread> readers;
+					for (int t = 0; t < 3; t++) {
+						readers.emplace_back([t, &done]() {
+							unsigned int seed = t;
+							while (!done.load()) {
+								uint64_t addr = rand_r(&seed) % (4 * 64);
+								uint8_t got;
+								FAIL_IF(MM_LoadByte(0, addr, &got) != 0);
+								FAIL_UNLESS_EQ(got, (uint8_t)(addr * 7 + 1));
+							}
+						});
+					}
+
+					// Every switch hands the new policy all the resident frames, while the readers
+					// keep reporting accesses to them
+					for (int pass = 0; pass < 2000; pass++) {
+						FAIL_UNLESS_EQ(MM_SetReplacementPolicy((enum MM_ReplacementPolicy)(pass % (MM_POLICY_ARC + 1))), 0);
+						FAIL_IF(MM_StoreByte(1, (pass % 16) * 64, (uint8_t)pass) != 0);
+					}
+					done = true;
+					for (auto &reader : readers) reader.join();
+
+					for (uint32_t addr = 0; addr < 4 * 64; addr++) {
+						uint8_t got;
+						FAIL_IF(MM_LoadByte(0, addr, &got) != 0);
+						FAIL_UNLESS_EQ(got, (uint8_t)(addr * 7 + 1));
+					}
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 18: (4 pts) Separate instances don't share anything.",
+		.tests = {
+			{
+				.name = "Instances with different geometries should run side by side in separate threads",
+				.points = 2,
+				.runtest = [](){
+					const enum MM_ReplacementPolicy policies[] = { MM_POLICY_FIFO, MM_POLICY_LRU, MM_POLICY_ARC };
+					std::vector<std::thread> threads;
+					for (int t = 0; t < 3; t++) {
+						threads.emplace_back([t, &policies]() {
+							// Each instance gets a different page size and too little memory, so they all swap
+							struct MM_Config config;
+							MM_DefaultConfig(&config);
+							config.page_size_bits = 6 + t;
+							config.physical_memory_size_bytes = 6ull << config.page_size_bits;
+							config.process_virtual_memory_size_shift = 14;
+							config.page_table_levels = 2;
+							config.replacement_policy = policies[t];
+							struct MM_Instance *mm = MM_Create(&config);
+							FAIL_IF(mm == NULL);
+							MM_SwapOn_ex(mm);
+
+							uint64_t page = 1ull << config.page_size_bits;
+							for (int pid = 0; pid < 2; pid++) {
+								for (uint64_t addr = 0; addr < 16 * page; addr += page) {
+									FAIL_UNLESS_EQ(MM_Map_ex(mm, pid, addr, 1).error, 0);
+									FAIL_UNLESS_EQ(MM_Store32_ex(mm, pid, addr + 4, (uint32_t)(t << 24 | pid << 16 | addr)), 0);
+								}
+							}
+							for (int pass = 0; pass < 3; pass++) {
+								for (int pid = 0; pid < 2; pid++) {
+									for (uint64_t addr = 0; addr < 16 * page; addr += page) {
+										uint32_t got;
+										FAIL_UNLESS_EQ(MM_Load32_ex(mm, pid, addr + 4, &got), 0);
+										FAIL_UNLESS_EQ(got, (uint32_t)(t << 24 | pid << 16 | addr));
+									}
+								}
+							}
+							MM_Destroy(mm);
+						});
+					}
+
+					// The default instance keeps working through the old calls the whole time
+					FAIL_UNLESS_EQ(MM_Init(NULL), 0);
+					MM_SwapOn();
+					for (int round = 0; round < 50; round++) {
+						for (uint32_t addr = 0; addr < MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES; addr += MM_PAGE_SIZE_BYTES) {
+							FAIL_UNLESS_EQ(MM_Map(1, addr, 1).error, 0);
+							FAIL_IF(MM_StoreByte(1, addr, (uint8_t)(addr + round)) != 0);
+						}
+						for (uint32_t addr = 0; addr < MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES; addr += MM_PAGE_SIZE_BYTES) {
+							uint8_t got;
+							FAIL_IF(MM_LoadByte(1, addr, &got) != 0);
+							FAIL_UNLESS_EQ(got, (uint8_t)(addr + round));
+						}
+					}
+
+					for (auto &thread : threads) thread.join();
+					return true;
+				},
+			},
+			{
+				.name = "Instances shouldn't see each other's mappings or settings",
+				.points = 2,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.page_size_bits = 3;
+					FAIL_IF(MM_Create(&config) != NULL);
+
+					MM_DefaultConfig(&config);
+					struct MM_Instance *a = MM_Create(&config);
+					config.endianness = MM_BIG_ENDIAN;
+					struct MM_Instance *b = MM_Create(&config);
+					FAIL_IF(a == NULL || b == NULL);
+
+					FAIL_UNLESS_EQ(MM_Map_ex(a, 0, 0, 1).error, 0);
+					FAIL_UNLESS_EQ(MM_Store16_ex(a, 0, 0, 0x1234), 0);
+					uint8_t got;
+					FAIL_UNLESS_EQ(MM_LoadByte_ex(b, 0, 0, &got), -1);
+					FAIL_UNLESS_EQ(MM_LoadByte(0, 0, &got), -1);
+
+					// Each instance lays out values its own way
+					FAIL_UNLESS_EQ(MM_Map_ex(b, 0, 0, 1).error, 0);
+					FAIL_UNLESS_EQ(MM_Store16_ex(b, 0, 0, 0x1234), 0);
+					FAIL_UNLESS_EQ(MM_LoadByte_ex(a, 0, 0, &got), 0);
+					FAIL_UNLESS_EQ(got, 0x34);
+					FAIL_UNLESS_EQ(MM_LoadByte_ex(b, 0, 0, &got), 0);
+					FAIL_UNLESS_EQ(got, 0x12);
+
+					// Re-initializing one leaves the other alone
+					FAIL_UNLESS_EQ(MM_Init_ex(b, NULL), 0);
+					FAIL_UNLESS_EQ(MM_LoadByte_ex(b, 0, 0, &got), -1);
+					FAIL_UNLESS_EQ(MM_LoadByte_ex(a, 0, 1, &got), 0);
+					FAIL_UNLESS_EQ(got, 0x12);
+
+					FAIL_UNLESS_EQ(MM_SetReplacementPolicy_ex(a, (enum MM_ReplacementPolicy)100), -1);
+					FAIL_UNLESS_EQ(MM_SetReplacementPolicy_ex(b, MM_POLICY_CLOCK), 0);
+					MM_Destroy(a);
+					MM_Destroy(b);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 19: (2 pts) The memory manager counts what it does.",
+		.tests = {
+			{
+				.name = "Faults, evictions, writebacks, swap bytes and TLB hits should all be counted",
+				.points = 2,
+				.runtest = [](){
+					FAIL_UNLESS_EQ(MM_Init(NULL), 0);
+					MM_SwapOn();
+
+					struct MM_Stats stats;
+					MM_GetStats(&stats);
+					FAIL_UNLESS_EQ(stats.faults + stats.evictions + stats.writebacks + stats.tlb_hits, 0u);
+
+					// Twice as many pages as frames, so every pass has to write pages back
+					for (uint32_t addr = 0; addr < MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES; addr += MM_PAGE_SIZE_BYTES) {
+						FAIL_UNLESS_EQ(MM_Map(0, addr, 1).error, 0);
+					}
+					for (int pass = 0; pass < 2; pass++) {
+						for (uint32_t addr = 0; addr < MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES; addr += MM_PAGE_SIZE_BYTES) {
+							FAIL_IF(MM_StoreByte(0, addr, (uint8_t)addr) != 0);
+						}
+					}
+					MM_GetStats(&stats);
+					FAIL_IF(stats.faults == 0);
+					FAIL_IF(stats.evictions == 0);
+					FAIL_IF(stats.writebacks == 0);
+					FAIL_IF(stats.writebacks > stats.evictions);
+
+					// Every writeback is one page written, and the second pass reads back what the first wrote
+					FAIL_UNLESS_EQ(stats.swap_bytes_written, stats.writebacks * MM_PAGE_SIZE_BYTES);
+					FAIL_IF(stats.swap_bytes_read == 0);
+					FAIL_UNLESS_EQ(stats.swap_bytes_read % MM_PAGE_SIZE_BYTES, 0u);
+
+					uint64_t hits = stats.tlb_hits;
+					uint8_t got;
+					for (int i = 0; i < 10; i++) {
+						FAIL_IF(MM_LoadByte(0, MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES - 1, &got) != 0);
+					}
+					MM_GetStats(&stats);
+					FAIL_UNLESS_EQ(stats.tlb_hits - hits, 10u);
+
+					// MM_Init() starts the counts over
+					FAIL_UNLESS_EQ(MM_Init(NULL), 0);
+					MM_GetStats(&stats);
+					FAIL_UNLESS_EQ(stats.faults + stats.evictions + stats.writebacks + stats.tlb_hits, 0u);
+					FAIL_UNLESS_EQ(stats.swap_bytes_read + stats.swap_bytes_written, 0u);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 20: (2 pts) Binary traces hold exactly what the text ones do.",
+		.tests = {
+			{
+				.name = "Ops should come back out of a binary trace the way they went in",
+				.points = 2,
+				.runtest = [](){
+					char lines[][64] = {
+						"swap", "0,map,0,1", "0,store,1f,42", "3,load,ffffffffffff,0",
+						"3,store,10,255", "1,map,8000,0", "0,load,0,0", "",
+					};
+					std::vector<struct trace_op> ops;
+					for (auto &line : lines) {
+						struct trace_op op;
+						int rc = trace_parse_line(line, &op);
+						FAIL_IF(rc < 0);
+						if (rc == 0) ops.push_back(op);
+					}
+					FAIL_UNLESS_EQ(ops.size(), 7u);
+
+					char bad[][64] = { "0,map,0", "0,jump,0,0", "x,load,0,0", "0,store,0,256", "0,load,0,0,0" };
+					for (auto &line : bad) {
+						struct trace_op op;
+						FAIL_UNLESS_EQ(trace_parse_line(line, &op), -1);
+					}
+
+					struct trace_writer writer;
+					FAIL_UNLESS_EQ(trace_writer_open(&writer, "tests.out/trace.mmt"), 0);
+					for (auto &op : ops) trace_writer_put(&writer, &op);
+					FAIL_UNLESS_EQ(trace_writer_close(&writer), 0);
+					FAIL_IF(!trace_is_binary("tests.out/trace.mmt"));
+
+					struct trace_reader reader;
+					FAIL_UNLESS_EQ(trace_reader_open(&reader, "tests.out/trace.mmt"), 0);
+					FAIL_UNLESS_EQ(reader.count, ops.size());
+					for (auto &op : ops) {
+						struct trace_op got;
+						FAIL_UNLESS_EQ(trace_reader_next(&reader, &got), 1);
+						FAIL_UNLESS_EQ(got.kind, op.kind);
+						FAIL_UNLESS_EQ(got.pid, op.pid);
+						FAIL_IF(got.address != op.address);
+						if (op.kind == TRACE_MAP || op.kind == TRACE_STORE) {
+							FAIL_UNLESS_EQ(got.value, op.value);
+						}
+					}
+					struct trace_op got;
+					FAIL_UNLESS_EQ(trace_reader_next(&reader, &got), 0);
+					trace_reader_close(&reader);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 21: (2 pts) Traces can be read through a trace_pipe.",
+		.tests = {
+			{
+				.name = "A pipe should hand over every op of a text or binary trace, in order",
+				.points = 2,
+				.runtest = [](){
+					// Enough ops to wrap the ring several times, and enough text to refill the read buffer
+					std::vector<struct trace_op> ops;
+					FILE *text = fopen("tests.out/pipe.txt", "w");
+					FAIL_IF(text == NULL);
+					fprintf(text, "swap\n\n");
+					ops.push_back({ TRACE_SWAP, 0, 0, 0 });
+					for (int i = 0; i < 5 * TRACE_RING_SIZE; i++) {
+						struct trace_op op = { (uint8_t)(TRACE_MAP + i % 3), (uint8_t)(i % 3 == 1 ? 0 : i), i % 7, (uint64_t)rand() * 4099 };
+						static const char *names[] = { "swap", "map", "load", "store" };
+						fprintf(text, "%d,%s,%llx,%d\n", op.pid, names[op.kind], (unsigned long long)op.address, op.value);
+						ops.push_back(op);
+					}
+					fclose(text);
+
+					struct trace_writer writer;
+					FAIL_UNLESS_EQ(trace_writer_open(&writer, "tests.out/pipe.mmt"), 0);
+					for (auto &op : ops) trace_writer_put(&writer, &op);
+					FAIL_UNLESS_EQ(trace_writer_close(&writer), 0);
+
+					std::vector<const char *> paths = { "tests.out/pipe.txt", "tests.out/pipe.mmt" };
+					// Compressed traces need the zstd tool, which might not be installed
+					if (system("zstd -qf tests.out/pipe.mmt -o tests.out/pipe.mmt.zst 2>/dev/null") == 0) {
+						FAIL_IF(!trace_is_compressed("tests.out/pipe.mmt.zst"));
+						paths.push_back("tests.out/pipe.mmt.zst");
+					}
+					FAIL_IF(trace_is_compressed("tests.out/pipe.mmt"));
+
+					for (auto path : paths) {
+						struct trace_pipe *pipe = trace_pipe_open(path);
+						FAIL_IF(pipe == NULL);
+						for (auto &op : ops) {
+							struct trace_op got;
+							FAIL_UNLESS_EQ(trace_pipe_next(pipe, &got), 1);
+							FAIL_UNLESS_EQ(got.kind, op.kind);
+							FAIL_UNLESS_EQ(got.pid, op.pid);
+							FAIL_IF(got.address != op.address);
+							FAIL_UNLESS_EQ(got.value, op.value);
+						}
+						struct trace_op got;
+						FAIL_UNLESS_EQ(trace_pipe_next(pipe, &got), 0);
+						trace_pipe_close(pipe);
+
+						// Closing early shouldn't leave the producer stuck on a full ring
+						pipe = trace_pipe_open(path);
+						FAIL_IF(pipe == NULL);
+						FAIL_UNLESS_EQ(trace_pipe_next(pipe, &got), 1);
+						trace_pipe_close(pipe);
+					}
+
+					FILE *bad = fopen("tests.out/pipe_bad.txt", "w");
+					FAIL_IF(bad == NULL);
+					fprintf(bad, "0,map,0,1\n0,jump,0,0\n");
+					fclose(bad);
+					struct trace_pipe *pipe = trace_pipe_open("tests.out/pipe_bad.txt");
+					FAIL_IF(pipe == NULL);
+					struct trace_op got;
+					FAIL_UNLESS_EQ(trace_pipe_next(pipe, &got), 1);
+					FAIL_UNLESS_EQ(trace_pipe_next(pipe, &got), -1);
+					trace_pipe_close(pipe);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 22: (3 pts) Detailed stats and latency histograms.",
+		.tests = {
+			{
+				.name = "Faults and evictions should be broken down, and swap I/O timed",
+				.points = 1,
+				.runtest = [](){
+					FAIL_UNLESS_EQ(MM_Init(NULL), 0);
+					MM_SwapOn();
+
+					// Two pids taking turns on twice as many pages as there are frames
+					for (int pid = 0; pid < 2; pid++) {
+						for (uint32_t addr = 0; addr < MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES; addr += MM_PAGE_SIZE_BYTES) {
+							FAIL_UNLESS_EQ(MM_Map(pid, addr, 1).error, 0);
+						}
+					}
+					int ops = 0;
+					for (int pass = 0; pass < 3; pass++) {
+						for (uint32_t addr = 0; addr < MM_PROCESS_VIRTUAL_MEMORY_SIZE_BYTES; addr += MM_PAGE_SIZE_BYTES) {
+							for (int pid = 0; pid < 2; pid++) {
+								FAIL_IF(MM_StoreByte(pid, addr, (uint8_t)(addr + pass)) != 0);
+								ops++;
+							}
+						}
+					}
+
+					struct MM_Stats stats;
+					MM_GetStats(&stats);
+					FAIL_UNLESS_EQ(stats.translations, (uint64_t)ops);
+					FAIL_UNLESS_EQ(stats.faults, stats.minor_faults + stats.major_faults);
+					FAIL_IF(stats.minor_faults == 0);
+					FAIL_IF(stats.major_faults == 0);
+					FAIL_UNLESS_EQ(stats.evictions, stats.evictions_data + stats.evictions_page_table);
+					FAIL_UNLESS_EQ(stats.evictions, stats.evictions_same_pid + stats.evictions_other_pid);
+					FAIL_IF(stats.evictions_data == 0);
+					FAIL_IF(stats.evictions_other_pid == 0);
+
+					// Without I/O threads, every major fault is one read and every writeback one write
+					FAIL_IF(stats.page_in.count < stats.major_faults);
+					FAIL_UNLESS_EQ(stats.page_out.count, stats.writebacks);
+					uint64_t p50 = MM_HistogramPercentile(&stats.page_out, 50);
+					uint64_t p99 = MM_HistogramPercentile(&stats.page_out, 99);
+					uint64_t max = MM_HistogramPercentile(&stats.page_out, 100);
+					FAIL_IF(p50 == 0 || p50 > p99 || p99 > max);
+					FAIL_IF(max < stats.page_out.total_ns / stats.page_out.count);
+
+					struct MM_Histogram empty;
+					memset(&empty, 0, sizeof(empty));
+					FAIL_UNLESS_EQ(MM_HistogramPercentile(&empty, 50), 0u);
+					return true;
+				},
+			},
+			{
+				.name = "Counts from many threads should add up exactly",
+				.points = 1,
+				.runtest = [](){
+					// Two pids' page tables and pages fill memory exactly, so nothing gets ejected
+					FAIL_UNLESS_EQ(MM_Init(NULL), 0);
+					for (int pid = 0; pid < 2; pid++) {
+						FAIL_UNLESS_EQ(MM_Map(pid, 0, 1).error, 0);
+					}
+
+					// More threads than there are counter shards, so some of them have to share one
+					const int per_thread = 20000;
+					std::vector<std::thread> threads;
+					for (int t = 0; t < 24; t++) {
+						threads.emplace_back([t]() {
+							int pid = t % 2;
+							uint8_t got;
+							for (int i = 0; i < per_thread; i++) {
+								MM_LoadByte(pid, 0, &got);
+							}
+						});
+					}
+					for (auto &thread : threads) thread.join();
+
+					struct MM_Stats stats;
+					MM_GetStats(&stats);
+					FAIL_UNLESS_EQ(stats.translations, 24u * per_thread);
+					FAIL_UNLESS_EQ(stats.translations - stats.tlb_hits, stats.faults);
+					return true;
+				},
+			},
+			{
+				.name = "Stats should be dumped periodically when asked for",
+				.points = 1,
+				.runtest = [](){
+					unlink("tests.out/stats.jsonl");
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.stats_dump_interval_ms = 20;
+					config.stats_dump_path = "tests.out/stats.jsonl";
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					FAIL_UNLESS_EQ(MM_Map(0, 0, 1).error, 0);
+					FAIL_IF(MM_StoreByte(0, 0, 1) != 0);
+					usleep(100 * 1000);
+
+					// Tearing the instance down makes one last dump
+					FAIL_UNLESS_EQ(MM_Init(NULL), 0);
+
+					FILE *file = fopen("tests.out/stats.jsonl", "r");
+					FAIL_IF(file == NULL);
+					char line[2048];
+					int lines = 0;
+					while (fgets(line, sizeof(line), file) != NULL) {
+						FAIL_IF(strncmp(line, "{\"instance\": 0, ", 15) != 0);
+						FAIL_IF(strstr(line, "\"translations\": 1,") == NULL);
+						FAIL_IF(strstr(line, "\"page_in_p99_ns\": ") == NULL);
+						lines++;
+					}
+					fclose(file);
+					FAIL_IF(lines < 3);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 23: (3 pts) Synthetic workloads have the locality they're asked for.",
+		.tests = {
+			{
+				.name = "A workload should map every page first, and be the same every time for the same seed",
+				.points = 1,
+				.runtest = [](){
+					struct workload_config config;
+					workload_default_config(&config);
+					FAIL_UNLESS_EQ(workload_parse("mix,pids=5,pages=64,page_bits=8,ops=5000,stores=50,seed=9,swap", &config), 0);
+					FAIL_UNLESS_EQ(config.pattern, WORKLOAD_MIX);
+					FAIL_UNLESS_EQ(config.pids, 5);
+					FAIL_UNLESS_EQ(config.store_percent, 50);
+					FAIL_UNLESS_EQ(config.swap, 1);
+
+					struct workload_config bad = config;
+					FAIL_UNLESS_EQ(workload_parse("zipf,pages", &bad), -1);
+					FAIL_UNLESS_EQ(workload_parse("zipf,pids=65", &bad), -1);
+					FAIL_UNLESS_EQ(workload_parse("hot,pages=8", &bad), -1);
+					FAIL_UNLESS_EQ(workload_parse("strided,stride=100000", &bad), 0);
+					struct workload workload;
+					FAIL_UNLESS_EQ(workload_init(&workload, &bad), -1);
+
+					auto generate = [](const struct workload_config &c) {
+						struct workload w;
+						FAIL_UNLESS_EQ(workload_init(&w, &c), 0);
+						std::vector<struct trace_op> ops;
+						struct trace_op op;
+						while (workload_next(&w, &op)) ops.push_back(op);
+						FAIL_UNLESS_EQ(ops.size(), w.total);
+						return ops;
+					};
+
+					std::vector<struct trace_op> ops = generate(config);
+					FAIL_UNLESS_EQ(ops.size(), 1 + 5 * 64 + 5000u);
+					FAIL_UNLESS_EQ(ops[0].kind, TRACE_SWAP);
+					int stores = 0;
+					for (size_t i = 1; i < ops.size(); i++) {
+						if (i <= 5 * 64) {
+							FAIL_UNLESS_EQ(ops[i].kind, TRACE_MAP);
+							FAIL_UNLESS_EQ(ops[i].pid, (int)(i - 1) / 64);
+							FAIL_IF(ops[i].address != ((i - 1) % 64) << 8);
+						} else {
+							FAIL_IF(ops[i].kind != TRACE_LOAD && ops[i].kind != TRACE_STORE);
+							FAIL_IF(ops[i].pid < 0 || ops[i].pid >= 5);
+							FAIL_IF(ops[i].address >= 64 << 8);
+							stores += ops[i].kind == TRACE_STORE;
+						}
+					}
+					FAIL_IF(stores < 2000 || stores > 3000);
+
+					std::vector<struct trace_op> again = generate(config);
+					config.seed++;
+					std::vector<struct trace_op> other = generate(config);
+					int differences = 0;
+					for (size_t i = 0; i < ops.size(); i++) {
+						FAIL_IF(again[i].kind != ops[i].kind || again[i].pid != ops[i].pid ||
+							again[i].address != ops[i].address || again[i].value != ops[i].value);
+						differences += other[i].address != ops[i].address;
+					}
+					FAIL_IF(differences < 1000);
+					return true;
+				},
+			},
+			{
+				.name = "Each pattern should touch the pages it's meant to",
+				.points = 1,
+				.runtest = [](){
+					auto accesses = [](const char *spec) {
+						struct workload_config config;
+						struct workload workload;
+						workload_default_config(&config);
+						FAIL_UNLESS_EQ(workload_parse(spec, &config), 0);
+						FAIL_UNLESS_EQ(workload_init(&workload, &config), 0);
+						std::vector<uint64_t> addresses;
+						struct trace_op op;
+						while (workload_next(&workload, &op)) {
+							if (op.kind != TRACE_MAP) addresses.push_back(op.address);
+						}
+						return addresses;
+					};
+					// The share of accesses that went to the hottest tenth of the pages
+					auto hot_share = [](const std::vector<uint64_t> &addresses, int pages) {
+						std::vector<int> counts(pages);
+						for (auto address : addresses) counts[address >> 4]++;
+						std::sort(counts.rbegin(), counts.rend());
+						int hot = 0;
+						for (int i = 0; i < pages / 10; i++) hot += counts[i];
+						return (double)hot / addresses.size();
+					};
+
+					FAIL_IF(hot_share(accesses("zipf,pages=1000,ops=100000"), 1000) < 0.5);
+					FAIL_IF(hot_share(accesses("uniform,pages=1000,ops=100000"), 1000) > 0.15);
+					// The hot pages shouldn't just be the first few
+					std::vector<uint64_t> zipf = accesses("zipf,pages=1000,ops=100000");
+					FAIL_IF(std::count_if(zipf.begin(), zipf.end(), [](uint64_t a) { return a < 100 << 4; }) > 30000);
+
+					std::vector<uint64_t> sequential = accesses("sequential,pages=100,ops=1000");
+					for (size_t i = 0; i < sequential.size(); i++) {
+						FAIL_IF(sequential[i] != i * 4 % 1600);
+					}
+
+					// Down each 64 byte column of a 25 row matrix, then on to the next column
+					std::vector<uint64_t> strided = accesses("strided,pages=100,stride=64,ops=100");
+					for (size_t i = 0; i < strided.size(); i++) {
+						FAIL_IF(strided[i] != i % 25 * 64 + i / 25);
+					}
+
+					std::vector<uint64_t> phases = accesses("phases,pages=1000,working_set=20,phase_ops=500,ops=5000");
+					std::set<uint64_t> bases;
+					for (size_t start = 0; start < phases.size(); start += 500) {
+						auto [low, high] = std::minmax_element(phases.begin() + start, phases.begin() + start + 500);
+						FAIL_IF((*high >> 4) - (*low >> 4) >= 20);
+						bases.insert(*low >> 4);
+					}
+					FAIL_IF(bases.size() < 5);
+					return true;
+				},
+			},
+			{
+				.name = "Loads in a multi-pid workload should see every store, with pages swapped in and out",
+				.points = 1,
+				.runtest = [](){
+					struct workload_config config;
+					struct workload workload;
+					workload_default_config(&config);
+					FAIL_UNLESS_EQ(workload_parse("mix,pids=4,burst=8,ops=50000,swap", &config), 0);
+					FAIL_UNLESS_EQ(workload_init(&workload, &config), 0);
+
+					std::map<std::pair<int, uint64_t>, uint8_t> shadow;
+					struct trace_op op;
+					while (workload_next(&workload, &op)) {
+						if (op.kind == TRACE_LOAD) {
+							uint8_t value;
+							FAIL_IF(MM_LoadByte(op.pid, op.address, &value) != 0);
+							FAIL_UNLESS_EQ(value, shadow[std::make_pair(op.pid, op.address)]);
+						} else {
+							FAIL_UNLESS_EQ(workload_apply(NULL, &op), 0);
+							if (op.kind == TRACE_STORE) shadow[std::make_pair(op.pid, op.address)] = op.value;
+						}
+					}
+
+					struct MM_Stats stats;
+					MM_GetStats(&stats);
+					FAIL_IF(stats.writebacks == 0 || stats.major_faults == 0);
+
+					// The same workload written out should replay to the same ops
+					FAIL_UNLESS_EQ(workload_init(&workload, &config), 0);
+					FAIL_UNLESS_EQ(workload_write_binary(&workload, "tests.out/workload.mmt"), 0);
+					struct workload fresh;
+					FAIL_UNLESS_EQ(workload_init(&fresh, &config), 0);
+					struct trace_reader reader;
+					FAIL_UNLESS_EQ(trace_reader_open(&reader, "tests.out/workload.mmt"), 0);
+					FAIL_IF(reader.count != fresh.total);
+					struct trace_op got;
+					while (workload_next(&fresh, &op)) {
+						FAIL_UNLESS_EQ(trace_reader_next(&reader, &got), 1);
+						FAIL_IF(got.kind != op.kind || got.pid != op.pid || got.address != op.address);
+					}
+					trace_reader_close(&reader);
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 24: (2 pts) PTEs can be a fixed 32 or 64 bits wide.",
+		.tests = {
+			{
+				.name = "The PTE width should decide how many VPN bits each level covers",
+				.points = 1,
+				.runtest = [](){
+					struct MM_Config config;
+					MM_DefaultConfig(&config);
+					config.pte_size_bytes = 3;
+					FAIL_IF(MM_Init(&config) == 0);
+					// 64 frames need more than the 3 bits a 1 byte PTE has left over
+					config.pte_size_bytes = 1;
+					config.physical_memory_size_bytes = 64 * MM_PAGE_SIZE_BYTES;
+					FAIL_IF(MM_Init(&config) == 0);
+
+					// 4 KiB pages hold 1024 32-bit PTEs or 512 64-bit ones, and there are 30 VPN bits
+					config.page_size_bits = 12;
+					config.physical_memory_size_bytes = 64 << 12;
+					config.process_virtual_memory_size_shift = 42;
+					config.page_table_levels = 3;
+					config.pte_size_bytes = 4;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+					config.pte_size_bytes = 8;
+					FAIL_IF(MM_Init(&config) == 0);
+					config.page_table_levels = 4;
+					FAIL_UNLESS_EQ(MM_Init(&config), 0);
+
+					uint64_t top = (1ull << 42) - 1;
+					FAIL_UNLESS_EQ(MM_Map(0, top, 1).error, 0);
+					FAIL_IF(MM_StoreByte(0, top, 99) != 0);
+					uint8_t value;
+					FAIL_IF(MM_LoadByte(0, top, &value) != 0);
+					FAIL_UNLESS_EQ(value, 99);
+					return true;
+				},
+			},
+			{
+				.name = "Every PTE width should fault, evict and write back exactly the same",
+				.points = 1,
+				.runtest = [](){
+					// One table per pid at every width, so only the PTE encoding differs. A 1 byte PTE
+					// (the smallest that fits 8 frames) only has room for the first few swap slots
+					std::vector<struct MM_Stats> results;
+					for (int width : { 0, 2, 4, 8 }) {
+						struct MM_Config config;
+						MM_DefaultConfig(&config);
+						config.page_size_bits = 8;
+						config.physical_memory_size_bytes = 8 << 8;
+						config.process_virtual_memory_size_shift = 13;
+						config.pte_size_bytes = width;
+						FAIL_UNLESS_EQ(MM_Init(&config), 0);
+
+						struct workload_config workload_config;
+						struct workload workload;
+						workload_default_config(&workload_config);
+						FAIL_UNLESS_EQ(workload_parse("mix,pids=4,pages=32,page_bits=8,burst=4,ops=20000,swap", &workload_config), 0);
+						FAIL_UNLESS_EQ(workload_init(&workload, &workload_config), 0);
+
+						std::map<std::pair<int, uint64_t>, uint8_t> shadow;
+						struct trace_op op;
+						while (workload_next(&workload, &op)) {
+							if (op.kind == TRACE_LOAD) {
+								FAIL_IF(MM_LoadByte(op.pid, op.address, &op.value) != 0);
+								FAIL_UNLESS_EQ(op.value, shadow[std::make_pair(op.pid, op.address)]);
+							} else {
+								FAIL_UNLESS_EQ(workload_apply(NULL, &op), 0);
+								if (op.kind == TRACE_STORE) shadow[std::make_pair(op.pid, op.address)] = op.value;
+							}
+						}
+
+						results.emplace_back();
+						MM_GetStats(&results.back());
+					}
+
+					FAIL_IF(results[0].major_faults == 0 || results[0].minor_faults == 0);
+					for (auto &stats : results) {
+						FAIL_IF(stats.major_faults != results[0].major_faults);
+						FAIL_IF(stats.minor_faults != results[0].minor_faults);
+						FAIL_IF(stats.evictions != results[0].evictions);
+						FAIL_IF(stats.writebacks != results[0].writebacks);
+						FAIL_IF(stats.swap_bytes_read != results[0].swap_bytes_read);
+					}
+					return true;
+				},
+			},
+		},
+	},
+	{
+		.name = "Section 25: (2 pts) Clock sweeps whole words of frames at a time.",
+		.tests = {
+			{
+				.name = "Clock should never eject a page used since the hand last passed it",
+				.points = 2,
+				.runtest = [](){
+					// 150 frames is two full bitmap words and part of a third, so the hand has to
+					// stop partway through words and wrap around short of a word's end
+					for (int levels = 1; levels <= 2; levels++) {
+						struct MM_Config config;
+						MM_DefaultConfig(&config);
+						config.page_size_bits = 10;
+						config.physical_memory_size_bytes = 150 << 10;
+						config.process_virtual_memory_size_shift = 19;
+						config.page_table_levels = levels;
+						config.replacement_policy = MM_POLICY_CLOCK;
+						FAIL_UNLESS_EQ(MM_Init(&config), 0);
+						MM_SwapOn();
+
+						for (uint64_t vpn = 0; vpn < 400; vpn++) {
+							FAIL_UNLESS_EQ(MM_Map(0, vpn << 10, 1).error, 0);
+							FAIL_IF(MM_StoreByte(0, vpn << 10, (uint8_t)vpn) != 0);
+						}
+
+						// Every seventh page is hot, and is used again between each fault on the
+						// cold pages, so once the hot pages are all in only the cold pages fault
+						uint64_t cold = 1;
+						for (int round = 0; round < 600; round++) {
+							struct MM_Stats before;
+							MM_GetStats(&before);
+
+							uint8_t value;
+							for (uint64_t vpn = 0; vpn < 400; vpn += 7) {
+								FAIL_IF(MM_LoadByte(0, vpn << 10, &value) != 0);
+								FAIL_UNLESS_EQ(value, (uint8_t)vpn);
+							}
+							if (round % 3 == 0) {
+								FAIL_IF(MM_StoreByte(0, cold << 10, (uint8_t)cold) != 0);
+							} else {
+								FAIL_IF(MM_LoadByte(0, cold << 10, &value) != 0);
+								FAIL_UNLESS_EQ(value, (uint8_t)cold);
+							}
+							do {
+								cold = (cold + 1) % 400;
+							} while (cold % 7 == 0);
+
+							struct MM_Stats after;
+							MM_GetStats(&after);
+							if (round >= 2) FAIL_UNLESS_EQ(after.major_faults - before.major_faults, 1u);
+						}
+					}
+					return true;
+				},
+			},
+		},
+	},
 };
 
 int main(int argc, char **argv) {
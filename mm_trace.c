@@ -0,0 +1,577 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "mm_trace.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Text traces.                                                              //
+///////////////////////////////////////////////////////////////////////////////
+
+int trace_parse_line(char *line, struct trace_op *op) {
+	line[strcspn(line, "\r\n")] = 0;
+
+	if(line[strspn(line, " \t")] == 0)
+		return 1;
+
+	if(strcmp(line, "swap") == 0) {
+		op->kind = TRACE_SWAP;
+		op->pid = 0;
+		op->address = 0;
+		op->value = 0;
+		return 0;
+	}
+
+	char *fields[4];
+	int num_fields = 0;
+	char *save;
+	for(char *field = strtok_r(line, ",", &save); field != NULL; field = strtok_r(NULL, ",", &save)) {
+		if(num_fields == 4)
+			return -1;
+		fields[num_fields++] = field;
+	}
+
+	if(num_fields != 4)
+		return -1;
+
+	char *end;
+	long pid = strtol(fields[0], &end, 10);
+	if(*end != 0 || pid < 0 || pid >= (1 << 16))
+		return -1;
+
+	if(strcmp(fields[1], "map") == 0)
+		op->kind = TRACE_MAP;
+	else if(strcmp(fields[1], "load") == 0)
+		op->kind = TRACE_LOAD;
+	else if(strcmp(fields[1], "store") == 0)
+		op->kind = TRACE_STORE;
+	else
+		return -1;
+
+	errno = 0;
+	op->address = strtoull(fields[2], &end, 16);
+	if(*end != 0 || errno != 0)
+		return -1;
+
+	unsigned long value = strtoul(fields[3], &end, 10);
+	if(*end != 0 || value > UINT8_MAX)
+		return -1;
+
+	op->pid = (int)pid;
+	op->value = (uint8_t)value;
+	return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Binary traces.                                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+static size_t put_varint(uint8_t *out, uint64_t value) {
+	size_t n = 0;
+	while(value >= 0x80) {
+		out[n++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	out[n++] = (uint8_t)value;
+
+	return n;
+}
+
+// Returns the number of bytes read, or 0 if the varint runs past 'end' or is too long
+static size_t get_varint(const uint8_t *in, const uint8_t *end, uint64_t *value) {
+	uint64_t result = 0;
+	for(size_t n = 0; n < 10 && in + n < end; n++) {
+		result |= (uint64_t)(in[n] & 0x7f) << (7 * n);
+		if(!(in[n] & 0x80)) {
+			*value = result;
+			return n + 1;
+		}
+	}
+
+	return 0;
+}
+
+// Zigzag encoding keeps small negative deltas small
+static uint64_t zigzag(int64_t value) {
+	return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static void put_header(uint8_t *header, uint64_t count) {
+	memcpy(header, TRACE_MAGIC, 4);
+	for(int i = 0; i < 4; i++)
+		header[4 + i] = (uint8_t)(TRACE_VERSION >> (8 * i));
+	for(int i = 0; i < 8; i++)
+		header[8 + i] = (uint8_t)(count >> (8 * i));
+}
+
+int trace_writer_open(struct trace_writer *writer, const char *path) {
+	memset(writer, 0, sizeof(*writer));
+
+	writer->file = fopen(path, "wb");
+	if(writer->file == NULL)
+		return -1;
+
+	// The count is filled in once it's known
+	uint8_t header[TRACE_HEADER_BYTES];
+	put_header(header, 0);
+	if(fwrite(header, sizeof(header), 1, writer->file) != 1)
+		writer->error = 1;
+
+	return 0;
+}
+
+void trace_writer_put(struct trace_writer *writer, const struct trace_op *op) {
+	uint8_t record[TRACE_MAX_RECORD_BYTES];
+	size_t n = 1;
+
+	record[0] = op->kind & 3;
+
+	if(op->kind != TRACE_SWAP) {
+		if(op->pid != writer->pid) {
+			record[0] |= TRACE_NEW_PID;
+			n += put_varint(&record[n], (uint64_t)op->pid);
+			writer->pid = op->pid;
+		}
+
+		n += put_varint(&record[n], zigzag((int64_t)(op->address - writer->address)));
+		writer->address = op->address;
+
+		if(op->kind == TRACE_MAP || op->kind == TRACE_STORE)
+			record[n++] = op->value;
+	}
+
+	if(fwrite(record, n, 1, writer->file) != 1)
+		writer->error = 1;
+
+	writer->count++;
+}
+
+int trace_writer_close(struct trace_writer *writer) {
+	uint8_t header[TRACE_HEADER_BYTES];
+	put_header(header, writer->count);
+
+	if(fseek(writer->file, 0, SEEK_SET) || fwrite(header, sizeof(header), 1, writer->file) != 1)
+		writer->error = 1;
+
+	if(fclose(writer->file))
+		writer->error = 1;
+
+	writer->file = NULL;
+	return writer->error ? -1 : 0;
+}
+
+int trace_reader_open(struct trace_reader *reader, const char *path) {
+	memset(reader, 0, sizeof(*reader));
+
+	int fd = open(path, O_RDONLY);
+	if(fd == -1)
+		return -1;
+
+	struct stat st;
+	if(fstat(fd, &st) || st.st_size < TRACE_HEADER_BYTES) {
+		close(fd);
+		return -1;
+	}
+
+	// The mapping stays good after the descriptor is closed
+	void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(base == MAP_FAILED)
+		return -1;
+
+	reader->base = base;
+	reader->size = (size_t)st.st_size;
+
+	uint32_t version = 0;
+	for(int i = 0; i < 4; i++)
+		version |= (uint32_t)reader->base[4 + i] << (8 * i);
+	for(int i = 0; i < 8; i++)
+		reader->count |= (uint64_t)reader->base[8 + i] << (8 * i);
+
+	if(memcmp(reader->base, TRACE_MAGIC, 4) != 0 || version != TRACE_VERSION) {
+		trace_reader_close(reader);
+		return -1;
+	}
+
+	// Records are only ever read front to back
+	madvise(base, reader->size, MADV_SEQUENTIAL);
+
+	reader->pos = reader->base + TRACE_HEADER_BYTES;
+	return 0;
+}
+
+void trace_reader_close(struct trace_reader *reader) {
+	if(reader->base != NULL)
+		munmap((void*)reader->base, reader->size);
+
+	reader->base = NULL;
+	reader->pos = NULL;
+}
+
+// Decodes the record at '*pos', moving '*pos' past it. 'pid' and 'address' carry the previous
+// op's, since records only store what changed. Returns 0, or -1 if the record is corrupt or runs
+// past 'end'
+static int decode_record(const uint8_t **pos, const uint8_t *end, int *pid, uint64_t *address,
+		struct trace_op *op) {
+	const uint8_t *p = *pos;
+	uint8_t kind = *p++;
+	op->kind = kind & 3;
+	op->value = 0;
+
+	if(op->kind == TRACE_SWAP) {
+		op->pid = 0;
+		op->address = 0;
+		*pos = p;
+		return 0;
+	}
+
+	uint64_t value;
+	size_t n;
+
+	if(kind & TRACE_NEW_PID) {
+		if((n = get_varint(p, end, &value)) == 0 || value >= (1 << 16))
+			return -1;
+
+		*pid = (int)value;
+		p += n;
+	}
+
+	if((n = get_varint(p, end, &value)) == 0)
+		return -1;
+
+	*address += (uint64_t)unzigzag(value);
+	p += n;
+
+	if(op->kind == TRACE_MAP || op->kind == TRACE_STORE) {
+		if(p == end)
+			return -1;
+		op->value = *p++;
+	}
+
+	op->pid = *pid;
+	op->address = *address;
+	*pos = p;
+	return 0;
+}
+
+int trace_reader_next(struct trace_reader *reader, struct trace_op *op) {
+	if(reader->pos == reader->base + reader->size)
+		return 0;
+
+	return decode_record(&reader->pos, reader->base + reader->size, &reader->pid, &reader->address, op) ? -1 : 1;
+}
+
+int trace_is_binary(const char *path) {
+	FILE *file = fopen(path, "rb");
+	if(file == NULL)
+		return 0;
+
+	char magic[4];
+	int binary = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, TRACE_MAGIC, 4) == 0;
+	fclose(file);
+
+	return binary;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Streamed traces.                                                          //
+///////////////////////////////////////////////////////////////////////////////
+
+// Frame magics, as they appear on disk
+static const uint8_t ZSTD_MAGIC[4] = { 0x28, 0xb5, 0x2f, 0xfd };
+static const uint8_t LZ4_MAGIC[4] = { 0x04, 0x22, 0x4d, 0x18 };
+
+#define STREAM_BUFFER_BYTES	(64 * 1024)
+#define RING_MASK		(TRACE_RING_SIZE - 1)
+
+// The producer and consumer each write one cache line of indexes, and only read the other's. Each
+// keeps a copy of the other side's index and only goes back to the shared one when the copy says
+// the ring is full (or empty), so most ops cross without touching the other core's line
+struct trace_pipe {
+	struct trace_op ring[TRACE_RING_SIZE];
+
+	struct {
+		uint64_t tail;		// The next slot the producer fills
+		int done;		// Set once the last op is in the ring
+		int error;
+	} __attribute__((aligned(64))) producer;
+
+	struct {
+		uint64_t head;		// The next slot the consumer reads
+		int closing;		// Tells the producer to stop early
+	} __attribute__((aligned(64))) consumer;
+
+	// Only ever touched by their own side
+	uint64_t producer_head __attribute__((aligned(64)));
+	uint64_t consumer_tail __attribute__((aligned(64)));
+
+	const char *path;
+	FILE *input;
+	pid_t child;		// The decompressor, or 0 for an uncompressed trace
+	pthread_t thread;
+
+	// The producer's read buffer
+	uint8_t *buffer;
+	size_t pos, len;
+	int eof;
+	size_t line;		// Of a text trace, for error messages
+	int pid;
+	uint64_t address;
+};
+
+// Returns "zstd" or "lz4" for a compressed trace, or NULL
+static const char *decompressor_for(const char *path) {
+	FILE *file = fopen(path, "rb");
+	if(file == NULL)
+		return NULL;
+
+	uint8_t magic[4];
+	const char *tool = NULL;
+	if(fread(magic, sizeof(magic), 1, file) == 1) {
+		if(memcmp(magic, ZSTD_MAGIC, 4) == 0)
+			tool = "zstd";
+		else if(memcmp(magic, LZ4_MAGIC, 4) == 0)
+			tool = "lz4";
+	}
+	fclose(file);
+
+	return tool;
+}
+
+int trace_is_compressed(const char *path) {
+	return decompressor_for(path) != NULL;
+}
+
+// Moves what's left of the buffer to the front and reads more after it. Returns -1 on a read error
+static int fill_buffer(struct trace_pipe *pipe) {
+	memmove(pipe->buffer, pipe->buffer + pipe->pos, pipe->len - pipe->pos);
+	pipe->len -= pipe->pos;
+	pipe->pos = 0;
+
+	while(!pipe->eof && pipe->len < STREAM_BUFFER_BYTES) {
+		size_t n = fread(pipe->buffer + pipe->len, 1, STREAM_BUFFER_BYTES - pipe->len, pipe->input);
+		pipe->len += n;
+		if(n == 0) {
+			if(ferror(pipe->input))
+				return -1;
+			pipe->eof = 1;
+		}
+	}
+
+	return 0;
+}
+
+// Decodes the next op from the buffer. Returns the same as trace_reader_next()
+static int stream_next_binary(struct trace_pipe *pipe, struct trace_op *op) {
+	if(pipe->len - pipe->pos < TRACE_MAX_RECORD_BYTES && fill_buffer(pipe))
+		return -1;
+
+	if(pipe->pos == pipe->len)
+		return 0;
+
+	const uint8_t *pos = pipe->buffer + pipe->pos;
+	if(decode_record(&pos, pipe->buffer + pipe->len, &pipe->pid, &pipe->address, op))
+		return -1;
+
+	pipe->pos = (size_t)(pos - pipe->buffer);
+	return 1;
+}
+
+// Parses the next op from the buffer, skipping blank lines. Returns the same as trace_reader_next()
+static int stream_next_text(struct trace_pipe *pipe, struct trace_op *op) {
+	for(;;) {
+		char *start = (char*)pipe->buffer + pipe->pos;
+		char *newline = memchr(start, '\n', pipe->len - pipe->pos);
+
+		if(newline == NULL && !pipe->eof) {
+			if(fill_buffer(pipe))
+				return -1;
+
+			start = (char*)pipe->buffer;
+			newline = memchr(start, '\n', pipe->len);
+
+			// A line has to fit in the buffer
+			if(newline == NULL && !pipe->eof)
+				return -1;
+		}
+
+		if(pipe->pos == pipe->len)
+			return 0;
+
+		// The buffer has a byte to spare past 'len' for the last line's terminator
+		char *end = newline != NULL ? newline : (char*)pipe->buffer + pipe->len;
+		*end = 0;
+		pipe->pos = (size_t)(end - (char*)pipe->buffer) + (newline != NULL);
+		pipe->line++;
+
+		int rc = trace_parse_line(start, op);
+		if(rc < 0) {
+			fprintf(stderr, "%s:%zu: invalid trace line\n", pipe->path, pipe->line);
+			return -1;
+		}
+
+		if(rc == 0)
+			return 1;
+	}
+}
+
+// Puts 'op' in the ring, waiting while it's full. Returns -1 if the consumer is closing the pipe
+static int ring_push(struct trace_pipe *pipe, const struct trace_op *op) {
+	uint64_t tail = pipe->producer.tail;
+
+	while(tail - pipe->producer_head == TRACE_RING_SIZE) {
+		pipe->producer_head = __atomic_load_n(&pipe->consumer.head, __ATOMIC_ACQUIRE);
+		if(tail - pipe->producer_head < TRACE_RING_SIZE)
+			break;
+
+		if(__atomic_load_n(&pipe->consumer.closing, __ATOMIC_RELAXED))
+			return -1;
+		sched_yield();
+	}
+
+	pipe->ring[tail & RING_MASK] = *op;
+	__atomic_store_n(&pipe->producer.tail, tail + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static void *producer_main(void *arg) {
+	struct trace_pipe *pipe = arg;
+	int error = fill_buffer(pipe);
+
+	// The header is only checked for its magic, the op count isn't needed
+	int binary = pipe->len >= TRACE_HEADER_BYTES && memcmp(pipe->buffer, TRACE_MAGIC, 4) == 0;
+	if(binary)
+		pipe->pos = TRACE_HEADER_BYTES;
+
+	struct trace_op op;
+	int rc;
+	while(!error && (rc = binary ? stream_next_binary(pipe, &op) : stream_next_text(pipe, &op)) != 0) {
+		if(rc < 0 || ring_push(pipe, &op))
+			error = 1;
+	}
+
+	if(pipe->child != 0) {
+		// If we stopped early, closing our end lets the decompressor die of SIGPIPE
+		fclose(pipe->input);
+		pipe->input = NULL;
+
+		int status;
+		if(waitpid(pipe->child, &status, 0) != pipe->child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			if(!__atomic_load_n(&pipe->consumer.closing, __ATOMIC_RELAXED))
+				error = 1;
+		}
+	}
+
+	pipe->producer.error = error;
+	__atomic_store_n(&pipe->producer.done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+// Starts 'tool' decompressing 'path' to a pipe, and returns the read end of it
+static FILE *spawn_decompressor(const char *tool, const char *path, pid_t *child) {
+	int fds[2];
+	if(pipe(fds))
+		return NULL;
+
+	*child = fork();
+	if(*child == -1) {
+		close(fds[0]);
+		close(fds[1]);
+		return NULL;
+	}
+
+	if(*child == 0) {
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]);
+		close(fds[1]);
+		execlp(tool, tool, "-dcq", "--", path, (char*)NULL);
+		fprintf(stderr, "can't run %s: %s\n", tool, strerror(errno));
+		_exit(127);
+	}
+
+	close(fds[1]);
+	FILE *input = fdopen(fds[0], "rb");
+	if(input == NULL) {
+		close(fds[0]);
+		waitpid(*child, NULL, 0);
+	}
+
+	return input;
+}
+
+struct trace_pipe *trace_pipe_open(const char *path) {
+	struct trace_pipe *pipe = calloc(1, sizeof(*pipe));
+	if(pipe == NULL)
+		return NULL;
+
+	pipe->path = path;
+	pipe->buffer = malloc(STREAM_BUFFER_BYTES + 1);
+	if(pipe->buffer == NULL) {
+		free(pipe);
+		return NULL;
+	}
+
+	const char *tool = decompressor_for(path);
+	pipe->input = tool != NULL ? spawn_decompressor(tool, path, &pipe->child) : fopen(path, "rb");
+
+	if(pipe->input == NULL) {
+		free(pipe->buffer);
+		free(pipe);
+		return NULL;
+	}
+
+	if(pthread_create(&pipe->thread, NULL, producer_main, pipe)) {
+		fclose(pipe->input);
+		if(pipe->child != 0)
+			waitpid(pipe->child, NULL, 0);
+		free(pipe->buffer);
+		free(pipe);
+		return NULL;
+	}
+
+	return pipe;
+}
+
+int trace_pipe_next(struct trace_pipe *pipe, struct trace_op *op) {
+	uint64_t head = pipe->consumer.head;
+
+	while(head == pipe->consumer_tail) {
+		// 'done' has to be read before 'tail', or the last few ops could be missed
+		int done = __atomic_load_n(&pipe->producer.done, __ATOMIC_ACQUIRE);
+		pipe->consumer_tail = __atomic_load_n(&pipe->producer.tail, __ATOMIC_ACQUIRE);
+
+		if(head != pipe->consumer_tail)
+			break;
+		if(done)
+			return pipe->producer.error ? -1 : 0;
+		sched_yield();
+	}
+
+	*op = pipe->ring[head & RING_MASK];
+	__atomic_store_n(&pipe->consumer.head, head + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+void trace_pipe_close(struct trace_pipe *pipe) {
+	// A producer waiting on a full ring gives up, and closes its end of the decompressor's pipe
+	__atomic_store_n(&pipe->consumer.closing, 1, __ATOMIC_RELAXED);
+	pthread_join(pipe->thread, NULL);
+
+	if(pipe->input != NULL)
+		fclose(pipe->input);
+	free(pipe->buffer);
+	free(pipe);
+}
@@ -0,0 +1,101 @@
+#ifndef MM_TRACE_H__
+#define MM_TRACE_H__
+
+// Traces of map/load/store calls, shared by the tools built on the memory manager. A trace is
+// either the text mm_main reads a line at a time ("swap", or "pid,op,address,value" with the
+// address in hex), or a compact binary encoding of the same thing made by trace_writer.
+//
+// The binary format is a header (the magic "MMTR", a version and the number of ops, all little
+// endian) followed by one variable length record per op:
+//	- a byte holding the op's kind in its low 2 bits, and TRACE_NEW_PID if the pid changed
+//	- the new pid as a varint, if it changed
+//	- for everything but swap, the address as a zigzag varint delta from the previous address
+//	- for map and store, the value byte
+// Consecutive ops usually share a pid and touch nearby addresses, so most records are 2-3 bytes.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum trace_kind { TRACE_SWAP, TRACE_MAP, TRACE_LOAD, TRACE_STORE };
+
+struct trace_op {
+	uint8_t kind;
+	uint8_t value;	// The permission for map, the byte for store, unused otherwise
+	int pid;
+	uint64_t address;
+};
+
+#define TRACE_MAGIC		"MMTR"
+#define TRACE_VERSION		1
+#define TRACE_HEADER_BYTES	16
+#define TRACE_NEW_PID		0x4
+
+// The most bytes one record can take: the kind byte, two 10 byte varints and the value
+#define TRACE_MAX_RECORD_BYTES	22
+
+// Parses one line of a text trace. Returns 0 on success, 1 for a blank line, or -1 if the line
+// isn't valid. 'line' is modified
+int trace_parse_line(char *line, struct trace_op *op);
+
+// Writes a binary trace. trace_writer_close() fills in the op count and closes the file, and
+// returns -1 if anything along the way failed to write
+struct trace_writer {
+	FILE *file;
+	int pid;
+	uint64_t address;
+	uint64_t count;
+	int error;
+};
+
+int trace_writer_open(struct trace_writer *writer, const char *path);
+void trace_writer_put(struct trace_writer *writer, const struct trace_op *op);
+int trace_writer_close(struct trace_writer *writer);
+
+// A binary trace mapped into memory, read an op at a time with trace_reader_next()
+struct trace_reader {
+	const uint8_t *base;
+	size_t size;
+	const uint8_t *pos;
+	uint64_t count;		// From the header
+	int pid;
+	uint64_t address;
+};
+
+// Returns 0 on success, or -1 if the file can't be mapped or isn't a binary trace
+int trace_reader_open(struct trace_reader *reader, const char *path);
+void trace_reader_close(struct trace_reader *reader);
+
+// Returns 1 with the next op in 'op', 0 at the end of the trace, or -1 if the trace is corrupt
+int trace_reader_next(struct trace_reader *reader, struct trace_op *op);
+
+// Whether the file at 'path' starts with TRACE_MAGIC
+int trace_is_binary(const char *path);
+
+// A trace of either format that's read on a thread of its own, and handed over an op at a time
+// through a ring of TRACE_RING_SIZE ops. A zstd or lz4 compressed trace is decompressed by the
+// zstd or lz4 tool on the way in, so the tool has to be on the PATH, but neither library is needed.
+// Only one thread may call trace_pipe_next()
+#define TRACE_RING_SIZE		4096
+
+struct trace_pipe;
+
+// Returns NULL if the file can't be opened or the thread can't be started
+struct trace_pipe *trace_pipe_open(const char *path);
+void trace_pipe_close(struct trace_pipe *pipe);
+
+// Returns the same as trace_reader_next(). It's -1 as well if the decompressor failed
+int trace_pipe_next(struct trace_pipe *pipe, struct trace_op *op);
+
+// Whether the file at 'path' starts with a zstd or lz4 frame
+int trace_is_compressed(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// MM_TRACE_H__
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "mm_workload.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Configs and specs.                                                        //
+///////////////////////////////////////////////////////////////////////////////
+
+static const char *const pattern_names[] = {
+	[WORKLOAD_UNIFORM] = "uniform",
+	[WORKLOAD_ZIPF] = "zipf",
+	[WORKLOAD_SEQUENTIAL] = "sequential",
+	[WORKLOAD_STRIDED] = "strided",
+	[WORKLOAD_PHASES] = "phases",
+	[WORKLOAD_MIX] = "mix",
+};
+
+#define NUM_PATTERNS	((int)(sizeof(pattern_names) / sizeof(pattern_names[0])))
+
+void workload_default_config(struct workload_config *config) {
+	memset(config, 0, sizeof(*config));
+	config->pattern = WORKLOAD_ZIPF;
+	config->seed = 1;
+	config->pids = 1;
+	config->page_size_bits = MM_PAGE_SIZE_BITS;
+	config->pages = MM_NUM_PTES;
+	config->ops = 10000;
+	config->store_percent = 30;
+	config->burst = 1;
+	config->zipf_theta = 0.99;
+	config->working_set = MM_NUM_PTES / 4 > 0 ? MM_NUM_PTES / 4 : 1;
+	config->phase_ops = 1000;
+}
+
+// Parses 'value' as a whole number, the way strtoull() does. Returns -1 if there's anything else
+static int parse_number(const char *value, uint64_t *number) {
+	char *end;
+	if(*value == 0 || *value == '-')
+		return -1;
+
+	*number = strtoull(value, &end, 0);
+	return *end == 0 ? 0 : -1;
+}
+
+static int parse_field(struct workload_config *config, const char *name, const char *value) {
+	uint64_t number = 0;
+
+	if(strcmp(name, "theta") == 0) {
+		char *end;
+		config->zipf_theta = strtod(value, &end);
+		return *value != 0 && *end == 0 ? 0 : -1;
+	}
+	if(strcmp(name, "swap") == 0 && value == NULL) {
+		config->swap = 1;
+		return 0;
+	}
+	if(value == NULL || parse_number(value, &number))
+		return -1;
+
+	if(strcmp(name, "seed") == 0)
+		config->seed = number;
+	else if(strcmp(name, "pids") == 0 && number <= WORKLOAD_MAX_PIDS)
+		config->pids = (int)number;
+	else if(strcmp(name, "page_bits") == 0 && number < 64)
+		config->page_size_bits = (int)number;
+	else if(strcmp(name, "pages") == 0)
+		config->pages = number;
+	else if(strcmp(name, "ops") == 0)
+		config->ops = number;
+	else if(strcmp(name, "stores") == 0 && number <= 100)
+		config->store_percent = (int)number;
+	else if(strcmp(name, "burst") == 0 && number <= INT32_MAX)
+		config->burst = (int)number;
+	else if(strcmp(name, "stride") == 0)
+		config->stride = number;
+	else if(strcmp(name, "working_set") == 0)
+		config->working_set = number;
+	else if(strcmp(name, "phase_ops") == 0)
+		config->phase_ops = number;
+	else
+		return -1;
+
+	return 0;
+}
+
+int workload_parse(const char *spec, struct workload_config *config) {
+	char *copy = strdup(spec);
+	if(copy == NULL)
+		return -1;
+
+	char *save = NULL;
+	char *field = strtok_r(copy, ",", &save);
+	int ret = field == NULL ? -1 : 0;
+
+	if(ret == 0) {
+		ret = -1;
+		for(int i = 0; i < NUM_PATTERNS; i++) {
+			if(strcmp(field, pattern_names[i]) == 0) {
+				config->pattern = (enum workload_pattern)i;
+				ret = 0;
+			}
+		}
+	}
+
+	while(ret == 0 && (field = strtok_r(NULL, ",", &save)) != NULL) {
+		char *value = strchr(field, '=');
+		if(value != NULL)
+			*value++ = 0;
+
+		ret = parse_field(config, field, value);
+	}
+
+	free(copy);
+	return ret;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Generating ops.                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+// splitmix64, which is small, quick and good enough for picking pages
+static uint64_t next_random(struct workload *workload) {
+	uint64_t z = (workload->rng += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+static double next_unit(struct workload *workload) {
+	return (double)(next_random(workload) >> 11) * 0x1.0p-53;
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+	while(b != 0) {
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+// The stride a pid with 'pattern' uses
+static uint64_t stream_stride(const struct workload *workload, enum workload_pattern pattern) {
+	uint64_t page_size = (uint64_t)1 << workload->config.page_size_bits;
+
+	if(workload->config.stride != 0)
+		return workload->config.stride;
+	if(pattern == WORKLOAD_SEQUENTIAL)
+		return page_size >= 4 ? page_size / 4 : 1;
+	return page_size;
+}
+
+static void zipf_init(struct workload *workload) {
+	uint64_t n = workload->config.pages;
+	double theta = workload->config.zipf_theta;
+
+	workload->zeta_n = 0;
+	for(uint64_t i = 1; i <= n; i++)
+		workload->zeta_n += 1.0 / pow((double)i, theta);
+
+	double zeta_2 = 1.0 + pow(0.5, theta);
+	workload->zipf_alpha = 1.0 / (1.0 - theta);
+	// With one or two pages, zipf_page() never gets as far as needing eta
+	workload->zipf_eta = n > 2 ? (1.0 - pow(2.0 / (double)n, 1.0 - theta)) / (1.0 - zeta_2 / workload->zeta_n) : 0;
+
+	// Hot pages shouldn't all sit next to each other, or a zipf workload would also be a sequential
+	// one. Multiplying the rank by something coprime with the footprint shuffles them around
+	workload->scatter = 1;
+	if(n > 2) {
+		workload->scatter = next_random(workload) % n;
+		while(workload->scatter == 0 || gcd(workload->scatter, n) != 1)
+			workload->scatter = (workload->scatter + 1) % n;
+	}
+}
+
+// A page with popularity rank 0 (the hottest) to pages - 1
+static uint64_t zipf_page(struct workload *workload) {
+	uint64_t n = workload->config.pages;
+	double u = next_unit(workload);
+	double uz = u * workload->zeta_n;
+	uint64_t rank;
+
+	if(uz < 1.0)
+		rank = 0;
+	else if(uz < 1.0 + pow(0.5, workload->config.zipf_theta))
+		rank = 1;
+	else
+		rank = (uint64_t)((double)n * pow(workload->zipf_eta * u - workload->zipf_eta + 1.0, workload->zipf_alpha));
+
+	if(rank >= n)
+		rank = n - 1;
+
+	return (uint64_t)((unsigned __int128)rank * workload->scatter % n);
+}
+
+int workload_init(struct workload *workload, const struct workload_config *config) {
+	memset(workload, 0, sizeof(*workload));
+	workload->config = *config;
+
+	if(config->pids < 1 || config->pids > WORKLOAD_MAX_PIDS || config->pages < 1 ||
+			config->page_size_bits < 0 || config->page_size_bits > 32 ||
+			config->store_percent < 0 || config->store_percent > 100 || config->burst < 1 ||
+			config->zipf_theta <= 0 || config->zipf_theta >= 1 || (int)config->pattern < 0 ||
+			(int)config->pattern >= NUM_PATTERNS)
+		return -1;
+
+	uint64_t footprint = config->pages << config->page_size_bits;
+	if(footprint >> config->page_size_bits != config->pages)
+		return -1;
+
+	for(int pid = 0; pid < config->pids; pid++) {
+		struct workload_stream *stream = &workload->streams[pid];
+		stream->pattern = config->pattern;
+		if(config->pattern == WORKLOAD_MIX)
+			stream->pattern = (enum workload_pattern)((WORKLOAD_ZIPF + pid) % WORKLOAD_MIX);
+
+		if(stream_stride(workload, stream->pattern) > footprint)
+			return -1;
+		if(stream->pattern == WORKLOAD_PHASES && (config->working_set < 1 ||
+				config->working_set > config->pages || config->phase_ops < 1))
+			return -1;
+	}
+
+	workload->rng = config->seed;
+	workload->total = (config->swap ? 1 : 0) + (uint64_t)config->pids * config->pages + config->ops;
+	if(config->pattern == WORKLOAD_ZIPF || config->pattern == WORKLOAD_MIX)
+		zipf_init(workload);
+
+	return 0;
+}
+
+// The next address 'stream' accesses
+static uint64_t stream_address(struct workload *workload, struct workload_stream *stream) {
+	const struct workload_config *config = &workload->config;
+	uint64_t page_size = (uint64_t)1 << config->page_size_bits;
+	uint64_t footprint = config->pages << config->page_size_bits;
+	uint64_t stride = stream_stride(workload, stream->pattern);
+	uint64_t position = stream->position++;
+	uint64_t page;
+
+	switch(stream->pattern) {
+	case WORKLOAD_SEQUENTIAL:
+		return (uint64_t)((unsigned __int128)position * stride % footprint);
+
+	case WORKLOAD_STRIDED: {
+		// Down a column, then on to the next one. Columns past the end of a row start over
+		uint64_t rows = footprint / stride;
+		return position % rows * stride + position / rows % stride;
+	}
+
+	case WORKLOAD_PHASES:
+		if(position % config->phase_ops == 0)
+			stream->phase_base = next_random(workload) % (config->pages - config->working_set + 1);
+		page = stream->phase_base + next_random(workload) % config->working_set;
+		break;
+
+	case WORKLOAD_ZIPF:
+		page = zipf_page(workload);
+		break;
+
+	default:
+		page = next_random(workload) % config->pages;
+		break;
+	}
+
+	return page << config->page_size_bits | (next_random(workload) & (page_size - 1));
+}
+
+int workload_next(struct workload *workload, struct trace_op *op) {
+	const struct workload_config *config = &workload->config;
+	uint64_t index = workload->next;
+
+	if(index >= workload->total)
+		return 0;
+	workload->next++;
+
+	memset(op, 0, sizeof(*op));
+
+	if(config->swap && index-- == 0) {
+		op->kind = TRACE_SWAP;
+		return 1;
+	}
+
+	// Every pid's pages, one pid after another
+	if(index < (uint64_t)config->pids * config->pages) {
+		op->kind = TRACE_MAP;
+		op->value = 1;
+		op->pid = (int)(index / config->pages);
+		op->address = index % config->pages << config->page_size_bits;
+		return 1;
+	}
+
+	if(workload->burst_left == 0) {
+		workload->pid = (int)(next_random(workload) % (uint64_t)config->pids);
+		workload->burst_left = config->burst;
+	}
+	workload->burst_left--;
+
+	op->pid = workload->pid;
+	op->address = stream_address(workload, &workload->streams[op->pid]);
+	if(next_random(workload) % 100 < (uint64_t)config->store_percent) {
+		op->kind = TRACE_STORE;
+		op->value = (uint8_t)next_random(workload);
+	} else {
+		op->kind = TRACE_LOAD;
+	}
+
+	return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Running and writing workloads.                                            //
+///////////////////////////////////////////////////////////////////////////////
+
+int workload_apply(struct MM_Instance *instance, const struct trace_op *op) {
+	uint8_t value;
+
+	switch(op->kind) {
+	case TRACE_SWAP:
+		if(instance != NULL)
+			MM_SwapOn_ex(instance);
+		else
+			MM_SwapOn();
+		return 0;
+	case TRACE_MAP:
+		return (instance != NULL ? MM_Map_ex(instance, op->pid, op->address, op->value != 0) :
+				MM_Map(op->pid, op->address, op->value != 0)).error ? -1 : 0;
+	case TRACE_LOAD:
+		return (instance != NULL ? MM_LoadByte_ex(instance, op->pid, op->address, &value) :
+				MM_LoadByte(op->pid, op->address, &value)) ? -1 : 0;
+	default:
+		return (instance != NULL ? MM_StoreByte_ex(instance, op->pid, op->address, op->value) :
+				MM_StoreByte(op->pid, op->address, op->value)) ? -1 : 0;
+	}
+}
+
+// In the format trace_parse_line() reads
+int workload_write_text(struct workload *workload, FILE *file) {
+	struct trace_op op;
+
+	while(workload_next(workload, &op)) {
+		if(op.kind == TRACE_SWAP)
+			fprintf(file, "swap\n");
+		else
+			fprintf(file, "%d,%s,%llx,%u\n", op.pid, op.kind == TRACE_MAP ? "map" : op.kind == TRACE_LOAD ? "load" : "store",
+				(unsigned long long)op.address, op.value);
+	}
+
+	return ferror(file) || fflush(file) ? -1 : 0;
+}
+
+int workload_write_binary(struct workload *workload, const char *path) {
+	struct trace_writer writer;
+	if(trace_writer_open(&writer, path))
+		return -1;
+
+	struct trace_op op;
+	while(workload_next(workload, &op))
+		trace_writer_put(&writer, &op);
+
+	return trace_writer_close(&writer);
+}
@@ -0,0 +1,100 @@
+#ifndef MM_WORKLOAD_H__
+#define MM_WORKLOAD_H__
+
+// Synthetic workloads: streams of map/load/store ops (the same struct trace_op a trace holds) with
+// the kinds of locality real programs have, for trying out replacement policies and read ahead
+// without a recorded trace. A workload maps every page of each pid's footprint up front, and then
+// makes 'ops' loads and stores following its pattern. The same config (seed included) always
+// makes the same ops.
+//
+// A config can also be given as a spec string, the pattern's name followed by any of the config's
+// fields as name=value, e.g. "zipf,pids=4,pages=1024,ops=100000,theta=0.9,seed=7,swap".
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "mm_api.h"
+#include "mm_trace.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum workload_pattern {
+	WORKLOAD_UNIFORM,	// Every page is as likely as any other
+	WORKLOAD_ZIPF,		// Page popularity follows a Zipf distribution, scattered over the footprint
+	WORKLOAD_SEQUENTIAL,	// Scans the footprint in order, 'stride' bytes at a time, over and over
+	WORKLOAD_STRIDED,	// Walks down the columns of a matrix whose rows are 'stride' bytes long
+	WORKLOAD_PHASES,	// Uniform over 'working_set' pages, which move every 'phase_ops' accesses
+	WORKLOAD_MIX,		// Each pid follows a different one of the patterns above, starting with zipf
+};
+
+// The most pids a workload can have
+#define WORKLOAD_MAX_PIDS	64
+
+struct workload_config {
+	enum workload_pattern pattern;
+	uint64_t seed;
+	int pids;
+	int page_size_bits;
+	uint64_t pages;		// Pages in each pid's footprint, which starts at address 0
+	uint64_t ops;		// Loads and stores, not counting the maps
+	int store_percent;
+	int burst;		// Accesses in a row by one pid before a pid is picked again (at random)
+	double zipf_theta;	// The skew of zipf, between 0 (uniform) and 1 (exclusive)
+	uint64_t stride;	// In bytes. 0 is a quarter page for sequential and a page for strided
+	uint64_t working_set;	// Pages in each phase's working set
+	uint64_t phase_ops;	// Accesses (by the same pid) per phase
+	int swap;		// Starts with a swap op, if set
+};
+
+// Fills in the default config: zipf over the default geometry's pages, for one pid, 30% stores
+void workload_default_config(struct workload_config *config);
+
+// Updates 'config' from a spec string (see above). Returns -1 if the spec isn't valid
+int workload_parse(const char *spec, struct workload_config *config);
+
+// What each pid's accesses have got up to
+struct workload_stream {
+	enum workload_pattern pattern;
+	uint64_t position;	// Accesses made so far
+	uint64_t phase_base;	// The first page of the current working set
+};
+
+struct workload {
+	struct workload_config config;
+	uint64_t rng;
+	uint64_t next;		// Ops made so far
+	uint64_t total;		// Ops there'll be in all
+	int pid;		// Making the current burst
+	int burst_left;
+
+	// For zipf, from Gray et al., "Quickly Generating Billion-Record Synthetic Databases"
+	double zeta_n;
+	double zipf_alpha;
+	double zipf_eta;
+	uint64_t scatter;	// Coprime with the footprint, so rank * scatter spreads hot pages around
+
+	struct workload_stream streams[WORKLOAD_MAX_PIDS];
+};
+
+// Returns -1 if the config doesn't make sense, such as a stride or working set bigger than the
+// footprint
+int workload_init(struct workload *workload, const struct workload_config *config);
+
+// Returns 1 with the next op in 'op', or 0 once every op has been made
+int workload_next(struct workload *workload, struct trace_op *op);
+
+// Makes the call 'op' stands for on 'instance', or on the default instance if it's NULL. Returns 0,
+// or -1 if the call failed
+int workload_apply(struct MM_Instance *instance, const struct trace_op *op);
+
+// Write the rest of the workload out as a trace that mm can run. Both return -1 if writing failed
+int workload_write_text(struct workload *workload, FILE *file);
+int workload_write_binary(struct workload *workload, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	// MM_WORKLOAD_H__